@@ -5,6 +5,7 @@
 
 void AttractionMapperImpl::init(const MapLoader& ml)
 {
+    auto scope = MemoryScope(account_);
     auto nSegments = ml.getNumSegments();
     auto street = StreetSegment();
 
@@ -24,6 +25,19 @@ void AttractionMapperImpl::init(const MapLoader& ml)
 bool AttractionMapperImpl::getGeoCoord(std::string attraction, GeoCoord& gc) const
 {
     makeLowerCase(attraction);
+    return findLowered(attraction, gc);
+}
+
+bool AttractionMapperImpl::getGeoCoord(const std::string &attraction, GeoCoord &gc,
+                                       std::string &lowered) const
+{
+    lowered.assign(attraction);
+    makeLowerCase(lowered);
+    return findLowered(lowered, gc);
+}
+
+bool AttractionMapperImpl::findLowered(const std::string &attraction, GeoCoord &gc) const
+{
     auto geoCoordPtr = attractionMap_.find(attraction);
 
     if (geoCoordPtr != nullptr)
@@ -35,6 +49,20 @@ bool AttractionMapperImpl::getGeoCoord(std::string attraction, GeoCoord& gc) con
     return false;
 }
 
+size_t AttractionMapperImpl::getMemoryBytes() const
+{
+    return sizeof(AttractionMapperImpl) + account_.bytes();
+}
+
+size_t AttractionMapperImpl::getStringBytes() const
+{
+    auto bytes = size_t(0);
+    attractionMap_.forEach([&](const std::string &attraction, const GeoCoord &gc) {
+        bytes += stringBytes(attraction) + stringBytes(gc);
+    });
+    return bytes;
+}
+
 AttractionMapper::AttractionMapper() 
     : pImpl_(new AttractionMapperImpl) 
 {
@@ -53,4 +81,20 @@ void AttractionMapper::init(const MapLoader& ml)
 bool AttractionMapper::getGeoCoord(std::string attraction, GeoCoord& gc) const
 {
     return pImpl_->getGeoCoord(attraction, gc);
-}
\ No newline at end of file
+}
+
+bool AttractionMapper::getGeoCoord(const std::string &attraction, GeoCoord &gc,
+                                   std::string &lowered) const
+{
+    return pImpl_->getGeoCoord(attraction, gc, lowered);
+}
+
+size_t AttractionMapper::getMemoryBytes() const
+{
+    return pImpl_->getMemoryBytes();
+}
+
+size_t AttractionMapper::getStringBytes() const
+{
+    return pImpl_->getStringBytes();
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CompressedGraph.h"
+#include "MemoryAccounting.h"
+#include "StreetGraph.h"
+
+static void writeVarint(unsigned value, std::vector<unsigned char> &bytes)
+{
+    while (value >= 0x80)
+    {
+        bytes.emplace_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.emplace_back(static_cast<unsigned char>(value));
+}
+
+/**
+ *  A node that is not core has two arcs, and the arc before one of them on
+ *  its chain is the twin of the other, on the same segment. The name is
+ *  kept unless it is the same as that one's; it is also kept if both arcs
+ *  lead to the same node, where the walk back could not tell them apart.
+ */
+CompressedGraph::CompressedGraph(const StreetGraph &graph)
+{
+    auto scope = MemoryScope(account_);
+    auto nameOf = [&](int arcId) { return graph.segment(graph.arc(arcId).segment).streetName; };
+    firstArc_.resize(graph.nodeCount() + 1);
+    firstByte_.resize(graph.nodeCount() + 1);
+    bytes_.reserve(3 * static_cast<size_t>(graph.arcCount()));
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        firstArc_[v]  = graph.firstArc(v);
+        firstByte_[v] = static_cast<unsigned>(size(bytes_));
+        auto previous = v;
+        for (int a = graph.firstArc(v); a < graph.firstArc(v + 1); ++a)
+        {
+            const auto &arc = graph.arc(a);
+            auto delta = arc.head - previous;
+            writeVarint((static_cast<unsigned>(delta) << 1) ^ static_cast<unsigned>(delta >> 31),
+                        bytes_);
+            previous = arc.head;
+
+            auto keepName = graph.isCore(v);
+            if (!keepName)
+            {
+                auto other = a == graph.firstArc(v) ? a + 1 : a - 1;
+                keepName = nameOf(other) != nameOf(a) or graph.arc(other).head == arc.head;
+            }
+            auto quanta = static_cast<unsigned>(std::lround(arc.length / lengthQuantum));
+            writeVarint(quanta << 1 | (keepName ? 1 : 0), bytes_);
+            if (keepName)
+            {
+                writeVarint(static_cast<unsigned>(nameOf(a)), bytes_);
+            }
+        }
+    }
+    firstArc_.back()  = graph.arcCount();
+    firstByte_.back() = static_cast<unsigned>(size(bytes_));
+    bytes_.shrink_to_fit();
+}
+
+int CompressedGraph::streetName(int arcId) const
+{
+    for (;;)
+    {
+        // The tail of the arc is the node whose block holds it.
+        auto tail = static_cast<int>(std::upper_bound(begin(firstArc_), end(firstArc_), arcId) -
+                                     begin(firstArc_)) - 1;
+        const auto *at = bytes_.data() + firstByte_[tail];
+        auto name = -1;
+        for (auto a = firstArc_[tail]; a <= arcId; ++a)
+        {
+            readVarint(at);
+            auto length = readVarint(at);
+            name = length & 1 ? static_cast<int>(readVarint(at)) : -1;
+        }
+        if (name != -1)
+        {
+            return name;
+        }
+
+        // Not core, so the tail has one other arc; go on from its twin,
+        // the arc from that neighbour back to the tail.
+        auto other = arcId == firstArc_[tail] ? arcId + 1 : arcId - 1;
+        auto neighbour = -1;
+        forEachArc(tail, [&](int a, int h, double) {
+            if (a == other)
+            {
+                neighbour = h;
+            }
+        });
+        forEachArc(neighbour, [&](int a, int h, double) {
+            if (h == tail)
+            {
+                arcId = a;
+            }
+        });
+    }
+}
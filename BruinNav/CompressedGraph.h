@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "StreetGraph.h"
+
+/**
+ *  The arcs of a StreetGraph packed into a few bytes each, a candidate
+ *  layout for maps that would not fit in memory otherwise. For now it is
+ *  built by the bench and the tests only: no Navigator query reads it,
+ *  since the chain search behind navigate and the writing of routes need
+ *  the flat arcs, which would then stay loaded beside it and save nothing.
+ *  The arcs leaving a node are one block of bytes, in the order and with
+ *  the ids of the graph:
+ *
+ *  head    zigzag varint of the difference from the head of the arc before,
+ *          or from the node for the first one. Nodes close on the map have
+ *          close numbers in HILBERT_ORDER, so most take one byte.
+ *  length  varint of the length in lengthQuantum units, shifted up one bit;
+ *          the low bit is set if a street name follows.
+ *  name    varint street name id, only on arcs starting a chain and on those
+ *          whose street differs from the arc before on their chain, so each
+ *          chain stores its name once.
+ *
+ *  Searches read heads and lengths through CompressedArcs (SearchPolicies.h);
+ *  everything else, routes included, still comes from the graph.
+ */
+class CompressedGraph
+{
+public:
+    CompressedGraph(const CompressedGraph &other)          = delete;
+    CompressedGraph &operator=(const CompressedGraph &rhs) = delete;
+
+public:
+    // Lengths are rounded to this many miles, about 2.5 cm, so a typical
+    // segment takes two bytes.
+    static constexpr double lengthQuantum = 1.0 / (1 << 16);
+
+    explicit CompressedGraph(const StreetGraph &graph);
+
+    inline int nodeCount() const { return static_cast<int>(size(firstArc_)) - 1; }
+
+    // Calls visit(arcId, head, length) for each arc leaving node, in order.
+    template <class Visit>
+    inline void forEachArc(int node, const Visit &visit) const;
+
+    // Street name id of an arc, found by walking back along its chain to the
+    // arc that stores it.
+    int streetName(int arcId) const;
+
+    // Bytes of the arc blocks alone.
+    inline size_t arcBytes() const { return size(bytes_); }
+
+    // Heap bytes held, counted as they were allocated.
+    inline size_t memoryBytes() const { return account_.bytes(); }
+
+private:
+    static inline unsigned readVarint(const unsigned char *&at);
+
+private:
+    MemoryAccount               account_;   // first, so it is opened first.
+    std::vector<int>            firstArc_;  // by node; one past the end last.
+    std::vector<unsigned>       firstByte_; // likewise.
+    std::vector<unsigned char>  bytes_;
+};
+
+inline unsigned CompressedGraph::readVarint(const unsigned char *&at)
+{
+    auto value = unsigned(*at & 0x7f);
+    for (auto shift = 7; *at++ & 0x80; shift += 7)
+    {
+        value |= unsigned(*at & 0x7f) << shift;
+    }
+    return value;
+}
+
+template <class Visit>
+inline void CompressedGraph::forEachArc(int node, const Visit &visit) const
+{
+    const auto *at = bytes_.data() + firstByte_[node];
+    auto head = node;
+    for (auto arcId = firstArc_[node]; arcId < firstArc_[node + 1]; ++arcId)
+    {
+        auto delta = readVarint(at);
+        head += static_cast<int>(delta >> 1) ^ -static_cast<int>(delta & 1);
+        auto length = readVarint(at);
+        if (length & 1)
+        {
+            readVarint(at);
+        }
+        visit(arcId, head, (length >> 1) * lengthQuantum);
+    }
+}
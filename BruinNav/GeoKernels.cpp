@@ -0,0 +1,66 @@
+#include <cmath>
+
+#if defined(__AVX2__) or defined(__SSE2__) or defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "GeoKernels.h"
+
+void boundDistances(const double *lat, const double *lon, const double *cosLat, int n,
+                    double targetLat, double targetLon, double targetCosLat,
+                    double diameter, double *result)
+{
+    auto i = 0;
+
+#if defined(__AVX2__)
+    auto half      = _mm256_set1_pd(0.5);
+    auto one       = _mm256_set1_pd(1.0);
+    auto sixth     = _mm256_set1_pd(1.0 / 6.0);
+    auto zero      = _mm256_setzero_pd();
+    auto tLat      = _mm256_set1_pd(targetLat);
+    auto tLon      = _mm256_set1_pd(targetLon);
+    auto tCosLat   = _mm256_set1_pd(targetCosLat);
+    auto vDiameter = _mm256_set1_pd(diameter);
+    for (; i + 4 <= n; i += 4)
+    {
+        auto x = _mm256_mul_pd(half, _mm256_sub_pd(tLat, _mm256_loadu_pd(lat + i)));
+        auto y = _mm256_mul_pd(half, _mm256_sub_pd(tLon, _mm256_loadu_pd(lon + i)));
+        auto sinX = _mm256_mul_pd(x, _mm256_max_pd(zero,
+            _mm256_sub_pd(one, _mm256_mul_pd(_mm256_mul_pd(x, x), sixth))));
+        auto sinY = _mm256_mul_pd(y, _mm256_max_pd(zero,
+            _mm256_sub_pd(one, _mm256_mul_pd(_mm256_mul_pd(y, y), sixth))));
+        auto cosProduct = _mm256_mul_pd(_mm256_loadu_pd(cosLat + i), tCosLat);
+        auto a = _mm256_add_pd(_mm256_mul_pd(sinX, sinX),
+            _mm256_mul_pd(cosProduct, _mm256_mul_pd(sinY, sinY)));
+        _mm256_storeu_pd(result + i, _mm256_mul_pd(vDiameter, _mm256_sqrt_pd(a)));
+    }
+#elif defined(__SSE2__) or defined(_M_X64)
+    auto half      = _mm_set1_pd(0.5);
+    auto one       = _mm_set1_pd(1.0);
+    auto sixth     = _mm_set1_pd(1.0 / 6.0);
+    auto zero      = _mm_setzero_pd();
+    auto tLat      = _mm_set1_pd(targetLat);
+    auto tLon      = _mm_set1_pd(targetLon);
+    auto tCosLat   = _mm_set1_pd(targetCosLat);
+    auto vDiameter = _mm_set1_pd(diameter);
+    for (; i + 2 <= n; i += 2)
+    {
+        auto x = _mm_mul_pd(half, _mm_sub_pd(tLat, _mm_loadu_pd(lat + i)));
+        auto y = _mm_mul_pd(half, _mm_sub_pd(tLon, _mm_loadu_pd(lon + i)));
+        auto sinX = _mm_mul_pd(x, _mm_max_pd(zero,
+            _mm_sub_pd(one, _mm_mul_pd(_mm_mul_pd(x, x), sixth))));
+        auto sinY = _mm_mul_pd(y, _mm_max_pd(zero,
+            _mm_sub_pd(one, _mm_mul_pd(_mm_mul_pd(y, y), sixth))));
+        auto cosProduct = _mm_mul_pd(_mm_loadu_pd(cosLat + i), tCosLat);
+        auto a = _mm_add_pd(_mm_mul_pd(sinX, sinX),
+            _mm_mul_pd(cosProduct, _mm_mul_pd(sinY, sinY)));
+        _mm_storeu_pd(result + i, _mm_mul_pd(vDiameter, _mm_sqrt_pd(a)));
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        result[i] = boundDistance(lat[i], lon[i], cosLat[i],
+                                  targetLat, targetLon, targetCosLat, diameter);
+    }
+}
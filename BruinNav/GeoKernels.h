@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cmath>
+
+#include "Provided.h"
+
+// Pass as `diameter` below to get distances in miles or kilometers.
+const double earthDiameterMiles = 2.0 * earthRadiusKm * 0.621371;
+const double earthDiameterKm    = 2.0 * earthRadiusKm;
+
+/**
+ *  Lower bound on the haversine distance between two points, cheap enough to
+ *  vectorize: sin(x) is bounded below by x - x^3/6 and asin(x) by x, so only
+ *  multiplications, additions and one square root remain. For points a few
+ *  miles apart the bound is within a few parts per ten million of
+ *  distanceEarthKM, and it never exceeds it, so A* stays admissible.
+ *
+ *  @param lat1, lon1  first point, radians.
+ *  @param cosLat1     cos(lat1), precomputed.
+ *  @param lat2, lon2  second point, radians.
+ *  @param cosLat2     cos(lat2), precomputed.
+ *  @param diameter    earth diameter in the unit of the result.
+ */
+inline double boundDistance(double lat1, double lon1, double cosLat1,
+                            double lat2, double lon2, double cosLat2,
+                            double diameter)
+{
+    auto x = 0.5 * (lat2 - lat1);
+    auto y = 0.5 * (lon2 - lon1);
+    auto sinX = x * std::fmax(0.0, 1.0 - x * x * (1.0 / 6.0));
+    auto sinY = y * std::fmax(0.0, 1.0 - y * y * (1.0 / 6.0));
+    return diameter * std::sqrt(sinX * sinX + cosLat1 * cosLat2 * (sinY * sinY));
+}
+
+/**
+ *  boundDistance from one target to n points stored as separate arrays.
+ *  Uses AVX2 or SSE2 when the compiler targets them, scalar code otherwise;
+ *  every path evaluates the same expression as boundDistance.
+ *
+ *  @param lat, lon, cosLat  the n points, radians and cos(latitude).
+ *  @param result            receives the n bounds.
+ */
+void boundDistances(const double *lat, const double *lon, const double *cosLat, int n,
+                    double targetLat, double targetLon, double targetCosLat,
+                    double diameter, double *result);
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "HubLabels.h"
+#include "MemoryAccounting.h"
+#include "StreetGraph.h"
+
+// Shortest path trees sampled to rank the core nodes.
+static const int nSampleTrees = 32;
+
+// Stands for the end of a label; sorts after every hub rank.
+static const int sentinelHub = INT_MAX;
+
+using coreEntry = std::pair<double, int>;   // (distance, core index)
+using coreQueue = std::priority_queue<coreEntry, std::vector<coreEntry>, std::greater<coreEntry>>;
+
+static void writeVarint(unsigned value, std::vector<unsigned char> &bytes)
+{
+    while (value >= 0x80)
+    {
+        bytes.emplace_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.emplace_back(static_cast<unsigned char>(value));
+}
+
+static inline unsigned readVarint(const unsigned char *&at)
+{
+    auto value = unsigned(*at & 0x7f);
+    for (auto shift = 7; *at++ & 0x80; shift += 7)
+    {
+        value |= unsigned(*at & 0x7f) << shift;
+    }
+    return value;
+}
+
+// Reads one label entry by entry, its hubs decoded as it goes.
+class LabelCursor
+{
+public:
+    LabelCursor(const unsigned char *at, int entry, int end)
+        : at_(at), entry_(entry), end_(end)
+    {
+        hub_ = entry_ < end_ ? static_cast<int>(readVarint(at_)) : sentinelHub;
+    }
+
+    inline int hub() const { return hub_; }
+    inline int entry() const { return entry_; }
+
+    inline void next()
+    {
+        hub_ = ++entry_ < end_ ? hub_ + static_cast<int>(readVarint(at_)) : sentinelHub;
+    }
+
+private:
+    const unsigned char *at_;
+    int                  entry_;
+    int                  end_;
+    int                  hub_;
+};
+
+HubLabels::HubLabels(const StreetGraph &graph)
+{
+    auto scope = MemoryScope(account_);
+    auto coreNodes = std::vector<int>{};
+    coreIndex_.assign(graph.nodeCount(), -1);
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        if (graph.isCore(v))
+        {
+            coreIndex_[v] = static_cast<int>(size(coreNodes));
+            coreNodes.emplace_back(v);
+        }
+    }
+    auto nCore = static_cast<int>(size(coreNodes));
+
+    auto order = std::vector<int>{};
+    orderByImportance(graph, order);
+
+    // Labels grow by one hub per search, in rank order, so they stay sorted.
+    // rootLabel holds the label of the search's root by hub rank, so each
+    // pruning test is one pass over the label of the node reached.
+    const auto infinity = std::numeric_limits<double>::infinity();
+    auto labels    = std::vector<std::vector<std::pair<int, double>>>(nCore);
+    auto rootLabel = std::vector<double>(nCore, infinity);
+    auto distance  = std::vector<double>(nCore, infinity);
+    auto touched   = std::vector<int>{};
+    auto open      = coreQueue();
+    for (int rank = 0; rank < nCore; ++rank)
+    {
+        auto root = order[rank];
+        for (const auto &entry : labels[root])
+        {
+            rootLabel[entry.first] = entry.second;
+        }
+
+        distance[root] = 0.0;
+        touched.emplace_back(root);
+        open.emplace(0.0, root);
+        while (!open.empty())
+        {
+            auto current = open.top();
+            open.pop();
+            auto u = current.second;
+            if (current.first > distance[u])
+            {
+                continue;
+            }
+
+            auto known = infinity;
+            for (const auto &entry : labels[u])
+            {
+                known = std::min(known, rootLabel[entry.first] + entry.second);
+            }
+            if (known <= current.first)
+            {
+                continue;
+            }
+            labels[u].emplace_back(rank, current.first);
+
+            auto node = coreNodes[u];
+            for (int chain = graph.firstArc(node); chain < graph.firstArc(node + 1); ++chain)
+            {
+                auto head = coreIndex_[graph.chainHead(chain)];
+                auto d    = current.first + graph.chainLength(chain);
+                if (d < distance[head])
+                {
+                    if (distance[head] == infinity)
+                    {
+                        touched.emplace_back(head);
+                    }
+                    distance[head] = d;
+                    open.emplace(d, head);
+                }
+            }
+        }
+
+        for (auto u : touched)
+        {
+            distance[u] = infinity;
+        }
+        touched.clear();
+        for (const auto &entry : labels[root])
+        {
+            rootLabel[entry.first] = infinity;
+        }
+    }
+
+    auto nEntries = size_t(0);
+    for (const auto &label : labels)
+    {
+        nEntries += size(label);
+    }
+    firstEntry_.reserve(nCore + 1);
+    firstByte_.reserve(nCore + 1);
+    distances_.reserve(nEntries);
+    for (auto &label : labels)
+    {
+        firstEntry_.emplace_back(static_cast<int>(size(distances_)));
+        firstByte_.emplace_back(static_cast<unsigned>(size(hubBytes_)));
+        auto previous = 0;
+        for (const auto &entry : label)
+        {
+            writeVarint(static_cast<unsigned>(entry.first - previous), hubBytes_);
+            distances_.emplace_back(entry.second);
+            previous = entry.first;
+        }
+        label = {};
+    }
+    firstEntry_.emplace_back(static_cast<int>(size(distances_)));
+    firstByte_.emplace_back(static_cast<unsigned>(size(hubBytes_)));
+    hubBytes_.shrink_to_fit();
+}
+
+double HubLabels::distance(int node1, int node2) const
+{
+    auto core1  = coreIndex_[node1];
+    auto core2  = coreIndex_[node2];
+    auto label1 = LabelCursor(hubBytes_.data() + firstByte_[core1], firstEntry_[core1],
+                              firstEntry_[core1 + 1]);
+    auto label2 = LabelCursor(hubBytes_.data() + firstByte_[core2], firstEntry_[core2],
+                              firstEntry_[core2 + 1]);
+    auto best   = node1 == node2 ? 0.0 : std::numeric_limits<double>::infinity();
+    for (;;)
+    {
+        if (label1.hub() == label2.hub())
+        {
+            if (label1.hub() == sentinelHub)
+            {
+                return best;
+            }
+            best = std::min(best, distances_[label1.entry()] + distances_[label2.entry()]);
+            label1.next();
+            label2.next();
+        }
+        else if (label1.hub() < label2.hub())
+        {
+            label1.next();
+        }
+        else
+        {
+            label2.next();
+        }
+    }
+}
+
+// A node high in many shortest path trees lies on many shortest routes, so
+// it makes a hub that prunes many later searches.
+void HubLabels::orderByImportance(const StreetGraph &graph, std::vector<int> &order) const
+{
+    const auto infinity = std::numeric_limits<double>::infinity();
+    auto nCore      = graph.coreNodeCount();
+    auto coreNodes  = std::vector<int>(nCore);
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        if (coreIndex_[v] != -1)
+        {
+            coreNodes[coreIndex_[v]] = v;
+        }
+    }
+
+    auto importance = std::vector<long long>(nCore, 0);
+    auto distance   = std::vector<double>(nCore);
+    auto parent     = std::vector<int>(nCore);
+    auto below      = std::vector<long long>(nCore);
+    auto settled    = std::vector<int>{};
+    auto open       = coreQueue();
+    auto nTrees     = std::min(nCore, nSampleTrees);
+    for (int tree = 0; tree < nTrees; ++tree)
+    {
+        auto root = static_cast<int>(static_cast<long long>(tree) * nCore / nTrees);
+        std::fill(begin(distance), end(distance), infinity);
+        std::fill(begin(parent), end(parent), -1);
+        settled.clear();
+        distance[root] = 0.0;
+        open.emplace(0.0, root);
+        while (!open.empty())
+        {
+            auto current = open.top();
+            open.pop();
+            auto u = current.second;
+            if (current.first > distance[u])
+            {
+                continue;
+            }
+            settled.emplace_back(u);
+            auto node = coreNodes[u];
+            for (int chain = graph.firstArc(node); chain < graph.firstArc(node + 1); ++chain)
+            {
+                auto head = coreIndex_[graph.chainHead(chain)];
+                auto d    = current.first + graph.chainLength(chain);
+                if (d < distance[head])
+                {
+                    distance[head] = d;
+                    parent[head]   = u;
+                    open.emplace(d, head);
+                }
+            }
+        }
+
+        for (auto u : settled)
+        {
+            below[u] = 1;
+        }
+        for (auto u = rbegin(settled); u != rend(settled); ++u)
+        {
+            importance[*u] += below[*u];
+            if (parent[*u] != -1)
+            {
+                below[parent[*u]] += below[*u];
+            }
+        }
+    }
+
+    order.resize(nCore);
+    for (int u = 0; u < nCore; ++u)
+    {
+        order[u] = u;
+    }
+    auto degree = [&](int u) {
+        return graph.firstArc(coreNodes[u] + 1) - graph.firstArc(coreNodes[u]);
+    };
+    std::sort(begin(order), end(order), [&](int u, int v) {
+        if (importance[u] != importance[v])
+        {
+            return importance[u] > importance[v];
+        }
+        return degree(u) != degree(v) ? degree(u) > degree(v) : u < v;
+    });
+}
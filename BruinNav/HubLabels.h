@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "StreetGraph.h"
+
+/**
+ *  Hub labels over the core nodes of a StreetGraph, for distance-only
+ *  queries. Every core node keeps a label: hubs with its distance to each.
+ *  Any two core nodes share a hub on a shortest route between them, so
+ *  their distance is the smallest sum over the hubs they have in common,
+ *  found by merging the two labels.
+ *
+ *  Labels are built by pruned Dijkstra searches from the core nodes in
+ *  decreasing order of importance: a search stops at any node the labels
+ *  built so far already answer for, so later labels stay short. Importance
+ *  is how many nodes lie below a node in a few sample shortest path trees.
+ *
+ *  Hubs are stored as their rank in that order, so every label is sorted,
+ *  and each rank as a varint of its difference from the rank before, most
+ *  often one byte instead of four. The labels are kept back to back, hubs
+ *  in one array of bytes and distances in one of doubles.
+ */
+class HubLabels
+{
+public:
+    HubLabels(const HubLabels &other)          = delete;
+    HubLabels &operator=(const HubLabels &rhs) = delete;
+
+public:
+    explicit HubLabels(const StreetGraph &graph);
+
+    /**
+     *  @param node1, node2 core nodes of the graph.
+     *  @return the length of the shortest route between them, infinity if none.
+     */
+    double distance(int node1, int node2) const;
+
+    // Label entries over all core nodes.
+    inline long long entryCount() const { return static_cast<long long>(size(distances_)); }
+
+    inline int coreNodeCount() const { return static_cast<int>(size(firstEntry_)) - 1; }
+
+    // Heap bytes held by the labels, counted as they were allocated.
+    inline size_t memoryBytes() const { return account_.bytes(); }
+
+private:
+    void orderByImportance(const StreetGraph &graph, std::vector<int> &order) const;
+
+private:
+    MemoryAccount               account_;       // first, so it is opened first.
+    std::vector<int>            coreIndex_;     // node -> core index, -1 if not core.
+    std::vector<int>            firstEntry_;    // core index -> first entry of its label.
+    std::vector<unsigned>       firstByte_;     // likewise, into hubBytes_.
+    std::vector<unsigned char>  hubBytes_;      // varint rank differences, by entry.
+    std::vector<double>         distances_;     // miles to the hub of the same entry.
+};
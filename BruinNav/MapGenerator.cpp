@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MapGenerator.h"
+#include "Provided.h"
+
+// Westwood, where the real map is.
+static const double originLatitude  = 34.0600000;
+static const double originLongitude = -118.4450000;
+
+// About 130 m between intersections, each side of a block cut in three.
+static const double blockDegrees   = 0.0012;
+static const int    piecesPerBlock = 3;
+
+// Islands are small grids north of the city, this many blocks wide.
+static const int islandBlocks = 3;
+
+// Organic layouts: how far intersections stray, how much streets bend,
+// and how often a block loses a side or gains a diagonal.
+static const double jitterBlocks   = 0.3;
+static const double bendBlocks     = 0.15;
+static const double gapChance      = 0.08;
+static const double diagonalChance = 0.04;
+
+static const char *const nameStems[] = {
+    "Broxton", "Gayley", "Kinross", "Weyburn", "Tiverton", "Levering", "Glenrock",
+    "Landfair", "Strathmore", "Veteran", "Hilgard", "Malcolm", "Manning", "Wellworth",
+    "Ashton", "Selby", "Westholme", "Warner", "Midvale", "Kelton", "Roebling", "Glendon"
+};
+static const char *const nameSuffixes[] = {
+    "Avenue", "Drive", "Street", "Boulevard", "Place", "Lane", "Way", "Road"
+};
+
+struct Point
+{
+    double latitude;
+    double longitude;
+};
+
+class SyntheticMapWriter
+{
+public:
+    SyntheticMapWriter(const SyntheticMapSpec &spec, std::ostream &out)
+        : spec_(spec), out_(out), random_(spec.seed)
+    {
+    }
+
+    // Writes the street `streetId` from a to b, cut into piecesPerBlock
+    // segments; the points between a and b are new nodes.
+    void writeStreet(int streetId, const Point &a, const Point &b, double bend);
+
+    // Counts a node shared by several streets, once.
+    inline void countNode() { ++stats_.nodes; }
+
+    inline std::mt19937 &random() { return random_; }
+
+    inline const SyntheticMapStats &stats() const { return stats_; }
+
+private:
+    std::string streetName(int streetId) const;
+
+    std::string coordText(const Point &p, const char *separator) const;
+
+    void writeSegment(const std::string &name, const Point &a, const Point &b);
+
+private:
+    const SyntheticMapSpec &spec_;
+    std::ostream           &out_;
+    std::mt19937            random_;
+    SyntheticMapStats       stats_;
+};
+
+// Names repeat every spec_.streetNames streets, if that is set.
+std::string SyntheticMapWriter::streetName(int streetId) const
+{
+    const auto nStems    = sizeof(nameStems) / sizeof(nameStems[0]);
+    const auto nSuffixes = sizeof(nameSuffixes) / sizeof(nameSuffixes[0]);
+    auto nameId = static_cast<size_t>(spec_.streetNames > 0 ? streetId % spec_.streetNames
+                                                            : streetId);
+    auto name   = std::string(nameStems[nameId % nStems]) + " " +
+                  nameSuffixes[nameId / nStems % nSuffixes];
+    auto round  = nameId / (nStems * nSuffixes);
+    return round == 0 ? name : name + " " + std::to_string(round + 1);
+}
+
+std::string SyntheticMapWriter::coordText(const Point &p, const char *separator) const
+{
+    char text[64];
+    std::snprintf(text, sizeof(text), "%.7f%s%.7f", p.latitude, separator, p.longitude);
+    return text;
+}
+
+void SyntheticMapWriter::writeStreet(int streetId, const Point &a, const Point &b, double bend)
+{
+    // Bends sideways by up to `bend` blocks, most in the middle.
+    auto name   = streetName(streetId);
+    auto dLat   = b.latitude - a.latitude;
+    auto dLon   = b.longitude - a.longitude;
+    auto length = std::hypot(dLat, dLon);
+    auto points = std::vector<Point>(piecesPerBlock + 1);
+    for (int k = 0; k <= piecesPerBlock; ++k)
+    {
+        auto t      = static_cast<double>(k) / piecesPerBlock;
+        auto offset = length == 0.0 ? 0.0 : bend * blockDegrees * std::sin(pi * t) / length;
+        points[k]   = { a.latitude + t * dLat - offset * dLon,
+                        a.longitude + t * dLon + offset * dLat };
+    }
+    points.front() = a;
+    points.back()  = b;
+    stats_.nodes  += piecesPerBlock - 1;
+    for (int k = 0; k < piecesPerBlock; ++k)
+    {
+        writeSegment(name, points[k], points[k + 1]);
+    }
+}
+
+// About attractionsPerSegment attractions per segment, four in five in
+// the middle of it and the others at its start.
+void SyntheticMapWriter::writeSegment(const std::string &name, const Point &a, const Point &b)
+{
+    auto uniform = std::uniform_real_distribution<double>(0.0, 1.0);
+    auto nAttractions = static_cast<int>(spec_.attractionsPerSegment);
+    if (uniform(random_) < spec_.attractionsPerSegment - nAttractions)
+    {
+        ++nAttractions;
+    }
+
+    out_ << name << "\n" << coordText(a, ", ") << " " << coordText(b, ",") << "\n"
+         << nAttractions << "\n";
+    for (int i = 0; i < nAttractions; ++i)
+    {
+        auto t = uniform(random_) < 0.8 ? 0.2 + 0.6 * uniform(random_) : 0.0;
+        auto location = Point{ a.latitude + t * (b.latitude - a.latitude),
+                               a.longitude + t * (b.longitude - a.longitude) };
+        out_ << 100 + stats_.attractions << " " << name << "|"
+             << coordText(t == 0.0 ? a : location, ", ") << "\n";
+        ++stats_.attractions;
+    }
+    ++stats_.segments;
+}
+
+// Square blocks: a degree of longitude is shorter than one of latitude.
+static Point gridPoint(double row, double column)
+{
+    auto latitude = originLatitude + row * blockDegrees;
+    return { latitude, originLongitude +
+             column * blockDegrees / std::cos(deg2rad(latitude)) };
+}
+
+SyntheticMapStats writeSyntheticMap(const SyntheticMapSpec &spec, std::ostream &out)
+{
+    auto writer = SyntheticMapWriter(spec, out);
+    auto &random = writer.random();
+    auto uniform = std::uniform_real_distribution<double>(0.0, 1.0);
+    auto organic = spec.layout == ORGANIC_LAYOUT;
+
+    // An n by n grid of blocks has 2n(n + 1) sides.
+    auto n = std::max(1, static_cast<int>(std::sqrt(
+        static_cast<double>(spec.segments) / (2 * piecesPerBlock))));
+    auto corner = [&](int i, int j) { return i * (n + 1) + j; };
+    auto corners = std::vector<Point>((n + 1) * (n + 1));
+    for (int i = 0; i <= n; ++i)
+    {
+        for (int j = 0; j <= n; ++j)
+        {
+            auto row    = i - n / 2.0;
+            auto column = j - n / 2.0;
+            if (organic)
+            {
+                row    += jitterBlocks * (2.0 * uniform(random) - 1.0);
+                column += jitterBlocks * (2.0 * uniform(random) - 1.0);
+            }
+            corners[corner(i, j)] = gridPoint(row, column);
+        }
+    }
+
+    // Street i runs along row i, street n + 1 + j along column j, and the
+    // diagonals are numbered after them.
+    auto used = std::vector<bool>(size(corners), false);
+    auto side = [&](int streetId, int from, int to) {
+        if (organic and uniform(random) < gapChance)
+        {
+            return;
+        }
+        auto bend = organic ? bendBlocks * (2.0 * uniform(random) - 1.0) : 0.0;
+        writer.writeStreet(streetId, corners[from], corners[to], bend);
+        used[from] = used[to] = true;
+    };
+    for (int i = 0; i <= n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            side(i, corner(i, j), corner(i, j + 1));
+        }
+    }
+    for (int j = 0; j <= n; ++j)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            side(n + 1 + j, corner(i, j), corner(i + 1, j));
+        }
+    }
+    auto nextStreet = 2 * (n + 1);
+    if (organic)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                if (uniform(random) < diagonalChance)
+                {
+                    side(nextStreet++, corner(i, j), corner(i + 1, j + 1));
+                }
+            }
+        }
+    }
+    for (auto isUsed : used)
+    {
+        if (isUsed)
+        {
+            writer.countNode();
+        }
+    }
+
+    // Islands: plain grids past the north edge, a few blocks apart.
+    for (int island = 0; island < spec.islands; ++island)
+    {
+        auto south = n / 2.0 + 2.0 + island * (islandBlocks + 2.0);
+        auto west  = -islandBlocks / 2.0;
+        for (int k = 0; k <= islandBlocks; ++k)
+        {
+            for (int m = 0; m < islandBlocks; ++m)
+            {
+                writer.writeStreet(nextStreet + k, gridPoint(south + k, west + m),
+                                   gridPoint(south + k, west + m + 1), 0.0);
+                writer.writeStreet(nextStreet + islandBlocks + 1 + k,
+                                   gridPoint(south + m, west + k),
+                                   gridPoint(south + m + 1, west + k), 0.0);
+            }
+        }
+        nextStreet += 2 * (islandBlocks + 1);
+        for (int k = 0; k < (islandBlocks + 1) * (islandBlocks + 1); ++k)
+        {
+            writer.countNode();
+        }
+    }
+    return writer.stats();
+}
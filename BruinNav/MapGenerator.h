@@ -0,0 +1,40 @@
+#pragma once
+
+#include <ostream>
+
+// Street layouts writeSyntheticMap can lay out.
+enum MapLayout
+{
+    GRID_LAYOUT,        // straight streets on a regular lattice of blocks.
+    ORGANIC_LAYOUT      // jittered, bending streets with gaps and cut-throughs.
+};
+
+struct SyntheticMapSpec
+{
+    long long   segments             = 100000;  // about; islands come on top.
+    MapLayout   layout               = GRID_LAYOUT;
+    int         streetNames          = 0;       // distinct names, 0 for one per street.
+    double      attractionsPerSegment = 0.05;
+    int         islands              = 0;       // small grids joined to nothing else.
+    unsigned    seed                 = 1;
+};
+
+// What was written.
+struct SyntheticMapStats
+{
+    long long segments    = 0;
+    long long nodes       = 0;
+    long long attractions = 0;
+};
+
+/**
+ *  Writes a made-up city in the mapdata.txt format around Westwood, for
+ *  measuring the loader, the indexes and the searches well beyond the size
+ *  of the real map. Blocks are split into several segments, as real streets
+ *  are, so most nodes join two segments. Attractions lie in the middle of
+ *  segments or at their ends, named like addresses and all different.
+ *  The same spec always writes the same file.
+ *
+ *  @return what was written; out reports any failure to write.
+ */
+SyntheticMapStats writeSyntheticMap(const SyntheticMapSpec &spec, std::ostream &out);
@@ -9,6 +9,7 @@
 
 bool MapLoaderImpl::load(std::string mapFile)
 {
+    auto scope = MemoryScope(account_);
     std::ifstream filestream;
     filestream.open(mapFile);
 
@@ -77,6 +78,21 @@ inline bool MapLoaderImpl::getSegment(size_t segNum, StreetSegment &seg) const
     return false;
 }
 
+// The Impl itself is allocated by MapLoader, outside the account.
+size_t MapLoaderImpl::getMemoryBytes() const
+{
+    return sizeof(MapLoaderImpl) + account_.bytes();
+}
+
+size_t MapLoaderImpl::getStringBytes() const
+{
+    auto bytes = size_t(0);
+    for (const auto &street : allStreets_)
+    {
+        bytes += stringBytes(street);
+    }
+    return bytes;
+}
 
 MapLoader::MapLoader() 
     : pImpl_(new MapLoaderImpl) 
@@ -102,3 +118,13 @@ bool MapLoader::getSegment(size_t segNum, StreetSegment &seg) const
 {
     return pImpl_->getSegment(segNum, seg);
 }
+
+size_t MapLoader::getMemoryBytes() const
+{
+    return pImpl_->getMemoryBytes();
+}
+
+size_t MapLoader::getStringBytes() const
+{
+    return pImpl_->getStringBytes();
+}
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "GeoKernels.h"
+#include "MapMatching.h"
+#include "MemoryAccounting.h"
+#include "StreetGraph.h"
+
+// Miles per degree of latitude, or of longitude at the equator.
+static const double milesPerDegree = earthDiameterMiles * pi / 360.0;
+
+// Beyond this many cells the grid coarsens instead.
+static const long long maxGridCells = 1 << 22;
+
+static const double impossible = -std::numeric_limits<double>::infinity();
+
+static double milesBetween(double lat1, double lon1, double lat2, double lon2)
+{
+    auto lat1r = deg2rad(lat1);
+    auto lat2r = deg2rad(lat2);
+    return boundDistance(lat1r, deg2rad(lon1), std::cos(lat1r),
+                         lat2r, deg2rad(lon2), std::cos(lat2r), earthDiameterMiles);
+}
+
+MatchCandidate snapToSegment(const StreetGraph &graph, int segId,
+                             double latitude, double longitude)
+{
+    auto milesPerLongitude = milesPerDegree * std::cos(deg2rad(latitude));
+    const auto &seg   = graph.segment(segId);
+    const auto &start = graph.coord(seg.start);
+    const auto &end   = graph.coord(seg.end);
+    auto ax = (start.longitude - longitude) * milesPerLongitude;
+    auto ay = (start.latitude - latitude) * milesPerDegree;
+    auto dx = (end.longitude - start.longitude) * milesPerLongitude;
+    auto dy = (end.latitude - start.latitude) * milesPerDegree;
+    auto squared  = dx * dx + dy * dy;
+    auto fraction = squared > 0.0 ? std::min(std::max(-(ax * dx + ay * dy) / squared, 0.0), 1.0)
+                                  : 0.0;
+    return { segId, fraction, std::hypot(ax + fraction * dx, ay + fraction * dy) };
+}
+
+SegmentGrid::SegmentGrid(const StreetGraph &graph, double cellDegrees)
+{
+    auto scope = MemoryScope(account_);
+    if (graph.nodeCount() == 0)
+    {
+        firstInCell_.assign(2, 0);
+        return;
+    }
+
+    auto maxLatitude  = -std::numeric_limits<double>::max();
+    auto maxLongitude = -std::numeric_limits<double>::max();
+    minLatitude_  = std::numeric_limits<double>::max();
+    minLongitude_ = std::numeric_limits<double>::max();
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        const auto &gc = graph.coord(v);
+        minLatitude_  = std::min(minLatitude_, gc.latitude);
+        minLongitude_ = std::min(minLongitude_, gc.longitude);
+        maxLatitude   = std::max(maxLatitude, gc.latitude);
+        maxLongitude  = std::max(maxLongitude, gc.longitude);
+    }
+    cellDegrees_ = cellDegrees;
+    auto cellsFor = [&](double degrees) {
+        return (static_cast<long long>((maxLatitude - minLatitude_) / degrees) + 1) *
+               (static_cast<long long>((maxLongitude - minLongitude_) / degrees) + 1);
+    };
+    while (cellsFor(cellDegrees_) > maxGridCells)
+    {
+        cellDegrees_ *= 2.0;
+    }
+    nRows_    = row(maxLatitude) + 1;
+    nColumns_ = column(maxLongitude) + 1;
+
+    // Count the segments of each cell, then place them.
+    auto forEachCell = [&](int segId, auto visit) {
+        const auto &seg   = graph.segment(segId);
+        const auto &start = graph.coord(seg.start);
+        const auto &end   = graph.coord(seg.end);
+        for (auto r = row(std::min(start.latitude, end.latitude));
+             r <= row(std::max(start.latitude, end.latitude)); ++r)
+        {
+            for (auto c = column(std::min(start.longitude, end.longitude));
+                 c <= column(std::max(start.longitude, end.longitude)); ++c)
+            {
+                visit(r * nColumns_ + c);
+            }
+        }
+    };
+    firstInCell_.assign(static_cast<size_t>(nRows_) * nColumns_ + 1, 0);
+    for (int s = 0; s < graph.segmentCount(); ++s)
+    {
+        forEachCell(s, [&](int cell) { ++firstInCell_[cell + 1]; });
+    }
+    for (size_t cell = 1; cell < size(firstInCell_); ++cell)
+    {
+        firstInCell_[cell] += firstInCell_[cell - 1];
+    }
+    cellSegments_.resize(firstInCell_.back());
+    auto filled = std::vector<int>(begin(firstInCell_), end(firstInCell_) - 1);
+    for (int s = 0; s < graph.segmentCount(); ++s)
+    {
+        forEachCell(s, [&](int cell) { cellSegments_[filled[cell]++] = s; });
+    }
+}
+
+inline int SegmentGrid::row(double latitude) const
+{
+    auto r = static_cast<int>(std::floor((latitude - minLatitude_) / cellDegrees_));
+    return std::min(std::max(r, 0), nRows_ - 1);
+}
+
+inline int SegmentGrid::column(double longitude) const
+{
+    auto c = static_cast<int>(std::floor((longitude - minLongitude_) / cellDegrees_));
+    return std::min(std::max(c, 0), nColumns_ - 1);
+}
+
+void SegmentGrid::near(double latitude, double longitude, double radius,
+                       std::vector<int> &segIds) const
+{
+    segIds.clear();
+    auto dLatitude  = radius / milesPerDegree;
+    auto dLongitude = dLatitude / std::max(std::cos(deg2rad(latitude)), 1e-6);
+    for (auto r = row(latitude - dLatitude); r <= row(latitude + dLatitude); ++r)
+    {
+        for (auto c = column(longitude - dLongitude); c <= column(longitude + dLongitude); ++c)
+        {
+            auto cell = r * nColumns_ + c;
+            segIds.insert(end(segIds), begin(cellSegments_) + firstInCell_[cell],
+                          begin(cellSegments_) + firstInCell_[cell + 1]);
+        }
+    }
+    std::sort(begin(segIds), end(segIds));
+    segIds.erase(std::unique(begin(segIds), end(segIds)), end(segIds));
+}
+
+HmmMatcher::HmmMatcher(const StreetGraph &graph, const SegmentGrid &grid,
+                       const MatchOptions &options)
+    : graph_(graph), grid_(grid), options_(options)
+{
+}
+
+// Points are projected onto the segments in a plane tangent at the ping,
+// which is exact enough within a candidate radius.
+void HmmMatcher::findCandidates(double latitude, double longitude)
+{
+    candidates_.clear();
+    grid_.near(latitude, longitude, options_.candidateRadius, nearSegments_);
+    for (auto segId : nearSegments_)
+    {
+        auto candidate = snapToSegment(graph_, segId, latitude, longitude);
+        if (candidate.distance <= options_.candidateRadius)
+        {
+            candidates_.emplace_back(candidate);
+        }
+    }
+    std::sort(begin(candidates_), end(candidates_),
+        [](const MatchCandidate &c1, const MatchCandidate &c2) {
+            return c1.distance < c2.distance;
+        });
+    if (size(candidates_) > static_cast<size_t>(std::max(options_.maxCandidates, 1)))
+    {
+        candidates_.resize(std::max(options_.maxCandidates, 1));
+    }
+}
+
+bool HmmMatcher::connect(const MatchStep &before, MatchStep &step)
+{
+    auto straight = milesBetween(before.latitude, before.longitude, step.latitude, step.longitude);
+    auto limit    = straight + options_.maxDetour;
+    auto elapsed  = step.seconds - before.seconds;
+    if (elapsed > 0.0)
+    {
+        limit = std::min(limit, options_.maxSpeedMph * elapsed / 3600.0 +
+                                2.0 * options_.candidateRadius);
+    }
+
+    while (size(trees_) < size(before.states))
+    {
+        trees_.emplace_back(std::make_unique<MatchTree>(graph_));
+    }
+    // Node of the target segment each state is entered by, -1 along the
+    // segment of the state before.
+    auto entries   = std::vector<int>(size(step.states), -1);
+    auto reachable = false;
+    for (int i = 0; i < static_cast<int>(size(before.states)); ++i)
+    {
+        const auto &from = before.states[i];
+        if (from.score == impossible)
+        {
+            continue;
+        }
+        const auto &fromSeg = graph_.segment(from.candidate.segment);
+        auto &tree = *trees_[i];
+        tree.reset();
+        tree.addSeed(fromSeg.start, from.candidate.fraction * fromSeg.length);
+        tree.addSeed(fromSeg.end, (1.0 - from.candidate.fraction) * fromSeg.length);
+        tree.grow(limit);
+
+        for (int j = 0; j < static_cast<int>(size(step.states)); ++j)
+        {
+            auto &to         = step.states[j];
+            const auto &toSeg = graph_.segment(to.candidate.segment);
+            auto driven = std::numeric_limits<double>::max();
+            auto entry  = -1;
+            if (to.candidate.segment == from.candidate.segment)
+            {
+                driven = std::fabs(to.candidate.fraction - from.candidate.fraction) * toSeg.length;
+            }
+            for (auto node : { toSeg.start, toSeg.end })
+            {
+                auto rest = (node == toSeg.start ? to.candidate.fraction
+                                                 : 1.0 - to.candidate.fraction) * toSeg.length;
+                if (tree.isSettled(node) and tree.distance(node) + rest < driven)
+                {
+                    driven = tree.distance(node) + rest;
+                    entry  = node;
+                }
+            }
+            if (driven > limit)
+            {
+                continue;
+            }
+
+            auto emission   = to.candidate.distance / options_.gpsSigma;
+            auto transition = std::fabs(driven - straight) / options_.beta;
+            auto score      = from.score - 0.5 * emission * emission - transition;
+            if (score > to.score)
+            {
+                to.score   = score;
+                to.previous = i;
+                entries[j] = entry;
+                reachable  = true;
+            }
+        }
+    }
+
+    // Unwind the parent arcs of the winning searches into the segments
+    // driven between the two states.
+    for (int j = 0; j < static_cast<int>(size(step.states)); ++j)
+    {
+        auto &to = step.states[j];
+        to.via.clear();
+        if (to.score == impossible or entries[j] == -1)
+        {
+            continue;
+        }
+        const auto &tree = *trees_[to.previous];
+        for (auto node = entries[j]; tree.parentArc(node) != -1; )
+        {
+            const auto &arc = graph_.arc(tree.parentArc(node));
+            to.via.emplace_back(arc.segment);
+            node = arc.tail;
+        }
+        std::reverse(begin(to.via), end(to.via));
+    }
+    return reachable;
+}
+
+void HmmMatcher::add(const GpsPing &ping, std::vector<int> &path)
+{
+    findCandidates(ping.location.latitude, ping.location.longitude);
+    if (candidates_.empty())
+    {
+        return;
+    }
+
+    auto step = MatchStep{ ping.location.latitude, ping.location.longitude, ping.seconds, {} };
+    for (const auto &candidate : candidates_)
+    {
+        step.states.push_back({ candidate, impossible, -1, {} });
+    }
+    if (window_.empty() or !connect(window_.back(), step))
+    {
+        finish(path);
+        for (auto &state : step.states)
+        {
+            auto emission = state.candidate.distance / options_.gpsSigma;
+            state.score    = -0.5 * emission * emission;
+            state.previous = -1;
+            state.via.clear();
+        }
+    }
+
+    // Keep the scores near 0; only their differences matter.
+    auto best = impossible;
+    for (const auto &state : step.states)
+    {
+        best = std::max(best, state.score);
+    }
+    for (auto &state : step.states)
+    {
+        if (state.score != impossible)
+        {
+            state.score -= best;
+        }
+    }
+    window_.push_back(std::move(step));
+
+    // The latest ping stays: the next one is scored from its states.
+    while (size(window_) > 1)
+    {
+        const auto &latest = window_.back().states;
+        auto agreed = -1;
+        auto agree  = true;
+        auto bestState = -1;
+        for (int s = 0; s < static_cast<int>(size(latest)); ++s)
+        {
+            if (latest[s].score == impossible)
+            {
+                continue;
+            }
+            auto first = ancestor(s);
+            agree  = agree and (agreed == -1 or agreed == first);
+            agreed = first;
+            if (bestState == -1 or latest[s].score > latest[bestState].score)
+            {
+                bestState = s;
+            }
+        }
+        if (agree)
+        {
+            commitFront(agreed, path);
+        }
+        else if (size(window_) > static_cast<size_t>(options_.maxLag) + 1)
+        {
+            commitFront(ancestor(bestState), path);
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+void HmmMatcher::finish(std::vector<int> &path)
+{
+    if (window_.empty())
+    {
+        return;
+    }
+    const auto &latest = window_.back().states;
+    auto bestState = 0;
+    for (int s = 1; s < static_cast<int>(size(latest)); ++s)
+    {
+        if (latest[s].score > latest[bestState].score)
+        {
+            bestState = s;
+        }
+    }
+    while (!window_.empty())
+    {
+        commitFront(size(window_) == 1 ? bestState : ancestor(bestState), path);
+    }
+    lastSegment_ = -1;
+}
+
+int HmmMatcher::ancestor(int state) const
+{
+    for (auto step = size(window_) - 1; step > 0; --step)
+    {
+        state = window_[step].states[state].previous;
+    }
+    return state;
+}
+
+// Paths into the states of later pings that do not go through the state
+// decided are dropped.
+void HmmMatcher::commitFront(int state, std::vector<int> &path)
+{
+    {
+        const auto &decided = window_.front().states[state];
+        for (auto segId : decided.via)
+        {
+            append(segId, path);
+        }
+        append(decided.candidate.segment, path);
+    }
+    window_.pop_front();
+
+    for (size_t step = 0; step < size(window_); ++step)
+    {
+        for (auto &later : window_[step].states)
+        {
+            // Unreachable states have no previous state to look at.
+            if (later.score == impossible)
+            {
+                continue;
+            }
+            if (step == 0 ? later.previous != state
+                          : window_[step - 1].states[later.previous].score == impossible)
+            {
+                later.score = impossible;
+            }
+        }
+    }
+}
+
+void HmmMatcher::append(int segId, std::vector<int> &path)
+{
+    if (segId != lastSegment_)
+    {
+        path.emplace_back(segId);
+        lastSegment_ = segId;
+    }
+}
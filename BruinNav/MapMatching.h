@@ -0,0 +1,145 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "Provided.h"
+#include "SearchPolicies.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+
+/**
+ *  Uniform grid over the segments of a StreetGraph, for finding the
+ *  segments near a point. Each cell lists the segments whose bounding box
+ *  overlaps it; the lists are stored back to back in one array.
+ */
+class SegmentGrid
+{
+public:
+    SegmentGrid(const SegmentGrid &other)          = delete;
+    SegmentGrid &operator=(const SegmentGrid &rhs) = delete;
+
+public:
+    // Cells are made larger than cellDegrees if the grid would be too big.
+    explicit SegmentGrid(const StreetGraph &graph, double cellDegrees = 0.002);
+
+    /**
+     *  @param segIds receives, once each and in increasing order, every
+     *                segment within radius miles of the point, and maybe
+     *                some a little farther.
+     */
+    void near(double latitude, double longitude, double radius,
+              std::vector<int> &segIds) const;
+
+    // Heap bytes held by the grid, counted as they were allocated.
+    inline size_t memoryBytes() const { return account_.bytes(); }
+
+private:
+    inline int row(double latitude) const;
+    inline int column(double longitude) const;
+
+private:
+    MemoryAccount       account_;   // first, so it is opened first.
+    double              minLatitude_  = 0.0;
+    double              minLongitude_ = 0.0;
+    double              cellDegrees_  = 1.0;
+    int                 nRows_        = 1;
+    int                 nColumns_     = 1;
+    std::vector<int>    firstInCell_;   // by row, then column; one past the end last.
+    std::vector<int>    cellSegments_;
+};
+
+// A ping snapped onto a segment.
+struct MatchCandidate
+{
+    int    segment;
+    double fraction;    // of the segment, from its start node to the point.
+    double distance;    // miles from the ping to the point.
+};
+
+// The point of segment segId closest to the given one, on a flat map around it.
+MatchCandidate snapToSegment(const StreetGraph &graph, int segId,
+                             double latitude, double longitude);
+
+/**
+ *  Map matching with a hidden Markov model (Newson and Krumm, 2009). The
+ *  hidden states of a ping are its candidates: the closest points of the
+ *  segments within options.candidateRadius. A candidate is likelier the
+ *  closer it is (Gaussian GPS error of spread gpsSigma), and a move from
+ *  one candidate to the next the closer its driving distance is to the
+ *  straight line between the pings (exponential, scale beta). Driving
+ *  distances come from one Dijkstra search per candidate, bounded by
+ *  maxDetour and by maxSpeedMph, and Viterbi decoding picks the likeliest
+ *  sequence of candidates.
+ *
+ *  Decoding is online: the states of the latest pings are kept, and a ping
+ *  is decided as soon as the best paths into every state of the latest
+ *  ping agree on it, or once maxLag pings have come after it. A ping with
+ *  no candidate is skipped; a ping no candidate of the one before can reach
+ *  starts the trace over, and both pieces are returned back to back.
+ *
+ *  Works on segment ids of the graph; not thread-safe.
+ */
+class HmmMatcher
+{
+public:
+    HmmMatcher(const HmmMatcher &other)          = delete;
+    HmmMatcher &operator=(const HmmMatcher &rhs) = delete;
+
+public:
+    HmmMatcher(const StreetGraph &graph, const SegmentGrid &grid, const MatchOptions &options);
+
+    // Adds the next ping of the trace, then appends to path the segments
+    // driven up to the pings now decided.
+    void add(const GpsPing &ping, std::vector<int> &path);
+
+    // Decides every ping left and appends the rest of the path; the matcher
+    // then starts a new trace.
+    void finish(std::vector<int> &path);
+
+private:
+    // Search limited to the few hundred nodes around a pair of pings.
+    using MatchTree = SearchTree<NoBound, Forward, ArcLength, QuaternaryHeap, SparseLabels>;
+
+    struct MatchState
+    {
+        MatchCandidate      candidate;
+        double              score;      // log-likelihood of the best path ending here.
+        int                 previous;   // state of the step before on that path, -1 if none.
+        std::vector<int>    via;        // segments driven between the two, in order.
+    };
+
+    struct MatchStep
+    {
+        double                  latitude;
+        double                  longitude;
+        double                  seconds;
+        std::vector<MatchState> states;
+    };
+
+    void findCandidates(double latitude, double longitude);
+
+    // Scores the states of step from those of the step before; false if
+    // none of them can be reached.
+    bool connect(const MatchStep &before, MatchStep &step);
+
+    // State of the first step kept that the best path into state of the
+    // latest step goes through.
+    int ancestor(int state) const;
+
+    void commitFront(int state, std::vector<int> &path);
+
+    void append(int segId, std::vector<int> &path);
+
+private:
+    const StreetGraph                       &graph_;
+    const SegmentGrid                       &grid_;
+    MatchOptions                            options_;
+    std::deque<MatchStep>                   window_;    // the pings not decided yet.
+    std::vector<std::unique_ptr<MatchTree>> trees_;
+    std::vector<int>                        nearSegments_;
+    std::vector<MatchCandidate>             candidates_;
+    int                                     lastSegment_ = -1;
+};
@@ -0,0 +1,156 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "MemoryAccounting.h"
+#include "Provided.h"
+
+struct MemoryCounters
+{
+    std::atomic<size_t>     bytes{ 0 };
+    std::atomic<size_t>     peak{ 0 };
+    std::atomic<long long>  allocations{ 0 };
+    std::atomic<int>        references{ 1 };    // the account and each live block.
+};
+
+// Put in front of every block, keeping the alignment operator new promises.
+struct alignas(alignof(std::max_align_t)) BlockHeader
+{
+    size_t          size;
+    MemoryCounters *counters;
+};
+
+// Zero-initialised, so it is usable before any constructor has run.
+static thread_local MemoryCounters *charged = nullptr;
+static thread_local long long       nAllocated = 0;
+static thread_local long long       nFreed     = 0;
+
+static void release(MemoryCounters *counters)
+{
+    if (counters->references.fetch_sub(1) == 1)
+    {
+        counters->~MemoryCounters();
+        std::free(counters);
+    }
+}
+
+void *allocateCharged(size_t size) noexcept
+{
+    auto header = static_cast<BlockHeader *>(std::malloc(sizeof(BlockHeader) + size));
+    if (header == nullptr)
+    {
+        return nullptr;
+    }
+    ++nAllocated;
+    header->size     = size;
+    header->counters = charged;
+    if (charged != nullptr)
+    {
+        charged->references.fetch_add(1, std::memory_order_relaxed);
+        charged->allocations.fetch_add(1, std::memory_order_relaxed);
+        auto bytes = charged->bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        auto peak  = charged->peak.load(std::memory_order_relaxed);
+        while (bytes > peak and !charged->peak.compare_exchange_weak(peak, bytes))
+        {
+        }
+    }
+    return header + 1;
+}
+
+void deallocateCharged(void *block) noexcept
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+    ++nFreed;
+    auto header = static_cast<BlockHeader *>(block) - 1;
+    if (header->counters != nullptr)
+    {
+        header->counters->bytes.fetch_sub(header->size, std::memory_order_relaxed);
+        release(header->counters);
+    }
+    std::free(header);
+}
+
+// The counters are malloc'ed, so opening an account is not charged to the
+// account in scope.
+MemoryAccount::MemoryAccount()
+{
+    auto memory = std::malloc(sizeof(MemoryCounters));
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    counters_ = new (memory) MemoryCounters();
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    release(counters_);
+}
+
+size_t MemoryAccount::bytes() const
+{
+    return counters_->bytes.load();
+}
+
+size_t MemoryAccount::peakBytes() const
+{
+    return counters_->peak.load();
+}
+
+long long MemoryAccount::allocations() const
+{
+    return counters_->allocations.load();
+}
+
+void MemoryAccount::resetPeak()
+{
+    counters_->peak.store(counters_->bytes.load());
+}
+
+MemoryScope::MemoryScope(MemoryAccount &account)
+    : previous_(charged)
+{
+    charged = account.counters_;
+}
+
+MemoryScope::~MemoryScope()
+{
+    charged = previous_;
+}
+
+long long threadAllocations()
+{
+    return nAllocated;
+}
+
+long long threadDeallocations()
+{
+    return nFreed;
+}
+
+size_t stringBytes(const std::string &text)
+{
+    static const auto localCapacity = std::string().capacity();
+    return text.capacity() > localCapacity ? text.capacity() + 1 : 0;
+}
+
+size_t stringBytes(const GeoCoord &gc)
+{
+    return stringBytes(gc.sLatitude) + stringBytes(gc.sLongitude);
+}
+
+size_t stringBytes(const StreetSegment &street)
+{
+    auto bytes = stringBytes(street.streetName) + stringBytes(street.segment.start) +
+                 stringBytes(street.segment.end);
+    for (const auto &address : street.attractionsOnThisSegment)
+    {
+        bytes += stringBytes(address.attraction) + stringBytes(address.location);
+    }
+    return bytes;
+}
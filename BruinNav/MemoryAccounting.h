@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Provided.h"
+
+struct MemoryCounters;
+
+/**
+ *  Bytes allocated through operator new while the account was charged (see
+ *  MemoryScope) and not freed yet, wherever and whenever they are freed.
+ *  The counts are kept by replacing the global operator new and delete,
+ *  which a program opts into (see MemoryHooks.cpp); without that every
+ *  account reads 0. Every block then carries a small header naming the
+ *  account it is charged to, so the counts are exact. Sizes are those
+ *  requested; the header and malloc's own overhead are not counted.
+ *
+ *  The counters outlive the account as long as blocks charged to it do.
+ */
+class MemoryAccount
+{
+public:
+    MemoryAccount(const MemoryAccount &other)          = delete;
+    MemoryAccount &operator=(const MemoryAccount &rhs) = delete;
+
+public:
+    MemoryAccount();
+    ~MemoryAccount();
+
+    size_t bytes() const;
+
+    // Highest bytes() since the account was opened or resetPeak was called.
+    size_t peakBytes() const;
+
+    // Number of blocks ever charged to the account.
+    long long allocations() const;
+
+    void resetPeak();
+
+private:
+    friend class MemoryScope;
+
+    MemoryCounters *counters_;
+};
+
+// Charges the allocations of the current thread to an account while it
+// lives. Scopes nest; the innermost one is charged.
+class MemoryScope
+{
+public:
+    MemoryScope(const MemoryScope &other)          = delete;
+    MemoryScope &operator=(const MemoryScope &rhs) = delete;
+
+public:
+    explicit MemoryScope(MemoryAccount &account);
+    ~MemoryScope();
+
+private:
+    MemoryCounters *previous_;
+};
+
+// Blocks allocated and freed through operator new and delete by the calling
+// thread so far, whatever account they were charged to; 0 without the hooks.
+long long threadAllocations();
+
+long long threadDeallocations();
+
+// Whether this program replaced operator new and delete to keep the counts.
+bool memoryHooksInstalled();
+
+// What the replaced operator new and delete call. The blocks of one are
+// only ever freed by the other.
+void *allocateCharged(size_t size) noexcept;
+
+void deallocateCharged(void *block) noexcept;
+
+/**
+ *  Heap bytes held by string buffers, for reports that break them out.
+ *  Strings short enough to be stored inside the string object hold none.
+ */
+size_t stringBytes(const std::string &text);
+
+size_t stringBytes(const GeoCoord &gc);
+
+size_t stringBytes(const StreetSegment &street);
+
+// Heap bytes of a vector's buffer, whatever its elements point to in turn.
+template <class T>
+inline size_t vectorBytes(const std::vector<T> &items)
+{
+    return items.capacity() * sizeof(T);
+}
+
+inline size_t vectorBytes(const std::vector<bool> &items)
+{
+    return items.capacity() / 8;
+}
@@ -0,0 +1,61 @@
+#include <cstddef>
+#include <new>
+
+#include "MemoryAccounting.h"
+
+// The replacements of the global operator new and delete that MemoryAccount
+// counts through. They put a header on every block of the whole program, so
+// they are compiled in only where BRUINNAV_MEMORY_HOOKS is defined, as the
+// test and bench builds do.
+#ifdef BRUINNAV_MEMORY_HOOKS
+
+void *operator new(size_t size)
+{
+    auto block = allocateCharged(size);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocateCharged(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocateCharged(size);
+}
+
+void operator delete(void *block) noexcept { deallocateCharged(block); }
+
+void operator delete[](void *block) noexcept { deallocateCharged(block); }
+
+void operator delete(void *block, size_t) noexcept { deallocateCharged(block); }
+
+void operator delete[](void *block, size_t) noexcept { deallocateCharged(block); }
+
+void operator delete(void *block, const std::nothrow_t &) noexcept { deallocateCharged(block); }
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept { deallocateCharged(block); }
+
+bool memoryHooksInstalled()
+{
+    return true;
+}
+
+#else
+
+bool memoryHooksInstalled()
+{
+    return false;
+}
+
+#endif
@@ -33,6 +33,12 @@ public:
         nNodes_ = 0; 
     }
 
+    // Heap bytes of the tree nodes, not of what keys and values point to.
+    inline size_t nodeBytes() const
+    {
+        return static_cast<size_t>(nNodes_) * sizeof(node);
+    }
+
     inline int size() const
     {
         return nNodes_;
@@ -43,23 +49,17 @@ public:
         root_ = updateOrInsert(root_, key, value);
     }
 
+    // A plain walk down the tree: lookups allocate nothing.
     const ValueType *find(const KeyType &key) const
     {
-        auto toBeSearched = std::queue<node *>{};
-        toBeSearched.push(root_);
-        while (!empty(toBeSearched))
+        auto current = root_;
+        while (current != nullptr)
         {
-            auto current = toBeSearched.front();
-            if (current != nullptr)
+            if (current->key == key)
             {
-                if (current->key == key)
-                {
-                    return &current->value;
-                }
-                auto nextNode = (key > current->key) ? current->right : current->left;
-                toBeSearched.push(nextNode);
+                return &current->value;
             }
-            toBeSearched.pop();
+            current = (key > current->key) ? current->right : current->left;
         }
         return nullptr;
     }
@@ -69,6 +69,25 @@ public:
         return const_cast<ValueType *>(const_cast<const MyMap *>(this)->find(key));
     }
 
+    // Calls visit(key, value) for every association, in level order.
+    template <typename Visitor>
+    void forEach(Visitor visit) const
+    {
+        auto toBeVisited = std::queue<const node *>{};
+        toBeVisited.push(root_);
+        while (!empty(toBeVisited))
+        {
+            auto current = toBeVisited.front();
+            toBeVisited.pop();
+            if (current != nullptr)
+            {
+                visit(current->key, current->value);
+                toBeVisited.push(current->left);
+                toBeVisited.push(current->right);
+            }
+        }
+    }
+
 private:
     struct node
     {
@@ -1,16 +1,120 @@
 #pragma inline_recursion(on)
 
+#include <algorithm>
 #include <cassert>
+#include <fstream>
 #include <functional>
-#include <queue>
-#include <stack>
+#include <memory>
 
-#include "MyMap.h"
+#include "GeoKernels.h"
 #include "Provided.h"
+#include "SearchPolicies.h"
 #include "Support.h"
 
 
 
+MapSnapshot::MapSnapshot(const MapLoader &ml)
+    : segmentStorageBytes(ml.getMemoryBytes()), graph(ml)
+{
+    attractionMapper.init(ml);
+    segmentMapper.init(ml);
+}
+
+// The last stretch of an arc search onto a destination in the middle of a
+// segment.
+struct TargetLeg
+{
+    int    node;
+    int    arc;
+    double remaining;
+};
+
+// Buffers of navigate, kept by each thread from one query to the next, so
+// a thread that has run a query searches without allocating. Labels are
+// by chain; only those a search touched are cleared for the next one.
+struct RouteScratch
+{
+    MemoryAccount           account;
+    int                     nChains = -1;
+    DenseLabels             labels;
+    QuaternaryHeap          open;
+    std::vector<double>     hScores;
+    std::vector<TargetLeg>  legs;
+    std::vector<int>        chainArcs;
+    CompactRoute            route;      // of the directions overload.
+    std::string             startName;  // lowered for the lookup.
+    std::string             endName;
+    GeoCoord                gcSrc;
+    GeoCoord                gcDst;
+};
+
+static RouteScratch &routeScratch()
+{
+    static thread_local RouteScratch scratch;
+    return scratch;
+}
+
+// Charges the allocations of a navigate to the scratch account of its
+// thread, and publishes their peak, buffers kept included, when the
+// navigate returns.
+class ScratchMeter
+{
+public:
+    explicit ScratchMeter(std::atomic<size_t> &peak)
+        : peak_(peak), account_(routeScratch().account), scope_(account_)
+    {
+        account_.resetPeak();
+    }
+
+    ~ScratchMeter()
+    {
+        peak_.store(account_.peakBytes());
+    }
+
+private:
+    std::atomic<size_t>    &peak_;
+    MemoryAccount          &account_;
+    MemoryScope             scope_;
+};
+
+// Tracers of searchArcs. Untraced searches get the empty one, so they
+// compile to the search alone.
+struct NoTrace
+{
+    inline void settle(int, double, double) {}
+};
+
+class ChainTracer
+{
+public:
+    ChainTracer(const StreetGraph &graph, SearchTrace &trace)
+        : graph_(graph), trace_(trace)
+    {
+    }
+
+    void settle(int chainId, double g, double f)
+    {
+        const auto &from = graph_.coord(graph_.arc(chainId).tail);
+        const auto &to   = graph_.coord(graph_.chainHead(chainId));
+        trace_.steps.push_back({ { from.latitude, from.longitude },
+                                 { to.latitude, to.longitude }, g, f });
+    }
+
+private:
+    const StreetGraph  &graph_;
+    SearchTrace        &trace_;
+};
+
+// Starts with an empty map, so queries before the first load find nothing.
+NavigatorImpl::NavigatorImpl()
+    : map_(std::make_shared<const MapSnapshot>(MapLoader())),
+      turnSettings_(std::make_shared<const TurnSettings>())
+{
+}
+
+// The new snapshot is built aside and published with one atomic store
+// (read-copy-update); the old one is freed by the last query holding it.
+// Hub labels, once asked for, are rebuilt for it before it is published.
 bool NavigatorImpl::loadMapData(std::string mapFile)
 {
     MapLoader initializer;
@@ -18,229 +122,638 @@ bool NavigatorImpl::loadMapData(std::string mapFile)
     {
         return false;
     }
-    attractionMapper_.init(initializer);
-    segmentMapper_.init(initializer);
+    auto map = MapPtr(std::make_shared<const MapSnapshot>(initializer));
+    if (hubLabelsWanted_)
+    {
+        std::atomic_store(&hubLabels_, std::shared_ptr<const HubLabelIndex>(
+            std::make_shared<const HubLabelIndex>(map)));
+    }
+    std::atomic_store(&map_, map);
     return true;
 }
 
-// A* Search Implementation
-// https://en.wikipedia.org/wiki/A*_search_algorithm
-// gScore[current] = gScore[prev] + distance(prev, current);
-// hScore[current] = distance(current, goal);
-// fScore[current] = gScore[current] + hScore[current];
-// Reminder: location.first  == currentGeoCoord, 
-//           location.second == currentStreetName
+// Published with one atomic store, like a map; queries running keep the
+// settings they started with.
+void NavigatorImpl::setTurnPenalties(const TurnPenalties &penalties)
+{
+    auto settings = std::make_shared<TurnSettings>();
+    settings->penalties = penalties;
+    settings->turnAware = penalties.left  > 0.0 or penalties.right        > 0.0 or
+                          penalties.uTurn > 0.0 or penalties.streetChange > 0.0;
+    std::atomic_store(&turnSettings_, std::shared_ptr<const TurnSettings>(std::move(settings)));
+}
+
+// Directions are the compact route of navigateByArcs expanded by
+// getNavSegments, so both overloads find the same route.
 Navigator::NavResult NavigatorImpl::navigate(std::string start, std::string end,
     std::vector<NavSegment> &directions) const
 {
-    auto gcSrc = GeoCoord();
-    auto gcDst = GeoCoord();
+    auto meter    = ScratchMeter(navigatePeak_);
+    auto map      = snapshot();
+    auto &scratch = routeScratch();
+    auto &gcSrc   = scratch.gcSrc;
+    auto &gcDst   = scratch.gcDst;
     // Invalid inputs
-    if (!attractionMapper_.getGeoCoord(start, gcSrc))
+    if (!map->attractionMapper.getGeoCoord(start, gcSrc, scratch.startName))
     {
         return Navigator::NavResult::NAV_BAD_SOURCE;
     }
-    if (!attractionMapper_.getGeoCoord(end, gcDst))
+    if (!map->attractionMapper.getGeoCoord(end, gcDst, scratch.endName))
     {
         return Navigator::NavResult::NAV_BAD_DESTINATION;
     }
+    if (!mayConnect(*map, gcSrc, gcDst))
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+    if (gcSrc == gcDst)
+    {
+        directions.clear();
+        return Navigator::NavResult::NAV_SUCCESS;
+    }
+
+    auto &route = scratch.route;
+    auto result = navigateByArcs(map, *turnSettings(), gcSrc, gcDst, route);
+    if (result == Navigator::NavResult::NAV_SUCCESS)
+    {
+        getNavSegments(route, directions);
+    }
+    route.map.reset();  // the scratch must not keep the snapshot alive.
+    return result;
+}
+
+Navigator::NavResult NavigatorImpl::navigate(const std::string &start,
+    const std::string &end, CompactRoute &route, SearchBudget *budget,
+    SearchTrace *trace) const
+{
+    if (trace == nullptr and samplingTraces_.load(std::memory_order_relaxed))
+    {
+        auto sampling = std::atomic_load(&traceSampling_);
+        auto sample   = nTraceCandidates_++;
+        if (sampling != nullptr and sample % sampling->period == 0)
+        {
+            return navigateSampled(*sampling, sample / sampling->period, start, end,
+                                   route, budget);
+        }
+    }
+    auto meter    = ScratchMeter(navigatePeak_);
+    auto map      = snapshot();
+    auto &scratch = routeScratch();
+    auto &gcSrc   = scratch.gcSrc;
+    auto &gcDst   = scratch.gcDst;
+    if (!map->attractionMapper.getGeoCoord(start, gcSrc, scratch.startName))
+    {
+        return Navigator::NavResult::NAV_BAD_SOURCE;
+    }
+    if (!map->attractionMapper.getGeoCoord(end, gcDst, scratch.endName))
+    {
+        return Navigator::NavResult::NAV_BAD_DESTINATION;
+    }
+    if (!mayConnect(*map, gcSrc, gcDst))
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+    return navigateByArcs(map, *turnSettings(), gcSrc, gcDst, route, budget, trace);
+}
+
+Navigator::NavResult NavigatorImpl::navigateTraced(std::string start, std::string end,
+    CompactRoute &route, SearchTrace &trace) const
+{
+    trace = SearchTrace();
+    trace.start  = start;
+    trace.end    = end;
+    trace.result = navigate(start, end, route, nullptr, &trace);
+    if (trace.result == Navigator::NavResult::NAV_SUCCESS)
+    {
+        traceRoute(route, trace);
+    }
+    return trace.result;
+}
+
+void NavigatorImpl::traceRoute(const CompactRoute &route, SearchTrace &trace) const
+{
+    trace.path.clear();
+    trace.path.push_back({ route.source.latitude, route.source.longitude });
+    for (const auto &navSeg : route.segments)
+    {
+        if (navSeg.command == NavSegment::proceed)
+        {
+            const auto &gc = endOf(*route.map, route, navSeg);
+            trace.path.push_back({ gc.latitude, gc.longitude });
+        }
+    }
+}
+
+// A trace that cannot be written is dropped; the query is answered anyway.
+Navigator::NavResult NavigatorImpl::navigateSampled(const TraceSampling &sampling,
+    long long sample, const std::string &start, const std::string &end,
+    CompactRoute &route, SearchBudget *budget) const
+{
+    auto trace = SearchTrace();
+    trace.start  = start;
+    trace.end    = end;
+    trace.result = navigate(start, end, route, budget, &trace);
+    if (trace.result == Navigator::NavResult::NAV_SUCCESS)
+    {
+        traceRoute(route, trace);
+    }
+    auto out = std::ofstream(sampling.directory + "/trace_" + std::to_string(sample) +
+                             (sampling.format == TRACE_GEOJSON ? ".geojson" : ".bntrace"),
+                             std::ios::binary);
+    writeSearchTrace(trace, sampling.format, out);
+    return trace.result;
+}
+
+void NavigatorImpl::setSearchTracing(int samplePeriod, std::string directory,
+                                     TraceFormat format)
+{
+    if (samplePeriod <= 0)
+    {
+        samplingTraces_ = false;
+        std::atomic_store(&traceSampling_, std::shared_ptr<const TraceSampling>());
+        return;
+    }
+    auto sampling = std::make_shared<const TraceSampling>(
+        TraceSampling{ samplePeriod, directory, format });
+    nTraceCandidates_ = 0;
+    std::atomic_store(&traceSampling_, sampling);
+    samplingTraces_ = true;
+}
+
+// Queries hold the log they started with, so the old one is closed by the
+// last of them.
+bool NavigatorImpl::startQueryLog(std::string logFile)
+{
+    auto log = std::make_shared<QueryLogWriter>();
+    if (!log->open(logFile))
+    {
+        return false;
+    }
+    std::atomic_store(&queryLog_, log);
+    loggingQueries_ = true;
+    return true;
+}
+
+void NavigatorImpl::stopQueryLog()
+{
+    loggingQueries_ = false;
+    std::atomic_store(&queryLog_, std::shared_ptr<QueryLogWriter>());
+}
+
+// Everything but the segment storage is held as long as the map is loaded.
+void NavigatorImpl::getMemoryUsage(MemoryUsage &usage) const
+{
+    auto map = snapshot();
+    usage.measured        = memoryHooksInstalled();
+    usage.segmentStorage  = map->segmentStorageBytes;
+    usage.segmentIndex    = map->segmentMapper.getMemoryBytes();
+    usage.attractionIndex = map->attractionMapper.getMemoryBytes();
+    usage.streetGraph     = map->graph.memoryBytes();
+    auto hubLabels        = std::atomic_load(&hubLabels_);
+    usage.hubLabels       = hubLabels != nullptr and hubLabels->map == map
+                            ? hubLabels->labels.memoryBytes() : 0;
+    usage.strings         = map->segmentMapper.getStringBytes() +
+                            map->attractionMapper.getStringBytes() +
+                            map->graph.stringMemoryBytes();
+    usage.total           = sizeof(MapSnapshot) + usage.segmentIndex +
+                            usage.attractionIndex + usage.streetGraph + usage.hubLabels;
+    usage.navigatePeak    = navigatePeak_.load();
+}
+
+int NavigatorImpl::getComponent(std::string attraction) const
+{
+    auto map = snapshot();
+    auto gc  = GeoCoord();
+    if (!map->attractionMapper.getGeoCoord(attraction, gc))
+    {
+        return -1;
+    }
+    return map->graph.componentOf(gc);
+}
+
+void NavigatorImpl::getComponentSizes(std::vector<int> &sizes) const
+{
+    auto map = snapshot();
+    const auto &graph = map->graph;
+    sizes.resize(graph.componentCount());
+    for (int c = 0; c < graph.componentCount(); ++c)
+    {
+        sizes[c] = graph.componentSize(c);
+    }
+}
+
+// Components are labelled at load time, so pairs on different islands are
+// turned down without exploring the island of the source.
+bool NavigatorImpl::mayConnect(const MapSnapshot &map, const GeoCoord &gcSrc,
+                               const GeoCoord &gcDst) const
+{
+    return map.graph.mayConnect(gcSrc, gcDst);
+}
+
+// Edge-based A* over the chains of the StreetGraph.
+// Labels belong to chains instead of locations, so the penalty of a turn,
+// which depends on the chain we arrived by, can be charged on every
+// relaxation; the turns inside a chain cost the same whichever way we came.
+// gScore[c] = cost of reaching the head of chain c having travelled along c.
+// Sources and destinations attach at core nodes, so a source or destination
+// in the middle of a segment is reached through partial arcs towards (or
+// from) both ends of that segment, each of them a chain of its own.
+// This search keeps a loop of its own rather than running on SearchTree:
+// its labels are chains, a step costs a turn that depends on the chain
+// before it, the bounds of a location's chains are taken in one batch, and
+// it stops at a best cost that falls as destinations are reached.
+Navigator::NavResult NavigatorImpl::navigateByArcs(const MapPtr &map, const TurnSettings &turns,
+    const GeoCoord &gcSrc, const GeoCoord &gcDst, CompactRoute &route, SearchBudget *budget,
+    SearchTrace *trace, const std::vector<int> *srcSegIds) const
+{
+    if (trace == nullptr)
+    {
+        auto tracer = NoTrace();
+        return searchArcs(map, turns, gcSrc, gcDst, route, budget, tracer, srcSegIds);
+    }
+    auto tracer = ChainTracer(map->graph, *trace);
+    return searchArcs(map, turns, gcSrc, gcDst, route, budget, tracer, srcSegIds);
+}
+
+template <class Tracer>
+Navigator::NavResult NavigatorImpl::searchArcs(const MapPtr &map, const TurnSettings &turns,
+    const GeoCoord &gcSrc, const GeoCoord &gcDst, CompactRoute &route, SearchBudget *budget,
+    Tracer &tracer, const std::vector<int> *srcSegIds) const
+{
+    const auto &graph   = map->graph;
+    const auto infinity = std::numeric_limits<double>::max();
+
+    double turnCost[N_TURN_ENTRIES];
+    for (int entry = 0; entry < N_TURN_ENTRIES; ++entry)
+    {
+        auto turnClass  = entry & ~TURN_NAME_CHANGE;
+        turnCost[entry] =
+            turnClass == TURN_LEFT  ? turns.penalties.left  :
+            turnClass == TURN_RIGHT ? turns.penalties.right :
+            turnClass == TURN_UTURN ? turns.penalties.uTurn : 0.0;
+        if (entry & TURN_NAME_CHANGE)
+        {
+            turnCost[entry] += turns.penalties.streetChange;
+        }
+    }
+
+    // gScore and cameFrom are the distance and parent of the labels.
+    auto &scratch  = routeScratch();
+    auto &labels   = scratch.labels;
+    auto &priority = scratch.open;
+    labels.clear();
+    priority.clear();
+    if (scratch.nChains != graph.arcCount())
+    {
+        labels.resize(graph.arcCount());
+        scratch.nChains = graph.arcCount();
+    }
+
+    // hScore is boundDistance to the destination, evaluated for all the arcs
+    // leaving a location at once. It is a hair below the haversine distance,
+    // so an improved arc is reopened even if it was settled already.
+    auto dstLatitude    = deg2rad(gcDst.latitude);
+    auto dstLongitude   = deg2rad(gcDst.longitude);
+    auto dstCosLatitude = std::cos(dstLatitude);
+    auto &hScores       = scratch.hScores;
+    auto hScoreOf = [&](int node) {
+        return boundDistance(graph.latitude(node), graph.longitude(node),
+            graph.cosLatitude(node), dstLatitude, dstLongitude, dstCosLatitude,
+            earthDiameterMiles);
+    };
+    auto relax = [&](int chainId, double g, int from, double hScore) {
+        if (g < labels.distance(chainId))
+        {
+            labels.label(chainId, g, from);
+            priority.push(g + hScore, chainId);
+        }
+    };
+    auto chainCost = [&](int chainId) {
+        auto cost = graph.chainLength(chainId);
+        if (turns.turnAware)
+        {
+            const auto &turns = graph.chainTurns(chainId);
+            for (int entry = 0; entry < N_TURN_ENTRIES; ++entry)
+            {
+                cost += turns[entry] * turnCost[entry];
+            }
+        }
+        return cost;
+    };
 
-    MyMap<GeoCoord, score> scoreMap;
-    auto sortByMinfScore =
-        [&](const locationInfo &loc1, const locationInfo &loc2) {
-            if (scoreMap.find(loc1.first) == nullptr)
+    auto &legs       = scratch.legs;
+    legs.clear();
+    auto srcNode     = srcSegIds != nullptr ? -1 : graph.findNode(gcSrc);
+    auto dstNode     = graph.findNode(gcDst);
+    auto srcSegments = srcSegIds != nullptr ? srcSegIds : graph.attractionSegments(gcSrc);
+    auto dstSegments = graph.attractionSegments(gcDst);
+    if (srcNode == -1 and srcSegments == nullptr)
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+    if (srcNode != -1 and srcNode == dstNode)
+    {
+        RouteWriter(route, map, gcSrc, gcDst).finish();
+        return Navigator::NavResult::NAV_SUCCESS;
+    }
+    if (dstNode == -1 and dstSegments != nullptr)
+    {
+        for (auto segId : *dstSegments)
+        {
+            for (auto forward : { true, false })
             {
-                scoreMap.associate(loc1.first, score());
+                auto arcId = graph.segmentArc(segId, forward);
+                auto node  = graph.arc(arcId).tail;
+                legs.push_back({ node, arcId, distanceEarthMiles(graph.coord(node), gcDst) });
             }
-            if (scoreMap.find(loc2.first) == nullptr)
+        }
+    }
+
+    auto bestCost  = infinity;
+    auto bestChain = -1;
+    auto bestLeg   = -1;
+    auto bestSeg   = -1;    // source and destination share this segment.
+    if (srcNode != -1)
+    {
+        for (int a = graph.firstArc(srcNode); a < graph.firstArc(srcNode + 1); ++a)
+        {
+            relax(a, chainCost(a), -1, hScoreOf(graph.chainHead(a)));
+        }
+        for (int leg = 0; leg < static_cast<int>(size(legs)); ++leg)
+        {
+            if (legs[leg].node == srcNode and legs[leg].remaining < bestCost)
             {
-                scoreMap.associate(loc2.first, score());
+                bestCost = legs[leg].remaining;
+                bestLeg  = leg;
             }
-            return  scoreMap.find(loc1.first)->f > scoreMap.find(loc2.first)->f;
-        };
-    auto priority = std::priority_queue<locationInfo, std::vector<locationInfo>,
-                    decltype(sortByMinfScore)>(sortByMinfScore);
-
-    MyMap<locationInfo, locationInfo> cameFrom; // u -> v, cameFrom[v] = u.
-    MyMap<GeoCoord, bool> open;                 // locations not yet discarded.
-    MyMap<GeoCoord, bool> closed;               // locations discarded.
-
-    // Initialize priority queue.
-    auto initialPaths = segmentMapper_.getSegments(gcSrc);
-    if (size(initialPaths) == 1 and 
-        initialPaths[0].segment.start != gcSrc and
-        initialPaths[0].segment.end   != gcSrc)
-    {
-        auto pathStreetName = initialPaths[0].streetName;
-        auto gc1 = initialPaths[0].segment.start;
-        auto gc2 = initialPaths[0].segment.end;
-        cameFrom.associate({ gc1, pathStreetName }, { gcSrc, pathStreetName });
-        cameFrom.associate({ gc2, pathStreetName }, { gcSrc, pathStreetName });
-        auto gScore1 = distanceEarthMiles(gcSrc, gc1);
-        auto gScore2 = distanceEarthMiles(gcSrc, gc2);
-        auto hScore1 = distanceEarthMiles(gc1, gcDst);
-        auto hScore2 = distanceEarthMiles(gc2, gcDst);
-        scoreMap.associate(gc1, score(gScore1, hScore1));
-        scoreMap.associate(gc2, score(gScore1, hScore2));
-        priority.emplace(gc1, pathStreetName);
-        priority.emplace(gc2, pathStreetName);
-        open.associate(gcSrc, false);
-        closed.associate(gcSrc, true);
+        }
     }
     else
     {
-        priority.emplace(gcSrc, "");
-    } 
+        for (auto segId : *srcSegments)
+        {
+            for (auto forward : { true, false })
+            {
+                auto arcId = graph.segmentArc(segId, forward);
+                auto head  = graph.arc(arcId).head;
+                relax(arcId, distanceEarthMiles(gcSrc, graph.coord(head)), -1, hScoreOf(head));
+            }
+            if (dstSegments != nullptr and dstNode == -1 and
+                distanceEarthMiles(gcSrc, gcDst) < bestCost)
+            {
+                for (auto dstSegId : *dstSegments)
+                {
+                    if (dstSegId == segId)
+                    {
+                        bestCost = distanceEarthMiles(gcSrc, gcDst);
+                        bestSeg  = segId;
+                    }
+                }
+            }
+        }
+    }
 
-    auto fullPath = std::stack<StreetSegment>{};
-    auto finalStreet = StreetSegment();
     while (!priority.empty())
     {
-        auto currLocation = priority.top();
+        auto current = priority.top();
         priority.pop();
-        
-        if (currLocation.first == gcDst)
+
+        if (current.first >= bestCost)
+        {
+            break;
+        }
+        if (budget != nullptr)
         {
-            finalStreet.segment = GeoSegment(currLocation.first, gcDst);
-            finalStreet.streetName = currLocation.second;
-            fullPath.emplace(finalStreet);
-            reconstructPath(cameFrom, fullPath, gcSrc);
-            
-            directions.clear();
-            auto firstStreet = fullPath.top();
-            fullPath.pop();
-            auto firstNavSegment = NavSegment();
-            firstNavSegment.initProceed(getTravelDirection(firstStreet.segment),
-                firstStreet.streetName, distanceEarthMiles(firstStreet), firstStreet.segment);
-            directions.emplace_back(firstNavSegment);      
-            getNavSegments(fullPath, directions, scoreMap, firstStreet.streetName);
-
-            return Navigator::NavResult::NAV_SUCCESS;
+            auto status = budget->check();
+            if (status != Navigator::NavResult::NAV_SUCCESS)
+            {
+                return status;
+            }
         }
+        auto inChain = current.second;
+        if (labels.isSettled(inChain))
+        {
+            continue;
+        }
+        labels.settle(inChain);
 
-        open.associate(currLocation.first, false);
-        closed.associate(currLocation.first, true);
-        
-        auto connections = segmentMapper_.getSegments(currLocation.first);
-        for (auto nextStreet : connections)
+        auto head  = graph.chainHead(inChain);
+        auto inArc = graph.chainLast(inChain);
+        auto curr_gScore = labels.distance(inChain);
+        tracer.settle(inChain, curr_gScore, current.first);
+        if (head == dstNode)
         {
-            auto nextGeoCoord =
-                currLocation.first == nextStreet.segment.start ?
-                nextStreet.segment.end : nextStreet.segment.start;
-            
-            if (contains(closed, nextGeoCoord))
+            if (curr_gScore < bestCost)
             {
-                continue;
+                bestCost  = curr_gScore;
+                bestChain = inChain;
+                bestLeg   = -1;
+                bestSeg   = -1;
             }
-                  
-            auto curr_gScore   = scoreMap.find(currLocation.first)->g;
-            auto distBtwnNodes = distanceEarthMiles(currLocation.first, nextGeoCoord);
-            auto next_gScore   = curr_gScore + distBtwnNodes;
-              
-            if (!contains(open, nextGeoCoord) or
-                next_gScore < scoreMap.find(nextGeoCoord)->g)
+            continue;
+        }
+        for (int leg = 0; leg < static_cast<int>(size(legs)); ++leg)
+        {
+            if (legs[leg].node != head)
             {
-                open.associate(nextGeoCoord, true);      
-                cameFrom.associate({ nextGeoCoord, nextStreet.streetName },
-                    currLocation);
-                auto next_hScore = distanceEarthMiles(nextGeoCoord, gcDst);
-                scoreMap.associate(nextGeoCoord, score(next_gScore, next_hScore));
-                priority.emplace(nextGeoCoord, nextStreet.streetName);
-            }      
-            if (streetContainsLocation(nextStreet, gcDst))
+                continue;
+            }
+            auto final_gScore = curr_gScore + legs[leg].remaining +
+                turnCost[graph.turn(inArc, legs[leg].arc)];
+            if (final_gScore < bestCost)
             {
-                auto final_gScore =
-                    next_gScore + distanceEarthMiles(nextGeoCoord, gcDst);
-                if (!contains(open, gcDst) or
-                    final_gScore < scoreMap.find(gcDst)->g)
-                {
-                    open.associate(gcDst, true);
-                    cameFrom.associate({ gcDst, nextStreet.streetName },
-                        { nextGeoCoord, nextStreet.streetName });
-                    scoreMap.associate(gcDst, score(final_gScore, 0));
-                    priority.emplace(gcDst, nextStreet.streetName);
-                }
+                bestCost  = final_gScore;
+                bestChain = inChain;
+                bestLeg   = leg;
+                bestSeg   = -1;
             }
         }
+
+        auto firstOut = graph.firstArc(head);
+        auto nOut     = graph.firstArc(head + 1) - firstOut;
+        if (size(hScores) < static_cast<size_t>(nOut))
+        {
+            hScores.resize(nOut);
+        }
+        boundDistances(graph.chainHeadLatitudes(firstOut), graph.chainHeadLongitudes(firstOut),
+            graph.chainHeadCosLatitudes(firstOut), nOut, dstLatitude, dstLongitude,
+            dstCosLatitude, earthDiameterMiles, hScores.data());
+        for (int k = 0; k < nOut; ++k)
+        {
+            auto outChain = firstOut + k;
+            relax(outChain, curr_gScore + chainCost(outChain) +
+                turnCost[graph.turn(inArc, outChain)], inChain, hScores[k]);
+        }
+    }
+
+    if (bestCost == infinity)
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    // Walk the arcs back to the source into the route buffer.
+    // Headings come from the graph; only partial legs need one computed.
+    auto writer = RouteWriter(route, map, gcSrc, gcDst);
+    if (bestSeg != -1)
+    {
+        writer.prependLeg(graph.segment(bestSeg).streetName, -1, -1, bestCost,
+                          headingOf(gcSrc, gcDst));
+    }
+    if (bestLeg != -1)
+    {
+        const auto &leg = legs[bestLeg];
+        writer.prependLeg(graph.segment(graph.arc(leg.arc).segment).streetName, leg.node, -1,
+                          leg.remaining, headingOf(graph.coord(leg.node), gcDst));
+    }
+    auto &chainArcs = scratch.chainArcs;
+    for (auto c = bestChain; c != -1; c = labels.parentArc(c))
+    {
+        const auto &arc = graph.arc(c);
+        if (labels.parentArc(c) == -1 and srcNode == -1)
+        {
+            writer.prependLeg(graph.segment(arc.segment).streetName, -1, arc.head,
+                              labels.distance(c), headingOf(gcSrc, graph.coord(arc.head)));
+            continue;
+        }
+
+        chainArcs.assign(1, c);
+        while (chainArcs.back() != graph.chainLast(c))
+        {
+            chainArcs.emplace_back(graph.nextChainArc(chainArcs.back()));
+        }
+        for (auto a = size(chainArcs); a-- > 0; )
+        {
+            writer.prependArc(graph, chainArcs[a]);
+        }
+    }
+    writer.finish();
+
+    return Navigator::NavResult::NAV_SUCCESS;
+}
+
+RouteWriter::RouteWriter(CompactRoute &route, const MapPtr &map,
+                         const GeoCoord &src, const GeoCoord &dst)
+    : route_(route)
+{
+    route_.source      = src;
+    route_.destination = dst;
+    route_.segments.clear();
+    route_.map         = map;
+}
+
+void RouteWriter::prependLeg(int streetName, int startNode, int endNode,
+                             double distance, double heading)
+{
+    auto &segments = route_.segments;
+    if (!segments.empty() and segments.back().streetName != streetName)
+    {
+        const auto &nextLeg = segments.back();
+        auto turn       = CompactNavSegment();
+        turn.command    = NavSegment::turn;
+        turn.direction  = getTurnDirectionId(heading, nextHeading_);
+        turn.streetName = nextLeg.streetName;
+        turn.startNode  = nextLeg.startNode;
+        turn.endNode    = nextLeg.startNode;
+        segments.emplace_back(turn);
     }
 
-    return Navigator::NavResult::NAV_NO_ROUTE;
+    auto leg       = CompactNavSegment();
+    leg.command    = NavSegment::proceed;
+    leg.direction  = getTravelDirectionId(heading);
+    leg.streetName = streetName;
+    leg.startNode  = startNode;
+    leg.endNode    = endNode;
+    leg.distance   = distance;
+    segments.emplace_back(leg);
+    nextHeading_   = heading;
 }
 
-inline bool NavigatorImpl::contains(const MyMap<GeoCoord, bool> &container,
-        const GeoCoord &gc) const
+void RouteWriter::prependArc(const StreetGraph &graph, int arcId)
 {
-    
-    return container.find(gc) != nullptr and *container.find(gc) == true;
+    const auto &arc = graph.arc(arcId);
+    prependLeg(graph.segment(arc.segment).streetName, arc.tail, arc.head,
+               arc.length, arc.heading);
 }
 
-inline bool NavigatorImpl::streetContainsLocation(const StreetSegment &seg,
-        const GeoCoord &locaton) const
+void RouteWriter::finish()
 {
+    std::reverse(begin(route_.segments), end(route_.segments));
+}
 
-    for (auto attraction : seg.attractionsOnThisSegment)
+// Expands a compact route into NavSegments, overwriting the elements of
+// directions in place so that a reused vector keeps its buffers.
+// The ids are looked up in the map the route was found on.
+void NavigatorImpl::getNavSegments(const CompactRoute &route,
+                                   std::vector<NavSegment> &directions) const
+{
+    auto map = route.map != nullptr ? route.map : snapshot();
+    const auto &graph    = map->graph;
+    const auto &segments = route.segments;
+    directions.resize(size(segments));
+    for (size_t i = 0; i < size(segments); ++i)
     {
-        if (attraction.location == locaton)
+        const auto &navSeg = segments[i];
+        if (navSeg.command == NavSegment::turn)
         {
-            return true;
+            directions[i].initTurn(navSeg.getDirection(),
+                graph.streetName(navSeg.streetName));
+        }
+        else
+        {
+            directions[i].initProceed(navSeg.getDirection(),
+                graph.streetName(navSeg.streetName), navSeg.distance,
+                GeoSegment(startOf(*map, route, navSeg), endOf(*map, route, navSeg)));
         }
     }
-    return false;
 }
 
-inline void NavigatorImpl::reconstructPath(
-        const MyMap<locationInfo, locationInfo> &cameFrom,
-        std::stack<StreetSegment> &fullPath,
-        const GeoCoord &src) const
+std::string NavigatorImpl::getStreetName(int streetName) const
 {
-    auto current = fullPath.top();
-    if (current.segment.start == src)
-    {
-        return;
-    }
-  
-    auto prevLoc = *cameFrom.find({ current.segment.start, current.streetName });
-    auto toBeInserted       = StreetSegment();
-    toBeInserted.segment    = GeoSegment(prevLoc.first, current.segment.start);
-    toBeInserted.streetName = prevLoc.second;
-    fullPath.emplace(toBeInserted);
+    return snapshot()->graph.streetName(streetName);
+}
+
+bool NavigatorImpl::getGeoCoord(std::string attraction, GeoCoord &gc) const
+{
+    return snapshot()->attractionMapper.getGeoCoord(attraction, gc);
+}
 
-    reconstructPath(cameFrom, fullPath, src);
+inline const GeoCoord &NavigatorImpl::startOf(const MapSnapshot &map,
+        const CompactRoute &route, const CompactNavSegment &navSeg) const
+{
+    return navSeg.startNode == -1 ? route.source : map.graph.coord(navSeg.startNode);
 }
 
-void NavigatorImpl::getNavSegments(std::stack<StreetSegment> &fullPath,
-                                   std::vector<NavSegment> &result, 
-                                   const MyMap<GeoCoord, score> &scoreMap,
-                                   const std::string &prevStreetName) const
+inline const GeoCoord &NavigatorImpl::endOf(const MapSnapshot &map,
+        const CompactRoute &route, const CompactNavSegment &navSeg) const
 {
+    return navSeg.endNode == -1 ? route.destination : map.graph.coord(navSeg.endNode);
+}
 
-    if (size(fullPath) == 1)
+// Overwrites the elements of result in place, see getNavSegments.
+void buildDirections(const std::vector<StreetSegment> &path, std::vector<NavSegment> &result)
+{
+    auto nSegments = size(path);
+    for (size_t i = 1; i < size(path); ++i)
     {
-        return;
+        if (path[i - 1].streetName != path[i].streetName)
+        {
+            ++nSegments;
+        }
     }
 
-    auto currStreet     = fullPath.top();
-    fullPath.pop();
-
-    auto prevNavSeg      = result.back();  
-    auto travelDirection = getTravelDirection(currStreet.segment);
-
-    NavSegment nextNavSeg;
-    if (prevStreetName != currStreet.streetName)
+    result.resize(nSegments);
+    auto slot = size_t(0);
+    for (size_t i = 0; i < size(path); ++i)
     {
-        auto turnDirection = getTurnDirection(prevNavSeg.getSegment(), currStreet.segment);
-        nextNavSeg.initTurn(turnDirection, currStreet.streetName);
-        result.emplace_back(NavSegment(nextNavSeg));
+        const auto &currStreet = path[i];
+        if (i > 0 and path[i - 1].streetName != currStreet.streetName)
+        {
+            result[slot++].initTurn(getTurnDirection(path[i - 1].segment, currStreet.segment),
+                currStreet.streetName);
+        }
+        result[slot++].initProceed(getTravelDirection(currStreet.segment),
+            currStreet.streetName, distanceEarthMiles(currStreet), currStreet.segment);
     }
-
-    auto distanceTraveled = distanceEarthMiles(currStreet);
-
-    nextNavSeg.initProceed(travelDirection, currStreet.streetName, 
-        distanceTraveled,currStreet.segment);
-    
-    result.emplace_back(nextNavSeg);
-    
-    getNavSegments(fullPath, result, scoreMap, currStreet.streetName);
 }
 
 Navigator::Navigator() : pImpl_(new NavigatorImpl) {}
@@ -255,5 +768,137 @@ bool Navigator::loadMapData(std::string mapFile)
 Navigator::NavResult Navigator::navigate(std::string start, std::string end,
     std::vector<NavSegment> &directions) const
 {
-    return pImpl_->navigate(start, end, directions);
+    return pImpl_->logged(start, end, [&]() {
+        return pImpl_->navigate(start, end, directions);
+    });
+}
+
+Navigator::NavResult Navigator::navigate(const std::string &start, const std::string &end,
+    CompactRoute &route) const
+{
+    return pImpl_->logged(start, end, [&]() {
+        return pImpl_->navigate(start, end, route);
+    });
+}
+
+void Navigator::getNavSegments(const CompactRoute &route,
+    std::vector<NavSegment> &directions) const
+{
+    pImpl_->getNavSegments(route, directions);
+}
+
+std::string Navigator::getStreetName(int streetName) const
+{
+    return pImpl_->getStreetName(streetName);
+}
+
+bool Navigator::getGeoCoord(std::string attraction, GeoCoord &gc) const
+{
+    return pImpl_->getGeoCoord(attraction, gc);
+}
+
+Navigator::NavResult Navigator::navigateAlternatives(std::string start, std::string end,
+    const AlternativeLimits &limits, std::vector<CompactRoute> &routes) const
+{
+    return pImpl_->navigateAlternatives(start, end, limits, routes);
+}
+
+Navigator::NavResult Navigator::reroute(const CompactRoute &previous,
+    const GeoCoord &position, CompactRoute &route) const
+{
+    return pImpl_->reroute(previous, position, route);
+}
+
+Navigator::NavResult Navigator::nearestAttractions(std::string start, int k,
+    std::vector<NearbyAttraction> &found,
+    const std::function<bool(const std::string &)> &accept, bool withRoutes) const
+{
+    return pImpl_->nearestAttractions(start, k, found, accept, withRoutes);
+}
+
+Navigator::NavResult Navigator::planTrip(std::string depot,
+    const std::vector<std::string> &stops, const TripOptions &options,
+    std::vector<int> &order, std::vector<NavSegment> &directions) const
+{
+    return pImpl_->planTrip(depot, stops, options, order, directions);
+}
+
+void Navigator::getMemoryUsage(MemoryUsage &usage) const
+{
+    pImpl_->getMemoryUsage(usage);
+}
+
+void Navigator::buildHubLabels()
+{
+    pImpl_->buildHubLabels();
+}
+
+Navigator::NavResult Navigator::networkDistance(std::string start, std::string end,
+                                                double &miles) const
+{
+    return pImpl_->networkDistance(start, end, miles);
+}
+
+void Navigator::networkDistances(const std::vector<std::pair<std::string, std::string>> &pairs,
+                                 std::vector<double> &miles,
+                                 std::vector<NavResult> &results) const
+{
+    pImpl_->networkDistances(pairs, miles, results);
+}
+
+void Navigator::setTurnPenalties(const TurnPenalties &penalties)
+{
+    pImpl_->setTurnPenalties(penalties);
+}
+
+int Navigator::getComponent(std::string attraction) const
+{
+    return pImpl_->getComponent(attraction);
+}
+
+void Navigator::getComponentSizes(std::vector<int> &sizes) const
+{
+    pImpl_->getComponentSizes(sizes);
+}
+
+std::future<AsyncRoute> Navigator::navigateAsync(std::string start, std::string end,
+    std::chrono::steady_clock::time_point deadline, CancellationToken token) const
+{
+    return pImpl_->navigateAsync(start, end, deadline, token);
+}
+
+Navigator::NavResult Navigator::navigateTraced(std::string start, std::string end,
+    CompactRoute &route, SearchTrace &trace) const
+{
+    return pImpl_->navigateTraced(start, end, route, trace);
+}
+
+void Navigator::setSearchTracing(int samplePeriod, std::string directory, TraceFormat format)
+{
+    pImpl_->setSearchTracing(samplePeriod, directory, format);
+}
+
+bool Navigator::startQueryLog(std::string logFile)
+{
+    return pImpl_->startQueryLog(logFile);
+}
+
+void Navigator::stopQueryLog()
+{
+    pImpl_->stopQueryLog();
+}
+
+Navigator::NavResult Navigator::matchTrace(const std::vector<GpsPing> &trace,
+                                           std::vector<StreetSegment> &segments,
+                                           const MatchOptions &options) const
+{
+    return pImpl_->matchTrace(trace, segments, options);
+}
+
+void Navigator::matchTraces(const std::vector<std::vector<GpsPing>> &traces,
+                            std::vector<std::vector<StreetSegment>> &segments,
+                            std::vector<NavResult> &results,
+                            const MatchOptions &options) const
+{
+    pImpl_->matchTraces(traces, segments, results, options);
 }
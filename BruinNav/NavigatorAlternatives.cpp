@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+// A plateau of the two trees, by the location where it ends.
+struct Plateau
+{
+    double cost;
+    double length;
+    int    via;     // -1 for the direct route.
+};
+
+// Buffers of navigateAlternatives, kept by each thread from one query to the
+// next like those of navigate. The trees are built again for a new map.
+struct AlternativeScratch
+{
+    std::weak_ptr<const MapSnapshot>    map;
+    std::unique_ptr<ChainTree>          forward;
+    std::unique_ptr<BackwardChainTree>  backward;
+    std::vector<Plateau>                candidates;
+    std::vector<int>                    chains;
+    std::vector<int>                    arcs;
+    std::vector<bool>                   visited;        // by node, all false between routes.
+    std::vector<bool>                   usedSegment;    // all false between queries.
+    std::vector<int>                    usedSegments;
+};
+
+static AlternativeScratch &alternativeScratch(const MapPtr &map)
+{
+    static thread_local AlternativeScratch scratch;
+    if (scratch.map.lock() != map)
+    {
+        scratch.map      = map;
+        scratch.forward  = std::make_unique<ChainTree>(map->graph);
+        scratch.backward = std::make_unique<BackwardChainTree>(map->graph);
+        scratch.visited.assign(map->graph.nodeCount(), false);
+        scratch.usedSegment.assign(map->graph.segmentCount(), false);
+    }
+    return scratch;
+}
+
+// Alternative routes by the plateau method.
+// A forward tree from the source and a backward tree from the destination
+// are grown over the region where a route is at most maxStretch longer than
+// the shortest one. Driving to any location v along the forward tree and on
+// along the backward tree is a route of length distF(v) + distB(v); where the
+// two trees share a chain of arcs (a plateau) that route is locally shortest,
+// and the longer the plateau the more the route differs from its neighbours.
+// Both trees are grown once and every alternative is read off them. They
+// step whole chains between core nodes, where attractions attach, so they
+// settle a fifth of the nodes a tree over the arcs would.
+Navigator::NavResult NavigatorImpl::navigateAlternatives(std::string start, std::string end,
+    const AlternativeLimits &limits, std::vector<CompactRoute> &routes) const
+{
+    auto map   = snapshot();
+    auto gcSrc = GeoCoord();
+    auto gcDst = GeoCoord();
+    if (!map->attractionMapper.getGeoCoord(start, gcSrc))
+    {
+        return Navigator::NavResult::NAV_BAD_SOURCE;
+    }
+    if (!map->attractionMapper.getGeoCoord(end, gcDst))
+    {
+        return Navigator::NavResult::NAV_BAD_DESTINATION;
+    }
+    if (!mayConnect(*map, gcSrc, gcDst))
+    {
+        routes.clear();
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    const auto &graph   = map->graph;
+    const auto infinity = std::numeric_limits<double>::max();
+    auto srcAnchors = std::vector<Anchor>{};
+    auto dstAnchors = std::vector<Anchor>{};
+    graph.anchorsOf(gcSrc, srcAnchors);
+    graph.anchorsOf(gcDst, dstAnchors);
+
+    // Source and destination on the same segment can be joined directly.
+    auto directSeg = -1;
+    for (const auto &srcAnchor : srcAnchors)
+    {
+        for (const auto &dstAnchor : dstAnchors)
+        {
+            if (srcAnchor.segment != -1 and srcAnchor.segment == dstAnchor.segment)
+            {
+                directSeg = srcAnchor.segment;
+            }
+        }
+    }
+    auto direct = directSeg == -1 ? infinity : distanceEarthMiles(gcSrc, gcDst);
+
+    auto &scratch  = alternativeScratch(map);
+    auto &forward  = *scratch.forward;
+    auto &backward = *scratch.backward;
+    forward.reset(gcDst);
+    for (const auto &anchor : srcAnchors)
+    {
+        forward.addSeed(anchor.node, anchor.distance);
+    }
+    auto bestAnchor = -1;
+    auto shortest   = std::min(forward.growToAnchors(dstAnchors, bestAnchor), direct);
+    if (shortest == infinity)
+    {
+        routes.clear();
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    // The backward tree is held to the nodes some route within the limit
+    // passes, which the forward tree's distances tell exactly, so it needs
+    // no focus to stay small.
+    auto limit = (1.0 + limits.maxStretch) * shortest;
+    forward.grow(limit);
+    backward.reset();
+    for (const auto &anchor : dstAnchors)
+    {
+        if (forward.isSettled(anchor.node))
+        {
+            backward.addSeed(anchor.node, anchor.distance);
+        }
+    }
+    backward.grow(limit, forward);
+
+    // The chain into v is on a plateau if the backward tree uses it too.
+    auto onPlateau = [&](int v) {
+        auto chainId = forward.parentArc(v);
+        return chainId != -1 and backward.isSettled(graph.arc(chainId).tail) and
+               backward.parentArc(graph.arc(chainId).tail) == chainId;
+    };
+
+    // Collect the plateaus by the location where they end.
+    auto &candidates = scratch.candidates;
+    candidates.clear();
+    if (direct != infinity)
+    {
+        candidates.push_back({ direct, direct, -1 });
+    }
+    for (auto v : forward.settledNodes())
+    {
+        if (!backward.isSettled(v) or
+            forward.distance(v) + backward.distance(v) > limit)
+        {
+            continue;
+        }
+
+        auto toDst = backward.parentArc(v);
+        if (toDst != -1)
+        {
+            auto next = graph.chainHead(toDst);
+            if (onPlateau(next) and forward.parentArc(next) == toDst)
+            {
+                continue;   // the plateau goes on past v.
+            }
+        }
+
+        auto first = v;
+        while (onPlateau(first))
+        {
+            first = graph.arc(forward.parentArc(first)).tail;
+        }
+        auto cost = forward.distance(v) + backward.distance(v);
+        if (first != v or cost == shortest)
+        {
+            candidates.push_back({ cost, forward.distance(v) - forward.distance(first), v });
+        }
+    }
+    if (candidates.empty())
+    {
+        routes.clear();
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    // Shortest route first, then by decreasing plateau length.
+    auto shortestFirst = std::min_element(candidates.begin(), candidates.end(),
+        [](const Plateau &p1, const Plateau &p2) { return p1.cost < p2.cost; });
+    std::iter_swap(candidates.begin(), shortestFirst);
+    std::sort(candidates.begin() + 1, candidates.end(),
+        [](const Plateau &p1, const Plateau &p2) { return p1.length > p2.length; });
+
+    auto nRoutes      = 0;
+    auto &chains      = scratch.chains;
+    auto &arcs        = scratch.arcs;
+    auto &visited     = scratch.visited;
+    auto &usedSegment = scratch.usedSegment;
+    scratch.usedSegments.clear();
+    routes.resize(std::max(limits.maxRoutes, 0));
+    for (size_t c = 0; c < size(candidates) and nRoutes < limits.maxRoutes; ++c)
+    {
+        const auto &candidate = candidates[c];
+        if (candidate.via == -1)
+        {
+            auto writer = RouteWriter(routes[nRoutes++], map, gcSrc, gcDst);
+            writer.prependLeg(graph.segment(directSeg).streetName, -1, -1, direct,
+                              headingOf(gcSrc, gcDst));
+            writer.finish();
+            usedSegment[directSeg] = true;
+            scratch.usedSegments.emplace_back(directSeg);
+            continue;
+        }
+
+        // Forward tree up to the via location, backward tree from there on.
+        chains.clear();
+        auto firstNode = candidate.via;
+        while (forward.parentArc(firstNode) != -1)
+        {
+            chains.emplace_back(forward.parentArc(firstNode));
+            firstNode = graph.arc(forward.parentArc(firstNode)).tail;
+        }
+        std::reverse(chains.begin(), chains.end());
+        auto lastNode = candidate.via;
+        while (backward.parentArc(lastNode) != -1)
+        {
+            chains.emplace_back(backward.parentArc(lastNode));
+            lastNode = graph.chainHead(backward.parentArc(lastNode));
+        }
+        arcs.clear();
+        for (auto chainId : chains)
+        {
+            for (auto arcId = chainId; ; arcId = graph.nextChainArc(arcId))
+            {
+                arcs.emplace_back(arcId);
+                if (graph.isCore(graph.arc(arcId).head))
+                {
+                    break;
+                }
+            }
+        }
+
+        // Skip routes that loop or mostly retrace the routes taken already.
+        auto overlap = 0.0;
+        auto loops   = false;
+        visited[firstNode] = true;
+        for (auto arcId : arcs)
+        {
+            const auto &arc = graph.arc(arcId);
+            if (usedSegment[arc.segment])
+            {
+                overlap += arc.length;
+            }
+            loops = loops or visited[arc.head];
+            visited[arc.head] = true;
+        }
+        visited[firstNode] = false;
+        for (auto arcId : arcs)
+        {
+            visited[graph.arc(arcId).head] = false;
+        }
+        if (loops or overlap > limits.maxOverlap * candidate.cost)
+        {
+            continue;
+        }
+
+        writeViaRoute(map, arcs, srcAnchors, dstAnchors, firstNode, lastNode,
+                      gcSrc, gcDst, routes[nRoutes++]);
+        for (auto arcId : arcs)
+        {
+            if (!usedSegment[graph.arc(arcId).segment])
+            {
+                usedSegment[graph.arc(arcId).segment] = true;
+                scratch.usedSegments.emplace_back(graph.arc(arcId).segment);
+            }
+        }
+    }
+    routes.resize(nRoutes);
+    for (auto segId : scratch.usedSegments)
+    {
+        usedSegment[segId] = false;
+    }
+
+    return Navigator::NavResult::NAV_SUCCESS;
+}
+
+// Writes the route that leaves the source through the anchor at firstNode,
+// follows arcs and reaches the destination through the anchor at lastNode.
+void NavigatorImpl::writeViaRoute(const MapPtr &map, const std::vector<int> &arcs,
+                                  const std::vector<Anchor> &srcAnchors,
+                                  const std::vector<Anchor> &dstAnchors,
+                                  int firstNode, int lastNode,
+                                  const GeoCoord &gcSrc, const GeoCoord &gcDst,
+                                  CompactRoute &route) const
+{
+    const auto &graph = map->graph;
+    auto closestAnchor = [](const std::vector<Anchor> &anchors, int node) {
+        const Anchor *closest = nullptr;
+        for (const auto &anchor : anchors)
+        {
+            if (anchor.node == node and
+                (closest == nullptr or anchor.distance < closest->distance))
+            {
+                closest = &anchor;
+            }
+        }
+        return closest;
+    };
+
+    auto writer = RouteWriter(route, map, gcSrc, gcDst);
+    auto dstAnchor = closestAnchor(dstAnchors, lastNode);
+    if (dstAnchor->segment != -1)
+    {
+        writer.prependLeg(graph.segment(dstAnchor->segment).streetName, lastNode, -1,
+                          dstAnchor->distance, headingOf(graph.coord(lastNode), gcDst));
+    }
+    for (auto a = size(arcs); a-- > 0; )
+    {
+        writer.prependArc(graph, arcs[a]);
+    }
+    auto srcAnchor = closestAnchor(srcAnchors, firstNode);
+    if (srcAnchor->segment != -1)
+    {
+        writer.prependLeg(graph.segment(srcAnchor->segment).streetName, -1, firstNode,
+                          srcAnchor->distance, headingOf(gcSrc, graph.coord(firstNode)));
+    }
+    writer.finish();
+}
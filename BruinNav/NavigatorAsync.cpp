@@ -0,0 +1,33 @@
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "Provided.h"
+#include "QueryExecutor.h"
+#include "Support.h"
+
+// Queues the compact navigate on the executor. The budget is checked once
+// more when a worker picks the query up, so queries that waited past their
+// deadline, or were cancelled while queued, are shed without a search.
+std::future<AsyncRoute> NavigatorImpl::navigateAsync(std::string start, std::string end,
+    std::chrono::steady_clock::time_point deadline, CancellationToken token) const
+{
+    auto promise = std::make_shared<std::promise<AsyncRoute>>();
+    auto future  = promise->get_future();
+    executor_.submit([this, promise, start = std::move(start), end = std::move(end),
+                      deadline, token]() {
+        auto reply  = AsyncRoute();
+        auto budget = SearchBudget(deadline, token);
+        reply.result = budget.checkNow();
+        if (reply.result == Navigator::NavResult::NAV_SUCCESS)
+        {
+            reply.result = logged(start, end, [&]() {
+                return navigate(start, end, reply.route, &budget);
+            });
+        }
+        promise->set_value(std::move(reply));
+    });
+    return future;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HubLabels.h"
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+struct DistanceScratch
+{
+    std::vector<Anchor>                 srcAnchors;
+    std::vector<Anchor>                 dstAnchors;
+    std::unique_ptr<ShortestPathTree>   tree;   // for maps without labels, made on first use.
+};
+
+void NavigatorImpl::buildHubLabels()
+{
+    hubLabelsWanted_ = true;
+    std::atomic_store(&hubLabels_,
+        std::shared_ptr<const HubLabelIndex>(std::make_shared<const HubLabelIndex>(snapshot())));
+}
+
+Navigator::NavResult NavigatorImpl::networkDistance(std::string start, std::string end,
+                                                    double &miles) const
+{
+    auto map       = snapshot();
+    auto hubLabels = std::atomic_load(&hubLabels_);
+    auto scratch   = DistanceScratch();
+    return networkDistance(*map, hubLabels.get(), start, end, miles, scratch);
+}
+
+// Every pair runs on the same snapshot and shares the scratch buffers.
+void NavigatorImpl::networkDistances(const std::vector<std::pair<std::string, std::string>> &pairs,
+                                     std::vector<double> &miles,
+                                     std::vector<Navigator::NavResult> &results) const
+{
+    auto map       = snapshot();
+    auto hubLabels = std::atomic_load(&hubLabels_);
+    auto scratch   = DistanceScratch();
+    miles.resize(size(pairs));
+    results.resize(size(pairs));
+    for (size_t i = 0; i < size(pairs); ++i)
+    {
+        results[i] = networkDistance(*map, hubLabels.get(), pairs[i].first, pairs[i].second,
+                                     miles[i], scratch);
+    }
+}
+
+/**
+ *  Attractions attach to the graph at core nodes, so the shortest route
+ *  leaves through a source anchor and arrives through a destination anchor,
+ *  and the labels of the two core nodes give the distance in between. Two
+ *  locations on the same segment may also be joined directly.
+ */
+Navigator::NavResult NavigatorImpl::networkDistance(const MapSnapshot &map,
+                                                    const HubLabelIndex *hubLabels,
+                                                    std::string start, std::string end,
+                                                    double &miles,
+                                                    DistanceScratch &scratch) const
+{
+    auto gcSrc = GeoCoord();
+    auto gcDst = GeoCoord();
+    if (!map.attractionMapper.getGeoCoord(start, gcSrc))
+    {
+        return Navigator::NavResult::NAV_BAD_SOURCE;
+    }
+    if (!map.attractionMapper.getGeoCoord(end, gcDst))
+    {
+        return Navigator::NavResult::NAV_BAD_DESTINATION;
+    }
+    if (!mayConnect(map, gcSrc, gcDst))
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+    if (gcSrc == gcDst)
+    {
+        miles = 0.0;
+        return Navigator::NavResult::NAV_SUCCESS;
+    }
+
+    const auto &graph = map.graph;
+    auto &srcAnchors  = scratch.srcAnchors;
+    auto &dstAnchors  = scratch.dstAnchors;
+    graph.anchorsOf(gcSrc, srcAnchors);
+    graph.anchorsOf(gcDst, dstAnchors);
+
+    auto best = std::numeric_limits<double>::infinity();
+    for (const auto &srcAnchor : srcAnchors)
+    {
+        for (const auto &dstAnchor : dstAnchors)
+        {
+            if (srcAnchor.segment != -1 and srcAnchor.segment == dstAnchor.segment)
+            {
+                best = std::min(best, distanceEarthMiles(gcSrc, gcDst));
+            }
+        }
+    }
+
+    if (hubLabels != nullptr and hubLabels->map.get() == &map)
+    {
+        for (const auto &srcAnchor : srcAnchors)
+        {
+            for (const auto &dstAnchor : dstAnchors)
+            {
+                best = std::min(best, srcAnchor.distance + dstAnchor.distance +
+                    hubLabels->labels.distance(srcAnchor.node, dstAnchor.node));
+            }
+        }
+    }
+    else
+    {
+        if (scratch.tree == nullptr)
+        {
+            scratch.tree = std::make_unique<ShortestPathTree>(graph);
+        }
+        auto &tree = *scratch.tree;
+        tree.reset(gcDst);
+        for (const auto &srcAnchor : srcAnchors)
+        {
+            tree.addSeed(srcAnchor.node, srcAnchor.distance);
+        }
+        auto bestAnchor = -1;
+        auto distance   = tree.growToAnchors(dstAnchors, bestAnchor);
+        if (bestAnchor != -1)
+        {
+            best = std::min(best, distance);
+        }
+    }
+
+    if (best == std::numeric_limits<double>::infinity())
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+    miles = best;
+    return Navigator::NavResult::NAV_SUCCESS;
+}
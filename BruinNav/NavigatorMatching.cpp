@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MapMatching.h"
+#include "Provided.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+static void appendStreetSegments(const MapSnapshot &map, const std::vector<int> &path,
+                                 std::vector<StreetSegment> &segments)
+{
+    auto street = StreetSegment();
+    for (auto segId : path)
+    {
+        if (getStreetOfSegment(map, segId, street))
+        {
+            segments.emplace_back(std::move(street));
+        }
+    }
+}
+
+// Double-checked, so matching on a snapshot with its grid built takes no lock.
+std::shared_ptr<const MatchIndex> NavigatorImpl::matchIndex() const
+{
+    auto map   = snapshot();
+    auto index = std::atomic_load(&matchIndex_);
+    if (index != nullptr and index->map == map)
+    {
+        return index;
+    }
+    auto lock = std::lock_guard<std::mutex>(matchIndexMutex_);
+    index = std::atomic_load(&matchIndex_);
+    if (index == nullptr or index->map != map)
+    {
+        index = std::make_shared<const MatchIndex>(map);
+        std::atomic_store(&matchIndex_, index);
+    }
+    return index;
+}
+
+Navigator::NavResult NavigatorImpl::matchTrace(const std::vector<GpsPing> &trace,
+                                               std::vector<StreetSegment> &segments,
+                                               const MatchOptions &options) const
+{
+    // Batch: nothing is decided before the whole trace is in.
+    auto batch = options;
+    batch.maxLag = INT_MAX;
+    auto matcher = TraceMatcherImpl(*this, batch);
+    segments.clear();
+    for (const auto &ping : trace)
+    {
+        matcher.addPing(ping, segments);
+    }
+    matcher.finish(segments);
+    return segments.empty() ? Navigator::NavResult::NAV_NO_ROUTE
+                            : Navigator::NavResult::NAV_SUCCESS;
+}
+
+// Traces are handed to the threads one at a time, as they finish the last.
+void NavigatorImpl::matchTraces(const std::vector<std::vector<GpsPing>> &traces,
+                                std::vector<std::vector<StreetSegment>> &segments,
+                                std::vector<Navigator::NavResult> &results,
+                                const MatchOptions &options) const
+{
+    auto n = static_cast<int>(size(traces));
+    segments.resize(n);
+    results.resize(n);
+    if (n == 0)
+    {
+        return;
+    }
+    matchIndex();   // built once, not by every thread.
+
+    auto nextTrace = std::atomic<int>(0);
+    auto worker    = [&]() {
+        for (auto i = nextTrace++; i < n; i = nextTrace++)
+        {
+            results[i] = matchTrace(traces[i], segments[i], options);
+        }
+    };
+
+    auto nThreads = options.nThreads;
+    if (nThreads <= 0)
+    {
+        nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    nThreads = std::min(nThreads, n);
+    auto workers = std::vector<std::thread>{};
+    for (int t = 1; t < nThreads; ++t)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+}
+
+// TraceMatcherImpl
+TraceMatcherImpl::TraceMatcherImpl(const NavigatorImpl &navigator, const MatchOptions &options)
+    : index_(navigator.matchIndex()), matcher_(index_->map->graph, index_->grid, options)
+{
+}
+
+void TraceMatcherImpl::addPing(const GpsPing &ping, std::vector<StreetSegment> &segments)
+{
+    path_.clear();
+    matcher_.add(ping, path_);
+    appendStreetSegments(*index_->map, path_, segments);
+}
+
+void TraceMatcherImpl::finish(std::vector<StreetSegment> &segments)
+{
+    path_.clear();
+    matcher_.finish(path_);
+    appendStreetSegments(*index_->map, path_, segments);
+}
+
+// TraceMatcher
+TraceMatcher::TraceMatcher(const Navigator &navigator, const MatchOptions &options)
+    : pImpl_(new TraceMatcherImpl(*navigator.pImpl_, options))
+{
+}
+
+TraceMatcher::~TraceMatcher()
+{
+    delete pImpl_;
+}
+
+void TraceMatcher::addPing(const GpsPing &ping, std::vector<StreetSegment> &segments)
+{
+    pImpl_->addPing(ping, segments);
+}
+
+void TraceMatcher::finish(std::vector<StreetSegment> &segments)
+{
+    pImpl_->finish(segments);
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MyMap.h"
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+NearbyIndex::NearbyIndex(const MapPtr &snapshot)
+    : map(snapshot)
+{
+    const auto &graph = map->graph;
+    auto numbers = MyMap<std::string, int>{};
+    auto street  = StreetSegment();
+    auto listed  = std::vector<std::pair<int, Entry>>{};   // node, entry.
+    for (int s = 0; s < graph.segmentCount(); ++s)
+    {
+        if (!getStreetOfSegment(*map, s, street))
+        {
+            continue;
+        }
+        const auto &seg = graph.segment(s);
+        for (const auto &address : street.attractionsOnThisSegment)
+        {
+            auto number = numbers.find(address.attraction);
+            if (number == nullptr)
+            {
+                numbers.associate(address.attraction, static_cast<int>(size(names)));
+                names.emplace_back(address.attraction);
+                locations.emplace_back(address.location);
+                number = numbers.find(address.attraction);
+            }
+            // One at a node is listed at that node alone, as anchorsOf has it.
+            auto atNode = graph.findNode(address.location);
+            if (atNode != -1)
+            {
+                listed.push_back({ atNode, { *number, s, 0.0 } });
+                continue;
+            }
+            for (auto node : { seg.start, seg.end })
+            {
+                listed.push_back({ node, { *number, s,
+                    distanceEarthMiles(address.location, graph.coord(node)) } });
+            }
+        }
+    }
+
+    firstEntry.assign(graph.nodeCount() + 1, 0);
+    for (const auto &item : listed)
+    {
+        ++firstEntry[item.first + 1];
+    }
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        firstEntry[v + 1] += firstEntry[v];
+    }
+    entries.resize(size(listed));
+    auto filled = std::vector<int>(begin(firstEntry), end(firstEntry) - 1);
+    for (const auto &item : listed)
+    {
+        entries[filled[item.first]++] = item.second;
+    }
+}
+
+// Double-checked, like matchIndex.
+std::shared_ptr<const NearbyIndex> NavigatorImpl::nearbyIndex() const
+{
+    auto map   = snapshot();
+    auto index = std::atomic_load(&nearbyIndex_);
+    if (index != nullptr and index->map == map)
+    {
+        return index;
+    }
+    auto lock = std::lock_guard<std::mutex>(nearbyIndexMutex_);
+    index = std::atomic_load(&nearbyIndex_);
+    if (index == nullptr or index->map != map)
+    {
+        index = std::make_shared<const NearbyIndex>(map);
+        std::atomic_store(&nearbyIndex_, index);
+    }
+    return index;
+}
+
+/**
+ *  One Dijkstra tree from the start. Settling a node offers the attractions
+ *  listed at it, at its distance plus theirs from it; once a node is settled
+ *  at distance d, no attraction offered at d or less can be reached any
+ *  shorter, so those are taken in order of distance until there are k.
+ */
+Navigator::NavResult NavigatorImpl::nearestAttractions(
+    std::string start, int k, std::vector<NearbyAttraction> &found,
+    const std::function<bool(const std::string &)> &accept, bool withRoutes) const
+{
+    found.clear();
+    auto index = nearbyIndex();
+    const auto &map   = index->map;
+    const auto &graph = map->graph;
+    auto gcSrc = GeoCoord();
+    if (!map->attractionMapper.getGeoCoord(start, gcSrc))
+    {
+        return Navigator::NavResult::NAV_BAD_SOURCE;
+    }
+    auto srcAnchors = std::vector<Anchor>{};
+    graph.anchorsOf(gcSrc, srcAnchors);
+    if (srcAnchors.empty())
+    {
+        return Navigator::NavResult::NAV_BAD_SOURCE;
+    }
+    if (k <= 0)
+    {
+        return Navigator::NavResult::NAV_SUCCESS;
+    }
+
+    // Verdicts of accept, asked the first time an attraction is offered.
+    enum Verdict : char { UNASKED, ACCEPTED, REJECTED };
+    const auto infinity = std::numeric_limits<double>::max();
+    auto nAttractions = size(index->names);
+    auto verdicts = std::vector<Verdict>(nAttractions, UNASKED);
+    auto best     = std::vector<double>(nAttractions, infinity);
+    auto bestNode = std::vector<int>(nAttractions, -1);
+    auto bestSeg  = std::vector<int>(nAttractions, -1);
+    auto taken    = std::vector<bool>(nAttractions, false);
+    auto takenIds = std::vector<int>{};     // parallel to found.
+    auto offered  = std::priority_queue<std::pair<double, int>,
+                                        std::vector<std::pair<double, int>>,
+                                        std::greater<std::pair<double, int>>>();
+    auto offer = [&](const NearbyIndex::Entry &entry, double miles, int node) {
+        auto a = entry.attraction;
+        if (verdicts[a] == UNASKED)
+        {
+            verdicts[a] = index->locations[a] == gcSrc or (accept and !accept(index->names[a]))
+                          ? REJECTED : ACCEPTED;
+        }
+        if (verdicts[a] == ACCEPTED and miles < best[a])
+        {
+            best[a]     = miles;
+            bestNode[a] = node;
+            bestSeg[a]  = entry.segment;
+            offered.push({ miles, a });
+        }
+    };
+    auto take = [&](double reached) {
+        while (!offered.empty() and offered.top().first <= reached and
+               static_cast<int>(size(found)) < k)
+        {
+            auto a = offered.top().second;
+            offered.pop();
+            if (!taken[a])
+            {
+                taken[a] = true;
+                takenIds.emplace_back(a);
+                found.push_back({ index->names[a], index->locations[a], best[a], {} });
+            }
+        }
+    };
+
+    // The attractions sharing a segment with the start can be driven to directly.
+    for (const auto &anchor : srcAnchors)
+    {
+        for (auto e = index->firstEntry[anchor.node]; e < index->firstEntry[anchor.node + 1]; ++e)
+        {
+            const auto &entry = index->entries[e];
+            if (anchor.segment != -1 and entry.segment == anchor.segment)
+            {
+                offer(entry, distanceEarthMiles(gcSrc, index->locations[entry.attraction]), -1);
+            }
+        }
+    }
+
+    auto tree = DijkstraTree(graph);
+    tree.reset();
+    for (const auto &anchor : srcAnchors)
+    {
+        tree.addSeed(anchor.node, anchor.distance);
+    }
+    tree.growWhile([&](int node) {
+        auto distance = tree.distance(node);
+        for (auto e = index->firstEntry[node]; e < index->firstEntry[node + 1]; ++e)
+        {
+            const auto &entry = index->entries[e];
+            offer(entry, distance + entry.distance, node);
+        }
+        take(distance);
+        return static_cast<int>(size(found)) < k;
+    });
+    take(infinity);
+    if (found.empty())
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    if (withRoutes)
+    {
+        auto dstAnchors = std::vector<Anchor>{};
+        auto arcs       = std::vector<int>{};
+        for (size_t i = 0; i < size(found); ++i)
+        {
+            auto &nearby = found[i];
+            auto a       = takenIds[i];
+            if (bestNode[a] == -1)
+            {
+                auto writer = RouteWriter(nearby.route, map, gcSrc, nearby.location);
+                writer.prependLeg(graph.segment(bestSeg[a]).streetName, -1, -1, best[a],
+                                  headingOf(gcSrc, nearby.location));
+                writer.finish();
+                continue;
+            }
+            arcs.clear();
+            auto firstNode = bestNode[a];
+            while (tree.parentArc(firstNode) != -1)
+            {
+                arcs.emplace_back(tree.parentArc(firstNode));
+                firstNode = graph.arc(tree.parentArc(firstNode)).tail;
+            }
+            std::reverse(begin(arcs), end(arcs));
+            graph.anchorsOf(nearby.location, dstAnchors);
+            writeViaRoute(map, arcs, srcAnchors, dstAnchors, firstNode, bestNode[a],
+                          gcSrc, nearby.location, nearby.route);
+        }
+    }
+    return Navigator::NavResult::NAV_SUCCESS;
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MapMatching.h"
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+// Trees kept for the destinations re-routed to most recently.
+static const size_t maxRerouteTrees = 8;
+
+// A Dijkstra tree grown backwards from a destination. Its distances are
+// exact wherever it has settled, and it only ever grows, so the frontier
+// left by one re-route is where the next one carries on from.
+struct RerouteTree
+{
+    RerouteTree(const MapPtr &snapshot, const GeoCoord &gc)
+        : map(snapshot), destination(gc), tree(snapshot->graph)
+    {
+        tree.reset();
+        map->graph.anchorsOf(destination, dstAnchors);
+        for (const auto &anchor : dstAnchors)
+        {
+            tree.addSeed(anchor.node, anchor.distance);
+        }
+    }
+
+    MapPtr                  map;    // keeps the graph of the tree alive.
+    GeoCoord                destination;
+    std::vector<Anchor>     dstAnchors;
+    std::mutex              mutex;  // held while growing or reading the tree.
+    BackwardDijkstraTree    tree;
+    std::vector<int>        srcNodes;
+    std::vector<Anchor>     srcAnchors;
+    std::vector<int>        arcs;
+};
+
+std::shared_ptr<RerouteTree> NavigatorImpl::rerouteTree(const MapPtr &map,
+                                                        const GeoCoord &destination) const
+{
+    auto lock = std::lock_guard<std::mutex>(rerouteMutex_);
+    for (auto tree = begin(rerouteTrees_); tree != end(rerouteTrees_); ++tree)
+    {
+        if ((*tree)->map == map and (*tree)->destination == destination)
+        {
+            rerouteTrees_.splice(begin(rerouteTrees_), rerouteTrees_, tree);
+            return rerouteTrees_.front();
+        }
+    }
+    rerouteTrees_.push_front(std::make_shared<RerouteTree>(map, destination));
+    if (size(rerouteTrees_) > maxRerouteTrees)
+    {
+        rerouteTrees_.pop_back();
+    }
+    return rerouteTrees_.front();
+}
+
+// The point of the street closest to position, no farther than a ping may be
+// from its candidates in map matching; segment -1 if there is none.
+static MatchCandidate snapPosition(const StreetGraph &graph, const SegmentGrid &grid,
+                                   const GeoCoord &position)
+{
+    auto radius  = MatchOptions().candidateRadius;
+    auto snapped = MatchCandidate{ -1, 0.0, radius };
+    auto segIds  = std::vector<int>{};
+    grid.near(position.latitude, position.longitude, radius, segIds);
+    for (auto segId : segIds)
+    {
+        auto candidate = snapToSegment(graph, segId, position.latitude, position.longitude);
+        if (candidate.distance <= snapped.distance)
+        {
+            snapped = candidate;
+        }
+    }
+    return snapped;
+}
+
+/**
+ *  The backward tree of the destination gives, for every location it has
+ *  settled, the shortest way on to the destination. A re-route grows it
+ *  until the anchors of the position are settled, then follows its parent
+ *  arcs; positions near those asked before cost next to nothing.
+ */
+Navigator::NavResult NavigatorImpl::reroute(const CompactRoute &previous,
+                                            const GeoCoord &position,
+                                            CompactRoute &route) const
+{
+    // Copies, since route may be previous itself.
+    auto map = previous.map;
+    if (map == nullptr)
+    {
+        return Navigator::NavResult::NAV_BAD_DESTINATION;
+    }
+    auto destination = previous.destination;
+    const auto &graph = map->graph;
+
+    // A position in the middle of a street is snapped onto its segment, and
+    // leaves from there towards both ends, as far as they are along it.
+    auto source  = position;
+    auto snapped = MatchCandidate{ -1, 0.0, 0.0 };
+    if (graph.findNode(position) == -1 and graph.attractionSegments(position) == nullptr)
+    {
+        auto index = matchIndex();
+        snapped = index->map == map ? snapPosition(graph, index->grid, position)
+                                    : snapPosition(graph, SegmentGrid(graph), position);
+        if (snapped.segment == -1)
+        {
+            return Navigator::NavResult::NAV_BAD_SOURCE;
+        }
+        const auto &seg   = graph.segment(snapped.segment);
+        const auto &start = graph.coord(seg.start);
+        const auto &end   = graph.coord(seg.end);
+        if (snapped.fraction == 0.0 or snapped.fraction == 1.0)
+        {
+            // Past an end of the street, so at that node.
+            source  = snapped.fraction == 0.0 ? start : end;
+            snapped = MatchCandidate{ -1, 0.0, 0.0 };
+        }
+        else
+        {
+            source.latitude  = start.latitude + snapped.fraction * (end.latitude - start.latitude);
+            source.longitude = start.longitude + snapped.fraction * (end.longitude - start.longitude);
+            source.sLatitude.clear();   // not a location of the map file.
+            source.sLongitude.clear();
+        }
+    }
+    auto onStreet = snapped.segment == -1 ? source
+                                          : graph.coord(graph.segment(snapped.segment).start);
+    if (!mayConnect(*map, onStreet, destination))
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+    auto turns = turnSettings();
+    if (turns->turnAware)
+    {
+        auto srcSegIds = std::vector<int>(1, snapped.segment);
+        return navigateByArcs(map, *turns, source, destination, route, nullptr, nullptr,
+                              snapped.segment == -1 ? nullptr : &srcSegIds);
+    }
+
+    auto entry = rerouteTree(map, destination);
+    auto lock  = std::lock_guard<std::mutex>(entry->mutex);
+    auto &tree       = entry->tree;
+    auto &srcAnchors = entry->srcAnchors;
+    if (snapped.segment == -1)
+    {
+        graph.anchorsOf(source, srcAnchors);
+    }
+    else
+    {
+        const auto &seg = graph.segment(snapped.segment);
+        srcAnchors.clear();
+        srcAnchors.push_back({ seg.start, snapped.fraction * seg.length, snapped.segment });
+        srcAnchors.push_back({ seg.end, (1.0 - snapped.fraction) * seg.length, snapped.segment });
+    }
+    entry->srcNodes.clear();
+    for (const auto &anchor : srcAnchors)
+    {
+        entry->srcNodes.emplace_back(anchor.node);
+    }
+    tree.growToCover(entry->srcNodes);
+
+    const auto infinity = std::numeric_limits<double>::max();
+    auto best     = infinity;
+    auto bestNode = -1;
+    for (const auto &anchor : srcAnchors)
+    {
+        if (tree.isSettled(anchor.node) and tree.distance(anchor.node) + anchor.distance < best)
+        {
+            best     = tree.distance(anchor.node) + anchor.distance;
+            bestNode = anchor.node;
+        }
+    }
+
+    // Position and destination on the same segment can be joined directly.
+    auto directSeg = -1;
+    for (const auto &srcAnchor : srcAnchors)
+    {
+        for (const auto &dstAnchor : entry->dstAnchors)
+        {
+            if (srcAnchor.segment != -1 and srcAnchor.segment == dstAnchor.segment)
+            {
+                directSeg = srcAnchor.segment;
+            }
+        }
+    }
+    if (directSeg != -1 and distanceEarthMiles(source, destination) < best)
+    {
+        auto writer = RouteWriter(route, map, source, destination);
+        writer.prependLeg(graph.segment(directSeg).streetName, -1, -1,
+                          distanceEarthMiles(source, destination),
+                          headingOf(source, destination));
+        writer.finish();
+        return Navigator::NavResult::NAV_SUCCESS;
+    }
+    if (bestNode == -1)
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    auto &arcs    = entry->arcs;
+    auto lastNode = bestNode;
+    arcs.clear();
+    while (tree.parentArc(lastNode) != -1)
+    {
+        arcs.emplace_back(tree.parentArc(lastNode));
+        lastNode = graph.arc(tree.parentArc(lastNode)).head;
+    }
+    writeViaRoute(map, arcs, srcAnchors, entry->dstAnchors, bestNode, lastNode,
+                  source, destination, route);
+    return Navigator::NavResult::NAV_SUCCESS;
+}
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+using tripClock = std::chrono::steady_clock;
+
+// Moves that gain less than this many miles are not worth taking; it also
+// stops rounding noise from swapping two equal tours back and forth.
+const double minimumGain = 1e-9;
+
+// Cheapest insertion of every location into a round trip from location 0,
+// taking the location nearest to the trip each time.
+static void buildNearestInsertionTour(const std::vector<double> &distances, int n,
+                                      std::vector<int> &tour)
+{
+    auto d = [&](int from, int to) { return distances[from * n + to]; };
+
+    tour.assign(1, 0);
+    auto nearest = std::vector<double>(n);
+    auto inTour  = std::vector<bool>(n, false);
+    inTour[0] = true;
+    for (int v = 1; v < n; ++v)
+    {
+        nearest[v] = std::min(d(0, v), d(v, 0));
+    }
+
+    for (int step = 1; step < n; ++step)
+    {
+        auto next = -1;
+        for (int v = 1; v < n; ++v)
+        {
+            if (!inTour[v] and (next == -1 or nearest[v] < nearest[next]))
+            {
+                next = v;
+            }
+        }
+
+        auto bestSlot = 0;
+        auto bestCost = std::numeric_limits<double>::max();
+        for (int k = 0; k < static_cast<int>(size(tour)); ++k)
+        {
+            auto from = tour[k];
+            auto to   = tour[(k + 1) % size(tour)];
+            auto cost = d(from, next) + d(next, to) - d(from, to);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSlot = k + 1;
+            }
+        }
+        tour.insert(begin(tour) + bestSlot, next);
+        inTour[next] = true;
+
+        for (int v = 1; v < n; ++v)
+        {
+            nearest[v] = std::min(nearest[v], std::min(d(next, v), d(v, next)));
+        }
+    }
+}
+
+// One first-improvement pass of 2-opt: reverses tour[i + 1 .. j] whenever
+// that shortens the trip. Streets are two-way, so reversing a stretch of the
+// trip does not change its length. @return true if the tour improved.
+static bool improveByTwoOpt(const std::vector<double> &distances, int n,
+                            std::vector<int> &tour, tripClock::time_point deadline)
+{
+    auto d = [&](int from, int to) { return distances[from * n + to]; };
+    auto improved = false;
+
+    for (int i = 0; i + 2 < n; ++i)
+    {
+        if (tripClock::now() > deadline)
+        {
+            break;
+        }
+        for (int j = i + 2; j < n; ++j)
+        {
+            if (i == 0 and j == n - 1)
+            {
+                continue;   // the two edges meet at the depot.
+            }
+            auto a = tour[i];
+            auto b = tour[i + 1];
+            auto c = tour[j];
+            auto e = tour[(j + 1) % n];
+            if (d(a, c) + d(b, e) < d(a, b) + d(c, e) - minimumGain)
+            {
+                std::reverse(begin(tour) + i + 1, begin(tour) + j + 1);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+// One first-improvement pass of Or-opt: moves a run of up to three
+// consecutive stops to the edge where it fits best. @return true if the tour improved.
+static bool improveByOrOpt(const std::vector<double> &distances, int n,
+                           std::vector<int> &tour, tripClock::time_point deadline)
+{
+    auto d = [&](int from, int to) { return distances[from * n + to]; };
+    auto improved = false;
+
+    for (int length = 1; length <= 3; ++length)
+    {
+        for (int i = 1; i + length <= n; ++i)
+        {
+            if (tripClock::now() > deadline)
+            {
+                return improved;
+            }
+            auto first = tour[i];
+            auto last  = tour[i + length - 1];
+            auto prev  = tour[i - 1];
+            auto next  = tour[(i + length) % n];
+            auto saved = d(prev, first) + d(last, next) - d(prev, next);
+
+            for (int k = 0; k < n; ++k)
+            {
+                if (k >= i - 1 and k <= i + length - 1)
+                {
+                    continue;   // an edge next to or inside the run.
+                }
+                auto a = tour[k];
+                auto b = tour[(k + 1) % n];
+                if (d(a, first) + d(last, b) - d(a, b) < saved - minimumGain)
+                {
+                    if (k < i)
+                    {
+                        std::rotate(begin(tour) + k + 1, begin(tour) + i,
+                                    begin(tour) + i + length);
+                    }
+                    else
+                    {
+                        std::rotate(begin(tour) + i, begin(tour) + i + length,
+                                    begin(tour) + k + 1);
+                    }
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    return improved;
+}
+
+// Plans a round trip from the depot through every stop.
+// The road distances between all locations are found by one plain Dijkstra
+// tree per location, grown in parallel until it covers every other location.
+// The visiting order starts from nearest insertion and is improved by 2-opt
+// and Or-opt until neither helps or the time budget runs out; the legs are
+// then routed with navigate's own search, so turn penalties, if set, only
+// apply to the directions and not to the order.
+Navigator::NavResult NavigatorImpl::planTrip(std::string depot,
+    const std::vector<std::string> &stops, const TripOptions &options,
+    std::vector<int> &order, std::vector<NavSegment> &directions) const
+{
+    auto map   = snapshot();
+    auto turns = turnSettings();
+    auto n     = static_cast<int>(size(stops)) + 1;
+    auto locations = std::vector<GeoCoord>(n);
+    if (!map->attractionMapper.getGeoCoord(depot, locations[0]))
+    {
+        return Navigator::NavResult::NAV_BAD_SOURCE;
+    }
+    for (int i = 1; i < n; ++i)
+    {
+        if (!map->attractionMapper.getGeoCoord(stops[i - 1], locations[i]))
+        {
+            return Navigator::NavResult::NAV_BAD_DESTINATION;
+        }
+        if (!mayConnect(*map, locations[0], locations[i]))
+        {
+            return Navigator::NavResult::NAV_NO_ROUTE;
+        }
+    }
+
+    auto distances = std::vector<double>{};
+    if (!computeTripDistances(*map, locations, options.nThreads, distances))
+    {
+        return Navigator::NavResult::NAV_NO_ROUTE;
+    }
+
+    auto budget = std::chrono::duration<double, std::milli>(options.timeBudgetMs);
+    auto deadline = tripClock::now() + std::chrono::duration_cast<tripClock::duration>(budget);
+    auto tour = std::vector<int>{};
+    buildNearestInsertionTour(distances, n, tour);
+    while (tripClock::now() <= deadline)
+    {
+        auto improved = improveByTwoOpt(distances, n, tour, deadline);
+        improved = improveByOrOpt(distances, n, tour, deadline) or improved;
+        if (!improved)
+        {
+            break;
+        }
+    }
+
+    order.resize(n - 1);
+    for (int k = 1; k < n; ++k)
+    {
+        order[k - 1] = tour[k] - 1;
+    }
+
+    // Stitch the legs together, back to the depot at the end.
+    directions.clear();
+    auto route = CompactRoute();
+    auto legDirections = std::vector<NavSegment>{};
+    for (int k = 0; k < n; ++k)
+    {
+        const auto &from = locations[tour[k]];
+        const auto &to   = locations[tour[(k + 1) % n]];
+        if (from == to)
+        {
+            continue;
+        }
+        if (navigateByArcs(map, *turns, from, to, route) != Navigator::NavResult::NAV_SUCCESS)
+        {
+            return Navigator::NavResult::NAV_NO_ROUTE;
+        }
+        getNavSegments(route, legDirections);
+        directions.insert(end(directions), begin(legDirections), end(legDirections));
+    }
+
+    return Navigator::NavResult::NAV_SUCCESS;
+}
+
+// Fills distances, row-major, with the road distance from every location to
+// every other one. Rows are shared out between nThreads workers, each with a
+// tree of its own. @return false if some location cannot reach another one.
+bool NavigatorImpl::computeTripDistances(const MapSnapshot &map,
+                                         const std::vector<GeoCoord> &locations,
+                                         int nThreads, std::vector<double> &distances) const
+{
+    const auto &graph   = map.graph;
+    const auto infinity = std::numeric_limits<double>::max();
+    auto n = static_cast<int>(size(locations));
+
+    auto anchors    = std::vector<std::vector<Anchor>>(n);
+    auto coverNodes = std::vector<int>{};
+    for (int i = 0; i < n; ++i)
+    {
+        graph.anchorsOf(locations[i], anchors[i]);
+        for (const auto &anchor : anchors[i])
+        {
+            coverNodes.emplace_back(anchor.node);
+        }
+    }
+
+    // Locations on the same segment can also be joined directly.
+    auto shareSegment = [&](int i, int j) {
+        for (const auto &anchorI : anchors[i])
+        {
+            for (const auto &anchorJ : anchors[j])
+            {
+                if (anchorI.segment != -1 and anchorI.segment == anchorJ.segment)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    distances.assign(n * n, infinity);
+    auto nextRow = std::atomic<int>(0);
+    auto worker  = [&]() {
+        auto tree = DijkstraTree(graph);
+        for (auto i = nextRow++; i < n; i = nextRow++)
+        {
+            tree.reset();
+            for (const auto &anchor : anchors[i])
+            {
+                tree.addSeed(anchor.node, anchor.distance);
+            }
+            tree.growToCover(coverNodes);
+
+            auto row = distances.data() + i * n;
+            for (int j = 0; j < n; ++j)
+            {
+                if (locations[i] == locations[j])
+                {
+                    row[j] = 0.0;
+                    continue;
+                }
+                for (const auto &anchor : anchors[j])
+                {
+                    if (tree.isSettled(anchor.node))
+                    {
+                        row[j] = std::min(row[j], tree.distance(anchor.node) + anchor.distance);
+                    }
+                }
+                if (shareSegment(i, j))
+                {
+                    row[j] = std::min(row[j], distanceEarthMiles(locations[i], locations[j]));
+                }
+            }
+        }
+    };
+
+    if (nThreads <= 0)
+    {
+        nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    nThreads = std::min(nThreads, n);
+    auto workers = std::vector<std::thread>{};
+    for (int t = 1; t < nThreads; ++t)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+
+    return std::find(begin(distances), end(distances), infinity) == end(distances);
+}
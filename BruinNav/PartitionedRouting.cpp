@@ -0,0 +1,448 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "PartitionedRouting.h"
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+#include "TiledMap.h"
+
+static const double infinity = std::numeric_limits<double>::max();
+
+static void splitTabs(const std::string &line, std::vector<std::string> &fields)
+{
+    fields.clear();
+    auto start = size_t(0);
+    for (;;)
+    {
+        auto tab = line.find('\t', start);
+        fields.emplace_back(line, start, tab == std::string::npos ? std::string::npos
+                                                                  : tab - start);
+        if (tab == std::string::npos)
+        {
+            return;
+        }
+        start = tab + 1;
+    }
+}
+
+// Exact to the last bit, -1 for infinity.
+static void appendMiles(std::string &out, double miles)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "\t%.17g", miles == infinity ? -1.0 : miles);
+    out += text;
+}
+
+static double milesField(const std::string &field)
+{
+    auto miles = std::strtod(field.c_str(), nullptr);
+    return miles < 0.0 ? infinity : miles;
+}
+
+static std::string locationFields(const GeoCoord &gc)
+{
+    return "\t" + gc.sLatitude + "\t" + gc.sLongitude;
+}
+
+// Miles straight along a segment both locations lie on, infinity if none.
+static double alongSegment(const GeoCoord &from, const std::vector<Anchor> &fromAnchors,
+                           const GeoCoord &to, const std::vector<Anchor> &toAnchors,
+                           int &segment)
+{
+    segment = -1;
+    for (const auto &a : fromAnchors)
+    {
+        for (const auto &b : toAnchors)
+        {
+            if (a.segment != -1 and a.segment == b.segment)
+            {
+                segment = a.segment;
+                return distanceEarthMiles(from, to);
+            }
+        }
+    }
+    return infinity;
+}
+
+PartitionWorker::PartitionWorker(const TileIndex &index, int partition, int nPartitions,
+                                 size_t memoryBudget)
+    : index_(index), partition_(partition), nPartitions_(nPartitions),
+      cache_(index, memoryBudget)
+{
+}
+
+void PartitionWorker::answer(const std::string &request, std::string &reply) const
+{
+    auto fields = std::vector<std::string>{};
+    splitTabs(request, fields);
+    auto isDist = fields[0] == "DIST" and (size(fields) == 4 or size(fields) == 6);
+    auto isPath = fields[0] == "PATH" and size(fields) == 6;
+    char *end   = nullptr;
+    auto tileId = size(fields) > 1 ? std::strtol(fields[1].c_str(), &end, 10) : -1;
+    if ((!isDist and !isPath) or end == fields[1].c_str() or *end != '\0')
+    {
+        reply = "ERR\tbad_request\n";
+        return;
+    }
+    auto tile = tileId < 0 or tileId >= static_cast<long>(size(index_.tiles)) or
+                partitionOf(static_cast<int>(tileId), nPartitions_) != partition_
+                ? nullptr : cache_.get(static_cast<int>(tileId));
+    if (tile == nullptr)
+    {
+        reply = "ERR\tbad_tile\n";
+        return;
+    }
+    if (isDist)
+    {
+        distances(*tile, fields, reply);
+    }
+    else
+    {
+        path(*tile, fields, reply);
+    }
+}
+
+// Dijkstra from the first location until every boundary node is settled,
+// then on to the second location if there is one.
+void PartitionWorker::distances(const Tile &tile, const std::vector<std::string> &fields,
+                                std::string &reply) const
+{
+    const auto &graph = tile.graph;
+    auto from    = GeoCoord(fields[2], fields[3]);
+    auto anchors = std::vector<Anchor>{};
+    graph.anchorsOf(from, anchors);
+    auto tree = DijkstraTree(graph);
+    tree.reset();
+    for (const auto &anchor : anchors)
+    {
+        tree.addSeed(anchor.node, anchor.distance);
+    }
+    tree.growToCover(tile.localNode);
+
+    reply = "OK";
+    for (auto node : tile.localNode)
+    {
+        appendMiles(reply, tree.isSettled(node) ? tree.distance(node) : infinity);
+    }
+    if (size(fields) == 6)
+    {
+        auto to        = GeoCoord(fields[4], fields[5]);
+        auto toAnchors = std::vector<Anchor>{};
+        graph.anchorsOf(to, toAnchors);
+        auto best    = -1;
+        auto segment = -1;
+        auto miles   = anchors.empty() ? infinity : tree.growToAnchors(toAnchors, best);
+        appendMiles(reply, std::min(miles, alongSegment(from, anchors, to, toAnchors, segment)));
+    }
+    reply += "\n";
+}
+
+// A* from the first location to the second, then the streets back from it.
+void PartitionWorker::path(const Tile &tile, const std::vector<std::string> &fields,
+                           std::string &reply) const
+{
+    const auto &graph = tile.graph;
+    auto from        = GeoCoord(fields[2], fields[3]);
+    auto to          = GeoCoord(fields[4], fields[5]);
+    auto fromAnchors = std::vector<Anchor>{};
+    auto toAnchors   = std::vector<Anchor>{};
+    graph.anchorsOf(from, fromAnchors);
+    graph.anchorsOf(to, toAnchors);
+
+    auto tree = ShortestPathTree(graph);
+    tree.reset(to);
+    for (const auto &anchor : fromAnchors)
+    {
+        tree.addSeed(anchor.node, anchor.distance);
+    }
+    auto best    = -1;
+    auto miles   = tree.growToAnchors(toAnchors, best);
+    auto segment = -1;
+    auto direct  = alongSegment(from, fromAnchors, to, toAnchors, segment);
+    if (best == -1 and direct == infinity)
+    {
+        reply = "ERR\tno_route\n";
+        return;
+    }
+
+    auto step = [&](const GeoCoord &gc, int segId) {
+        reply += "\t" + graph.streetName(graph.segment(segId).streetName);
+        reply += locationFields(gc);
+    };
+    reply = "OK";
+    appendMiles(reply, std::min(miles, direct));
+    reply += locationFields(from);
+    if (direct <= miles)
+    {
+        step(to, segment);
+        reply += "\n";
+        return;
+    }
+
+    auto arcs = std::vector<int>{};
+    auto root = toAnchors[best].node;
+    for (; tree.parentArc(root) != -1; root = graph.arc(arcs.back()).tail)
+    {
+        arcs.emplace_back(tree.parentArc(root));
+    }
+    const Anchor *seed = nullptr;
+    for (const auto &anchor : fromAnchors)
+    {
+        if (anchor.node == root and (seed == nullptr or anchor.distance < seed->distance))
+        {
+            seed = &anchor;
+        }
+    }
+    if (seed->segment != -1)
+    {
+        step(graph.coord(root), seed->segment);
+    }
+    for (auto a = rbegin(arcs); a != rend(arcs); ++a)
+    {
+        const auto &arc = graph.arc(*a);
+        step(graph.coord(arc.head), arc.segment);
+    }
+    if (toAnchors[best].segment != -1)
+    {
+        step(to, toAnchors[best].segment);
+    }
+    reply += "\n";
+}
+
+PartitionCoordinator::PartitionCoordinator(const TileIndex &index, int nPartitions,
+                                           PartitionLink link)
+    : index_(index), nPartitions_(nPartitions), link_(std::move(link))
+{
+}
+
+bool PartitionCoordinator::call(const std::string &command, int tileId,
+                                const std::string &arguments, std::vector<std::string> &fields,
+                                std::vector<PartitionHop> &hops) const
+{
+    auto partition = partitionOf(tileId, nPartitions_);
+    auto request   = command + "\t" + std::to_string(tileId) + arguments;
+    auto reply     = std::string();
+    auto sent      = std::chrono::steady_clock::now();
+    auto reached   = link_(partition, request, reply);
+    auto elapsed   = std::chrono::steady_clock::now() - sent;
+    hops.push_back({ partition, command, tileId,
+                     std::chrono::duration<double, std::micro>(elapsed).count() });
+    if (!reached)
+    {
+        return false;
+    }
+    if (!reply.empty() and reply.back() == '\n')
+    {
+        reply.pop_back();
+    }
+    splitTabs(reply, fields);
+    return fields[0] == "OK";
+}
+
+bool PartitionCoordinator::appendPath(int tileId, const GeoCoord &from, const GeoCoord &to,
+                                      std::vector<StreetSegment> &path,
+                                      std::vector<PartitionHop> &hops) const
+{
+    auto fields = std::vector<std::string>{};
+    if (!call("PATH", tileId, locationFields(from) + locationFields(to), fields, hops) or
+        size(fields) < 4 or (size(fields) - 4) % 3 != 0)
+    {
+        return false;
+    }
+    auto previous = GeoCoord(fields[2], fields[3]);
+    for (size_t i = 4; i < size(fields); i += 3)
+    {
+        auto next = GeoCoord(fields[i + 1], fields[i + 2]);
+        path.emplace_back();
+        path.back().streetName = fields[i];
+        path.back().segment    = GeoSegment(previous, next);
+        previous = next;
+    }
+    return true;
+}
+
+/**
+ *  Dijkstra over the boundary nodes only. The partitions of the source
+ *  tiles seed it with the distances from the source, and those of the
+ *  destination tiles give the last leg from each of their boundary nodes;
+ *  a tile holding both also gives the best way that stays inside it. A
+ *  route changes tiles only at boundary nodes, so these cover them all.
+ */
+Navigator::NavResult PartitionCoordinator::navigate(std::string start, std::string end,
+                                                    std::vector<NavSegment> &directions,
+                                                    std::vector<PartitionHop> &hops) const
+{
+    hops.clear();
+    makeLowerCase(start);
+    makeLowerCase(end);
+    const auto *src = index_.attractions.find(start);
+    if (src == nullptr)
+    {
+        return Navigator::NAV_BAD_SOURCE;
+    }
+    const auto *dst = index_.attractions.find(end);
+    if (dst == nullptr)
+    {
+        return Navigator::NAV_BAD_DESTINATION;
+    }
+    if (src->location == dst->location)
+    {
+        directions.clear();
+        return Navigator::NAV_SUCCESS;
+    }
+
+    // via is the tile of the shortcut into a boundary node, or of the
+    // first leg for the boundary nodes seeded from the source.
+    auto nBoundary = size(index_.boundaryCoords);
+    auto distance  = std::vector<double>(nBoundary, infinity);
+    auto parent    = std::vector<int>(nBoundary, -1);
+    auto via       = std::vector<int>(nBoundary, -1);
+    auto settled   = std::vector<bool>(nBoundary, false);
+    using nodeEntry = std::pair<double, int>;
+    auto open = std::priority_queue<nodeEntry, std::vector<nodeEntry>,
+                                    std::greater<nodeEntry>>();
+    auto relax = [&](int node, double d, int from, int tileId) {
+        if (d < distance[node])
+        {
+            distance[node] = d;
+            parent[node]   = from;
+            via[node]      = tileId;
+            open.emplace(d, node);
+        }
+    };
+
+    struct TargetLeg
+    {
+        int    boundary;
+        int    tile;
+        double distance;
+    };
+    auto targets      = std::vector<TargetLeg>{};
+    auto bestDistance = infinity;
+    auto bestTarget   = -1;     // -1 with a finite bestDistance stays inside bestTile.
+    auto bestTile     = -1;
+    auto fields       = std::vector<std::string>{};
+    for (auto tileId : src->tiles)
+    {
+        const auto &info = index_.tiles[tileId];
+        auto k        = size(info.boundary);
+        auto isTarget = std::find(begin(dst->tiles), std::end(dst->tiles), tileId) !=
+                        std::end(dst->tiles);
+        auto arguments = locationFields(src->location) +
+                         (isTarget ? locationFields(dst->location) : std::string());
+        if (!call("DIST", tileId, arguments, fields, hops) or size(fields) != 1 + k + isTarget)
+        {
+            return Navigator::NAV_NO_ROUTE;
+        }
+        for (size_t p = 0; p < k; ++p)
+        {
+            relax(info.boundary[p], milesField(fields[1 + p]), -1, tileId);
+        }
+        if (isTarget and milesField(fields[1 + k]) < bestDistance)
+        {
+            bestDistance = milesField(fields[1 + k]);
+            bestTile     = tileId;
+        }
+    }
+    for (auto tileId : dst->tiles)
+    {
+        const auto &info = index_.tiles[tileId];
+        if (!call("DIST", tileId, locationFields(dst->location), fields, hops) or
+            size(fields) != 1 + size(info.boundary))
+        {
+            return Navigator::NAV_NO_ROUTE;
+        }
+        for (size_t p = 0; p < size(info.boundary); ++p)
+        {
+            if (milesField(fields[1 + p]) != infinity)
+            {
+                targets.push_back({ info.boundary[p], tileId, milesField(fields[1 + p]) });
+            }
+        }
+    }
+
+    while (!open.empty())
+    {
+        auto current = open.top();
+        open.pop();
+        auto node = current.second;
+        if (current.first >= bestDistance)
+        {
+            break;
+        }
+        if (settled[node])
+        {
+            continue;
+        }
+        settled[node] = true;
+
+        for (int t = 0; t < static_cast<int>(size(targets)); ++t)
+        {
+            if (targets[t].boundary == node and
+                current.first + targets[t].distance < bestDistance)
+            {
+                bestDistance = current.first + targets[t].distance;
+                bestTarget   = t;
+            }
+        }
+        for (const auto &slot : index_.boundarySlots[node])
+        {
+            const auto &info = index_.tiles[slot.tile];
+            auto k   = static_cast<int>(size(info.boundary));
+            auto row = info.clique.data() + slot.position * k;
+            for (int q = 0; q < k; ++q)
+            {
+                if (q != slot.position and row[q] != std::numeric_limits<double>::infinity())
+                {
+                    relax(info.boundary[q], current.first + row[q], node, slot.tile);
+                }
+            }
+        }
+    }
+
+    if (bestDistance == infinity)
+    {
+        return Navigator::NAV_NO_ROUTE;
+    }
+    auto path = std::vector<StreetSegment>{};
+    if (bestTarget == -1)
+    {
+        if (!appendPath(bestTile, src->location, dst->location, path, hops))
+        {
+            return Navigator::NAV_NO_ROUTE;
+        }
+        buildDirections(path, directions);
+        return Navigator::NAV_SUCCESS;
+    }
+
+    auto steps = std::vector<int>{};
+    for (auto node = targets[bestTarget].boundary; node != -1; node = parent[node])
+    {
+        steps.emplace_back(node);
+    }
+    std::reverse(begin(steps), std::end(steps));
+    auto reached = appendPath(via[steps.front()], src->location,
+                              index_.boundaryCoords[steps.front()], path, hops);
+    for (size_t i = 1; reached and i < size(steps); ++i)
+    {
+        reached = appendPath(via[steps[i]], index_.boundaryCoords[steps[i - 1]],
+                             index_.boundaryCoords[steps[i]], path, hops);
+    }
+    reached = reached and appendPath(targets[bestTarget].tile, index_.boundaryCoords[steps.back()],
+                                     dst->location, path, hops);
+    if (!reached)
+    {
+        return Navigator::NAV_NO_ROUTE;
+    }
+    buildDirections(path, directions);
+    return Navigator::NAV_SUCCESS;
+}
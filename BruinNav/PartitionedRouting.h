@@ -0,0 +1,118 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Provided.h"
+#include "TiledMap.h"
+
+/**
+ *  Routing over a tiled map (see TiledMap.h) spread over several processes.
+ *
+ *  Each partition serves the tiles whose id is its own modulo the number of
+ *  partitions, whole geographic cells each, and answers requests about
+ *  them alone. The coordinator keeps only the index: it runs Dijkstra over
+ *  the overlay of boundary nodes and clique shortcuts, asks the partitions
+ *  of the source and destination tiles how far their boundary nodes are
+ *  from the endpoints, then asks the partitions on the route for the
+ *  streets of each of its steps.
+ *
+ *  Requests and replies are single lines of tab-separated fields, with
+ *  locations as the latitude and longitude strings of the map file and
+ *  distances in miles, -1 where the tile does not join two places:
+ *      DIST <tile> <lat> <lon> [<lat> <lon>]
+ *          OK <miles to each boundary node of the tile, in clique order>
+ *             [<miles to the second location>]
+ *      PATH <tile> <lat> <lon> <lat> <lon>
+ *          OK <miles> <lat> <lon> then <street> <lat> <lon> per step
+ *  or ERR <reason>: bad_request, bad_tile, no_route.
+ */
+
+inline int partitionOf(int tileId, int nPartitions)
+{
+    return tileId % nPartitions;
+}
+
+// Answers the requests about the tiles of one partition. Thread-safe.
+class PartitionWorker
+{
+public:
+    PartitionWorker(const PartitionWorker &other)          = delete;
+    PartitionWorker &operator=(const PartitionWorker &rhs) = delete;
+
+public:
+    /**
+     *  @param index        the index of the tiled map; must outlive the worker.
+     *  @param memoryBudget for the tiles of the partition kept resident.
+     */
+    PartitionWorker(const TileIndex &index, int partition, int nPartitions,
+                    size_t memoryBudget);
+
+    // reply receives one line, '\n' included.
+    void answer(const std::string &request, std::string &reply) const;
+
+private:
+    void distances(const Tile &tile, const std::vector<std::string> &fields,
+                   std::string &reply) const;
+
+    void path(const Tile &tile, const std::vector<std::string> &fields,
+              std::string &reply) const;
+
+private:
+    const TileIndex    &index_;
+    int                 partition_;
+    int                 nPartitions_;
+    mutable TileCache   cache_;
+};
+
+// One round trip to a partition, as the coordinator saw it.
+struct PartitionHop
+{
+    int         partition;
+    std::string command;        // "DIST" or "PATH".
+    int         tile;
+    double      microseconds;
+};
+
+/**
+ *  Sends a request line, without its '\n', to a partition and receives its
+ *  reply line. False if the partition cannot be reached.
+ */
+using PartitionLink = std::function<bool(int partition, const std::string &request,
+                                         std::string &reply)>;
+
+// Routes over the partitions through link. Not thread-safe: the link is not.
+class PartitionCoordinator
+{
+public:
+    PartitionCoordinator(const PartitionCoordinator &other)          = delete;
+    PartitionCoordinator &operator=(const PartitionCoordinator &rhs) = delete;
+
+public:
+    // index must outlive the coordinator.
+    PartitionCoordinator(const TileIndex &index, int nPartitions, PartitionLink link);
+
+    /**
+     *  Finds routes as long as Navigator's, without turn penalties.
+     *  @param hops receives every round trip made, in order.
+     *  @return NAV_NO_ROUTE as well if a partition cannot be reached.
+     */
+    Navigator::NavResult navigate(std::string start, std::string end,
+                                  std::vector<NavSegment> &directions,
+                                  std::vector<PartitionHop> &hops) const;
+
+private:
+    // One request to the partition of tileId, timed into hops.
+    bool call(const std::string &command, int tileId, const std::string &arguments,
+              std::vector<std::string> &fields, std::vector<PartitionHop> &hops) const;
+
+    // Appends the streets of the way from one location to another inside a tile.
+    bool appendPath(int tileId, const GeoCoord &from, const GeoCoord &to,
+                    std::vector<StreetSegment> &path, std::vector<PartitionHop> &hops) const;
+
+private:
+    const TileIndex    &index_;
+    int                 nPartitions_;
+    PartitionLink       link_;
+};
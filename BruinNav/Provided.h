@@ -1,6 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #define pi 3.14159265358979323846
@@ -10,6 +18,11 @@ class MapLoaderImpl;
 class SegmentMapperImpl;
 class AttractionMapperImpl;
 class NavigatorImpl;
+class TiledNavigatorImpl;
+class TraceMatcherImpl;
+struct AsyncRoute;
+struct MapSnapshot;
+struct SearchTrace;
 
 struct GeoCoord
 {
@@ -132,6 +145,9 @@ public:
     bool load(std::string mapFile);
     size_t getNumSegments() const;
     bool getSegment(size_t segNum, StreetSegment &seg) const;
+    // Bytes the loaded segments hold, and the part in string buffers.
+    size_t getMemoryBytes() const;
+    size_t getStringBytes() const;
 
 private:
     MapLoaderImpl *pImpl_;
@@ -145,6 +161,8 @@ public:
     ~SegmentMapper();
     void init(const MapLoader &ml);
     std::vector<StreetSegment> getSegments(const GeoCoord &gc) const;
+    size_t getMemoryBytes() const;
+    size_t getStringBytes() const;
 
 private:
     SegmentMapperImpl *pImpl_;
@@ -158,6 +176,12 @@ public:
     ~AttractionMapper();
     void init(const MapLoader &ml);
     bool getGeoCoord(std::string attraction, GeoCoord &gc) const;
+    // Same, lowering the name into a buffer the caller keeps, so a warm
+    // buffer makes the lookup allocation-free.
+    bool getGeoCoord(const std::string &attraction, GeoCoord &gc,
+                     std::string &lowered) const;
+    size_t getMemoryBytes() const;
+    size_t getStringBytes() const;
 
 private:
     AttractionMapperImpl *pImpl_;
@@ -231,6 +255,149 @@ private:
     GeoSegment		m_gs;
 };
 
+// Compact form of a NavSegment. Directions are enums and the street and end
+// points are ids into the loaded map, so no strings are built until a caller
+// asks Navigator::getNavSegments (or getDirection) for them.
+struct CompactNavSegment
+{
+    enum TRAVEL_DIRECTION
+    {
+        east, northeast, north, northwest, west, southwest, south, southeast
+    };
+    enum TURN_DIRECTION { left, right };
+
+    static const char *travelDirectionName(int direction)
+    {
+        static const char *const names[] = {
+            "east", "northeast", "north", "northwest",
+            "west", "southwest", "south", "southeast"
+        };
+        return names[direction];
+    }
+
+    static const char *turnDirectionName(int direction)
+    {
+        return direction == left ? "left" : "right";
+    }
+
+    const char *getDirection() const
+    {
+        return command == NavSegment::turn ? turnDirectionName(direction)
+                                           : travelDirectionName(direction);
+    }
+
+    NavSegment::NAV_COMMAND command    = NavSegment::invalid;
+    unsigned char           direction  = 0;     // TRAVEL_DIRECTION, TURN_DIRECTION for turns
+    int                     streetName = -1;    // see Navigator::getStreetName
+    int                     startNode  = -1;    // -1 is the route's source
+    int                     endNode    = -1;    // -1 is the route's destination
+    double                  distance   = 0.0;   // miles
+};
+
+// Reusable output buffer for the compact form of Navigator::navigate.
+struct CompactRoute
+{
+    GeoCoord                        source;
+    GeoCoord                        destination;
+    std::vector<CompactNavSegment>  segments;
+    // The map the ids refer to, kept alive by the route across reloads.
+    std::shared_ptr<const MapSnapshot> map;
+};
+
+// Extra cost, in miles of driving, charged by the edge-based search for
+// each manoeuvre. Street changes are charged on top of the turn itself.
+struct TurnPenalties
+{
+    double left         = 0.0;
+    double right        = 0.0;
+    double uTurn        = 0.0;
+    double streetChange = 0.0;
+};
+
+// Limits on the routes returned by Navigator::navigateAlternatives.
+struct AlternativeLimits
+{
+    int    maxRoutes  = 3;
+    double maxStretch = 0.25;   // at most 25% longer than the shortest route,
+    double maxOverlap = 0.6;    // sharing at most 60% of its length with the
+                                // routes returned before it.
+};
+
+// Options of Navigator::planTrip.
+struct TripOptions
+{
+    int    nThreads     = 0;        // searches run in parallel, 0 for one per core.
+    double timeBudgetMs = 100.0;    // time allowed to improve the visiting order.
+};
+
+// A GPS fix of a trace, at seconds from any fixed time.
+struct GpsPing
+{
+    GeoCoord location;
+    double   seconds = 0.0;
+};
+
+// Options of Navigator::matchTrace and TraceMatcher. Distances in miles.
+struct MatchOptions
+{
+    double gpsSigma        = 0.003;     // spread of the GPS error, about 5 m.
+    double candidateRadius = 0.03;      // segments farther from a ping are not tried.
+    int    maxCandidates   = 6;         // closest segments tried per ping.
+    double beta            = 0.003;     // scale of the driving detours allowed for.
+    double maxDetour       = 0.5;       // driving beyond the straight line between pings.
+    double maxSpeedMph     = 100.0;     // bounds the driving between timed pings.
+    int    maxLag          = 20;        // pings a TraceMatcher holds back at most.
+    int    nThreads        = 0;         // traces matched in parallel, 0 for one per core.
+};
+
+// An attraction found by Navigator::nearestAttractions.
+struct NearbyAttraction
+{
+    std::string  name;              // as the map file spells it.
+    GeoCoord     location;
+    double       miles = 0.0;       // driving distance from the start.
+    CompactRoute route;             // empty unless routes were asked for.
+};
+
+// How writeSearchTrace writes a trace.
+enum TraceFormat
+{
+    TRACE_GEOJSON,      // a FeatureCollection of LineStrings, in [longitude, latitude].
+    TRACE_BINARY        // packed floats, a fifth of the size; see writeSearchTrace.
+};
+
+// Memory held by a Navigator, by structure, counted exactly as it is
+// allocated. String buffers are counted within their structure and broken
+// out again in strings. Only programs built with BRUINNAV_MEMORY_HOOKS
+// count allocations; elsewhere measured is false and every figure is 0.
+struct MemoryUsage
+{
+    bool   measured        = false; // the figures below were counted.
+    size_t segmentStorage  = 0;     // MapLoader's segments, freed once the map is built.
+    size_t segmentIndex    = 0;     // SegmentMapper.
+    size_t attractionIndex = 0;     // AttractionMapper.
+    size_t streetGraph     = 0;     // arcs, turns, chains and components.
+    size_t hubLabels       = 0;     // 0 until Navigator::buildHubLabels.
+    size_t strings         = 0;     // of the three structures above.
+    size_t total           = 0;     // held while the map stays loaded.
+    size_t navigatePeak    = 0;     // highest scratch of the latest navigate.
+};
+
+// Lets a caller stop the queries it passed the token to. Copies share one
+// flag, so cancelling any copy cancels every query holding one.
+class CancellationToken
+{
+public:
+    CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { cancelled_->store(true); }
+
+    bool isCancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
 // Pointer to Implementation
 class Navigator
 {
@@ -240,14 +407,205 @@ public:
         NAV_SUCCESS,
         NAV_BAD_SOURCE,
         NAV_BAD_DESTINATION,
-        NAV_NO_ROUTE
+        NAV_NO_ROUTE,
+        NAV_TIMEOUT,
+        NAV_CANCELLED
     };
     Navigator();
     ~Navigator();
+    // Builds the new map while queries go on with the old one, then swaps
+    // it in; queries already running finish on the map they started with.
     bool loadMapData(std::string mapFile);
     NavResult navigate(std::string start, std::string end,
         std::vector<NavSegment>& directions) const;
+    // Same search, but writes ids and enums into a reusable route buffer.
+    // Once the calling thread has run a query and route holds a result as
+    // long, it allocates nothing on the heap (without a query log or
+    // search tracing).
+    NavResult navigate(const std::string &start, const std::string &end,
+        CompactRoute &route) const;
+    // Builds the strings of a compact route on demand.
+    void getNavSegments(const CompactRoute &route,
+        std::vector<NavSegment> &directions) const;
+    // Name of a street id of the map loaded now.
+    std::string getStreetName(int streetName) const;
+    // Location of an attraction, false if there is none by that name.
+    bool getGeoCoord(std::string attraction, GeoCoord &gc) const;
+    // Up to limits.maxRoutes distinct routes, shortest first.
+    NavResult navigateAlternatives(std::string start, std::string end,
+        const AlternativeLimits &limits, std::vector<CompactRoute> &routes) const;
+    // Route from position, an intersection, attraction or point of a street
+    // the vehicle reached off previous, to the destination of previous. A
+    // point of a street is snapped onto the closest segment within
+    // MatchOptions().candidateRadius, where the route then starts. A tree
+    // of the routes into each recent destination is kept and grown only as
+    // far as the positions asked need, so re-routes towards one destination
+    // cost a fraction of navigate. Turn penalties, if set, are honoured by a
+    // fresh search instead.
+    NavResult reroute(const CompactRoute &previous, const GeoCoord &position,
+        CompactRoute &route) const;
+    // The k attractions closest to start by driving distance, closest
+    // first, from one search that stops once the k-th is known. Attractions
+    // accept turns down (given their names, each at most once) are passed
+    // over without being routed to; attractions at start are never found.
+    // Fewer than k if no more can be reached; NAV_NO_ROUTE if none can.
+    NavResult nearestAttractions(std::string start, int k,
+        std::vector<NearbyAttraction> &found,
+        const std::function<bool(const std::string &)> &accept = nullptr,
+        bool withRoutes = false) const;
+    // Round trip from depot through every stop, in the order found shortest.
+    // order receives indices into stops, directions the whole trip.
+    NavResult planTrip(std::string depot, const std::vector<std::string> &stops,
+        const TripOptions &options, std::vector<int> &order,
+        std::vector<NavSegment> &directions) const;
+    // Penalties charged by navigate() from the queries starting next on;
+    // safe to call while other threads run queries.
+    void setTurnPenalties(const TurnPenalties &penalties);
+    // Connected component of an attraction's streets, -1 if it is unknown.
+    // Attractions in different components have no route between them.
+    int getComponent(std::string attraction) const;
+    // Number of street endpoints in each component, largest first.
+    void getComponentSizes(std::vector<int> &sizes) const;
+    // Memory held by the map loaded now.
+    void getMemoryUsage(MemoryUsage &usage) const;
+    // Builds hub labels for networkDistance, now and after every reload.
+    void buildHubLabels();
+    // Length in miles of the shortest route, turn penalties aside, without
+    // building directions. Answered from the hub labels once they are built.
+    NavResult networkDistance(std::string start, std::string end, double &miles) const;
+    // networkDistance of many pairs; miles[i] and results[i] answer pairs[i].
+    void networkDistances(const std::vector<std::pair<std::string, std::string>> &pairs,
+        std::vector<double> &miles, std::vector<NavResult> &results) const;
+    // Runs the compact navigate on worker threads owned by the navigator.
+    // The search gives up with NAV_TIMEOUT once deadline has passed, or with
+    // NAV_CANCELLED once token is cancelled, including while still queued.
+    std::future<AsyncRoute> navigateAsync(std::string start, std::string end,
+        std::chrono::steady_clock::time_point deadline,
+        CancellationToken token = CancellationToken()) const;
+    // Records every navigate and navigateAsync query, with its result and
+    // latency, to a binary log (see QueryLog.h) that the replay tool plays
+    // back. Replaces the log open before; false if it cannot be written.
+    bool startQueryLog(std::string logFile);
+    // The log is closed once the queries still recording into it are done.
+    void stopQueryLog();
+    // The compact navigate, also recording what its search explored.
+    NavResult navigateTraced(std::string start, std::string end,
+        CompactRoute &route, SearchTrace &trace) const;
+    // From now on one compact or async navigate in every samplePeriod writes
+    // its trace to a file of its own in directory; 0 stops tracing. Queries
+    // not sampled run the search without any tracing code.
+    void setSearchTracing(int samplePeriod, std::string directory,
+        TraceFormat format = TRACE_GEOJSON);
+    // Most likely streets driven along a GPS trace, in order, each once per
+    // visit. Pings far from every street are skipped; NAV_NO_ROUTE if all
+    // of them are.
+    NavResult matchTrace(const std::vector<GpsPing> &trace,
+        std::vector<StreetSegment> &segments,
+        const MatchOptions &options = MatchOptions()) const;
+    // matchTrace of many traces on options.nThreads threads; segments[i]
+    // and results[i] answer traces[i].
+    void matchTraces(const std::vector<std::vector<GpsPing>> &traces,
+        std::vector<std::vector<StreetSegment>> &segments,
+        std::vector<NavResult> &results,
+        const MatchOptions &options = MatchOptions()) const;
 
 private:
+    friend class TraceMatcher;
     NavigatorImpl* pImpl_;
-};
\ No newline at end of file
+};
+
+// Pointer to Implementation
+// Matches a trace as its pings arrive, on the map the navigator had loaded
+// when the matcher was made. Each ping is decided once the likeliest ways
+// through the later ones agree on it, or options.maxLag pings later.
+class TraceMatcher
+{
+public:
+    TraceMatcher(const Navigator &navigator, const MatchOptions &options = MatchOptions());
+    ~TraceMatcher();
+    // Appends the streets driven up to the pings decided by this one.
+    void addPing(const GpsPing &ping, std::vector<StreetSegment> &segments);
+    // Appends the rest of the trace; the next ping starts a new one.
+    void finish(std::vector<StreetSegment> &segments);
+
+private:
+    TraceMatcherImpl *pImpl_;
+};
+
+// What the future of Navigator::navigateAsync delivers.
+struct AsyncRoute
+{
+    Navigator::NavResult result = Navigator::NAV_NO_ROUTE;
+    CompactRoute         route;
+};
+
+// A point of a search trace, in degrees.
+struct TracePoint
+{
+    double latitude  = 0.0;
+    double longitude = 0.0;
+};
+
+// A street chain settled by a traced search, from the location it leaves
+// to the one it reaches. g is its cost from the source, f that plus the
+// lower bound on the rest of the way the search ordered chains by.
+struct TracedStep
+{
+    TracePoint from;
+    TracePoint to;
+    double     g = 0.0;
+    double     f = 0.0;
+};
+
+// What Navigator::navigateTraced explored.
+struct SearchTrace
+{
+    std::string             start;
+    std::string             end;
+    Navigator::NavResult    result = Navigator::NAV_NO_ROUTE;
+    std::vector<TracedStep> steps;  // in the order they were settled.
+    std::vector<TracePoint> path;   // the route found, source to destination.
+};
+
+/**
+ *  Writes a trace to overlay on a map. TRACE_GEOJSON writes one feature
+ *  per step, with its order, g and f, and one for the path. TRACE_BINARY
+ *  writes "BNTRACE1", then little-endian: the lengths of start and end as
+ *  uint16 and their bytes, the result as uint8, the numbers of steps and of
+ *  path points as uint32, each step as six float32 (from, to, g, f) and each
+ *  path point as two (latitude, longitude).
+ *  @return false if out fails.
+ */
+bool writeSearchTrace(const SearchTrace &trace, TraceFormat format, std::ostream &out);
+
+// Counters of the tile cache of a TiledNavigator.
+struct TileCacheStats
+{
+    long long hits          = 0;
+    long long misses        = 0;    // tiles read from disk.
+    long long evictions     = 0;
+    int       residentTiles = 0;
+    size_t    residentBytes = 0;    // counted from the containers of the tiles.
+};
+
+// Pointer to Implementation
+// Routes over a map cut into tiles by buildTiles, reading only the tiles a
+// query needs and keeping the recently used ones within a memory budget.
+// Finds routes as long as Navigator's, without turn penalties.
+class TiledNavigator
+{
+public:
+    TiledNavigator();
+    ~TiledNavigator();
+    // Cuts a map file into square tiles tileDegrees wide, written to directory.
+    static bool buildTiles(std::string mapFile, std::string directory,
+        double tileDegrees = 0.01);
+    // Reads the index of the tiles; tiles themselves are read on demand.
+    bool open(std::string directory, size_t memoryBudgetBytes);
+    Navigator::NavResult navigate(std::string start, std::string end,
+        std::vector<NavSegment> &directions) const;
+    void getTileStats(TileCacheStats &stats) const;
+
+private:
+    TiledNavigatorImpl *pImpl_;
+};
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "QueryExecutor.h"
+
+QueryExecutor::QueryExecutor(int nThreads)
+    : nThreads_(nThreads)
+{
+    if (nThreads_ <= 0)
+    {
+        nThreads_ = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+}
+
+QueryExecutor::~QueryExecutor()
+{
+    {
+        auto lock = std::lock_guard<std::mutex>(mutex_);
+        stopping_ = true;
+        tasks_.clear();
+    }
+    wakeUp_.notify_all();
+    for (auto &thread : workers_)
+    {
+        thread.join();
+    }
+}
+
+void QueryExecutor::submit(std::function<void()> task)
+{
+    {
+        auto lock = std::lock_guard<std::mutex>(mutex_);
+        if (workers_.empty())
+        {
+            for (int t = 0; t < nThreads_; ++t)
+            {
+                workers_.emplace_back(&QueryExecutor::run, this);
+            }
+        }
+        tasks_.emplace_back(std::move(task));
+    }
+    wakeUp_.notify_one();
+}
+
+void QueryExecutor::run()
+{
+    for (;;)
+    {
+        auto task = std::function<void()>();
+        {
+            auto lock = std::unique_lock<std::mutex>(mutex_);
+            wakeUp_.wait(lock, [this] { return stopping_ or !tasks_.empty(); });
+            if (stopping_)
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
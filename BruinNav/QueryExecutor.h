@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ *  Fixed pool of worker threads running tasks in the order they were
+ *  submitted. The threads are started by the first submit, so a navigator
+ *  that never answers queries asynchronously never starts any.
+ *
+ *  Tasks still queued when the executor is destroyed are dropped without
+ *  running; the tasks being run are waited for.
+ */
+class QueryExecutor
+{
+public:
+    QueryExecutor(const QueryExecutor &other)          = delete;
+    QueryExecutor &operator=(const QueryExecutor &rhs) = delete;
+
+public:
+    // @param nThreads number of workers, 0 for one per core.
+    explicit QueryExecutor(int nThreads = 0);
+
+    ~QueryExecutor();
+
+    // Safe to call from any thread.
+    void submit(std::function<void()> task);
+
+private:
+    void run();
+
+private:
+    int                                 nThreads_;
+    bool                                stopping_ = false;
+    std::mutex                          mutex_;
+    std::condition_variable             wakeUp_;
+    std::deque<std::function<void()>>   tasks_;
+    std::vector<std::thread>            workers_;
+};
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Provided.h"
+#include "QueryLog.h"
+
+bool QueryLogWriter::open(const std::string &path)
+{
+    auto lock = std::lock_guard<std::mutex>(mutex_);
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    out_.write(queryLogMagic, std::strlen(queryLogMagic));
+    opened_ = std::chrono::steady_clock::now();
+    return static_cast<bool>(out_);
+}
+
+void QueryLogWriter::record(const std::string &start, const std::string &end,
+                            Navigator::NavResult result,
+                            std::chrono::steady_clock::time_point began,
+                            std::chrono::steady_clock::time_point ended)
+{
+    auto offset  = std::chrono::duration_cast<std::chrono::microseconds>(began - opened_);
+    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(ended - began);
+    auto lock    = std::lock_guard<std::mutex>(mutex_);
+    auto startId = nameId(start);
+    auto endId   = nameId(end);
+    out_.put('Q');
+    writeVarint(static_cast<unsigned long long>(startId));
+    writeVarint(static_cast<unsigned long long>(endId));
+    writeVarint(static_cast<unsigned long long>(result));
+    writeVarint(static_cast<unsigned long long>(std::max<long long>(0, offset.count())));
+    writeVarint(static_cast<unsigned long long>(std::max<long long>(0, latency.count())));
+}
+
+int QueryLogWriter::nameId(const std::string &name)
+{
+    const auto *id = nameIds_.find(name);
+    if (id != nullptr)
+    {
+        return *id;
+    }
+    nameIds_.associate(name, nNames_);
+    out_.put('N');
+    writeVarint(size(name));
+    out_.write(name.data(), static_cast<std::streamsize>(size(name)));
+    return nNames_++;
+}
+
+void QueryLogWriter::writeVarint(unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        out_.put(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out_.put(static_cast<char>(value));
+}
+
+static bool readVarint(std::istream &in, unsigned long long &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        auto byte = in.get();
+        if (byte == std::char_traits<char>::eof())
+        {
+            return false;
+        }
+        value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool readQueryLog(const std::string &path, std::vector<LoggedQuery> &queries)
+{
+    queries.clear();
+    auto in    = std::ifstream(path, std::ios::binary);
+    auto magic = std::string(std::strlen(queryLogMagic), '\0');
+    if (!in.read(&magic[0], static_cast<std::streamsize>(size(magic))) or magic != queryLogMagic)
+    {
+        return false;
+    }
+
+    auto names = std::vector<std::string>{};
+    for (auto tag = in.get(); tag != std::char_traits<char>::eof(); tag = in.get())
+    {
+        if (tag != 'N' and tag != 'Q')
+        {
+            return false;
+        }
+        auto fields = std::vector<unsigned long long>(tag == 'N' ? 1 : 5);
+        for (auto &field : fields)
+        {
+            if (!readVarint(in, field))
+            {
+                return true;
+            }
+        }
+        if (tag == 'N')
+        {
+            names.emplace_back(fields[0], '\0');
+            if (!in.read(&names.back()[0], static_cast<std::streamsize>(fields[0])))
+            {
+                return true;
+            }
+            continue;
+        }
+        if (fields[0] >= size(names) or fields[1] >= size(names) or
+            fields[2] > Navigator::NAV_CANCELLED)
+        {
+            return false;
+        }
+        queries.emplace_back();
+        auto &query = queries.back();
+        query.start        = names[fields[0]];
+        query.end          = names[fields[1]];
+        query.result       = static_cast<Navigator::NavResult>(fields[2]);
+        query.offsetMicros = static_cast<long long>(fields[3]);
+        query.latencyNanos = static_cast<long long>(fields[4]);
+    }
+    return true;
+}
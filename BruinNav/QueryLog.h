@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MyMap.h"
+#include "Provided.h"
+
+/**
+ *  Binary log of navigate() calls, for replaying the queries of a real
+ *  workload against another build or another map.
+ *
+ *  The file starts with queryLogMagic, then holds records of two kinds,
+ *  each led by a tag byte, with every number an unsigned LEB128 varint:
+ *      'N' <length> <bytes>                    the next name, numbered from 0
+ *      'Q' <start> <end> <result> <offset µs> <latency ns>
+ *  A name is written once, the first time a query uses it, so a query
+ *  usually takes a dozen bytes. Offsets count from when the log was opened,
+ *  to the start of the query; queries are written as they finish.
+ */
+
+const char *const queryLogMagic = "BNQLOG1\n";
+
+// One navigate() as recorded.
+struct LoggedQuery
+{
+    std::string          start;
+    std::string          end;
+    Navigator::NavResult result       = Navigator::NAV_SUCCESS;
+    long long            offsetMicros = 0;
+    long long            latencyNanos = 0;
+};
+
+// Appends queries to a log file. Thread-safe.
+class QueryLogWriter
+{
+public:
+    QueryLogWriter(const QueryLogWriter &other)          = delete;
+    QueryLogWriter &operator=(const QueryLogWriter &rhs) = delete;
+
+public:
+    QueryLogWriter() = default;
+
+    // Flushes and closes the file.
+    ~QueryLogWriter() = default;
+
+    // Truncates path; false if it cannot be written.
+    bool open(const std::string &path);
+
+    void record(const std::string &start, const std::string &end,
+                Navigator::NavResult result, std::chrono::steady_clock::time_point began,
+                std::chrono::steady_clock::time_point ended);
+
+private:
+    // Writes name the first time it is seen.
+    int nameId(const std::string &name);
+
+    void writeVarint(unsigned long long value);
+
+private:
+    std::mutex                              mutex_;
+    std::ofstream                           out_;
+    MyMap<std::string, int>                 nameIds_;
+    int                                     nNames_ = 0;
+    std::chrono::steady_clock::time_point   opened_;
+};
+
+/**
+ *  @param path    a log written by QueryLogWriter.
+ *  @param queries receives its queries, in the order they were written.
+ *  @return false if the file cannot be read or is not a query log; the
+ *          queries before a truncated record are kept.
+ */
+bool readQueryLog(const std::string &path, std::vector<LoggedQuery> &queries);
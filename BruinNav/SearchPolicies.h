@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "CompressedGraph.h"
+#include "GeoKernels.h"
+#include "Provided.h"
+#include "StreetGraph.h"
+
+// The policies a SearchTree is put together from. Each one is a plain class
+// whose members the tree calls directly, so every combination compiles into
+// a search loop of its own with nothing to dispatch at run time.
+
+using nodeEntry = std::pair<double, int>;   // (distance + bound, node)
+
+// Heuristic: plain Dijkstra order, settled by distance alone.
+struct NoBound
+{
+    static const bool needsFocus = false;
+
+    inline double operator()(const StreetGraph &, int) const { return 0.0; }
+};
+
+// Heuristic: A* order towards a focus point, by boundDistance.
+class FocusBound
+{
+public:
+    static const bool needsFocus = true;
+
+    inline void aim(const GeoCoord &focus)
+    {
+        latitude_    = deg2rad(focus.latitude);
+        longitude_   = deg2rad(focus.longitude);
+        cosLatitude_ = std::cos(latitude_);
+    }
+
+    inline double operator()(const StreetGraph &graph, int node) const
+    {
+        return boundDistance(graph.latitude(node), graph.longitude(node),
+            graph.cosLatitude(node), latitude_, longitude_, cosLatitude_,
+            earthDiameterMiles);
+    }
+
+private:
+    double latitude_    = 0.0;
+    double longitude_   = 0.0;
+    double cosLatitude_ = 1.0;
+};
+
+// Edge cost: miles, as the adjacency read them.
+struct ArcLength
+{
+    static inline double of(const StreetGraph &, int, double length) { return length; }
+};
+
+// Direction: the tree grows from the sources along the arcs leaving each
+// node, and the parent arc of a node is the arc the route arrives by.
+struct Forward
+{
+    static inline int travelled(const StreetGraph &, int arcId) { return arcId; }
+};
+
+// Direction: the tree grows from the destinations against the direction of
+// travel, and the parent arc of a node is the arc the route leaves it by.
+// Streets are two-way, so the arcs into a node are the twins of those out.
+struct Backward
+{
+    static inline int travelled(const StreetGraph &graph, int arcId)
+    {
+        return graph.twinArc(arcId);
+    }
+};
+
+// Direction: Backward over the chains of a CoreChains tree. The chain a
+// route leaves a node by is the chain stepped, run the other way, and so
+// is identified by the twin of its last arc.
+struct BackwardChains
+{
+    static inline int travelled(const StreetGraph &graph, int chainId)
+    {
+        return graph.twinArc(graph.chainLast(chainId));
+    }
+};
+
+// Adjacency: the arcs of the graph itself.
+class FlatArcs
+{
+public:
+    explicit FlatArcs(const StreetGraph &graph) : graph_(graph) {}
+
+    // Calls visit(arcId, head, length) for each arc leaving node.
+    template <class Visit>
+    inline void forEachArc(int node, const Visit &visit) const
+    {
+        for (int a = graph_.firstArc(node); a < graph_.firstArc(node + 1); ++a)
+        {
+            const auto &arc = graph_.arc(a);
+            visit(a, arc.head, arc.length);
+        }
+    }
+
+private:
+    const StreetGraph &graph_;
+};
+
+// Adjacency: the arcs decoded from a CompressedGraph of the same graph, a
+// few bytes each instead of an Arc; lengths are rounded to its quantum.
+class CompressedArcs
+{
+public:
+    explicit CompressedArcs(const CompressedGraph &arcs) : arcs_(arcs) {}
+
+    template <class Visit>
+    inline void forEachArc(int node, const Visit &visit) const
+    {
+        arcs_.forEachArc(node, visit);
+    }
+
+private:
+    const CompressedGraph &arcs_;
+};
+
+// Adjacency: the chains leaving each core node, stepped whole. A tree
+// seeded at core nodes settles core nodes only, a fifth of them or so, and
+// its parent arcs are chain ids, unpacked with StreetGraph::nextChainArc.
+class CoreChains
+{
+public:
+    explicit CoreChains(const StreetGraph &graph) : graph_(graph) {}
+
+    template <class Visit>
+    inline void forEachArc(int node, const Visit &visit) const
+    {
+        for (int c = graph_.firstArc(node); c < graph_.firstArc(node + 1); ++c)
+        {
+            visit(c, graph_.chainHead(c), graph_.chainLength(c));
+        }
+    }
+
+private:
+    const StreetGraph &graph_;
+};
+
+// Open set: std::priority_queue, a binary heap with lazy deletion.
+class BinaryHeap
+{
+public:
+    inline bool empty() const { return entries_.empty(); }
+    inline const nodeEntry &top() const { return entries_.top(); }
+    inline void push(double key, int node) { entries_.emplace(key, node); }
+    inline void pop() { entries_.pop(); }
+    inline void clear() { entries_ = decltype(entries_)(); }
+
+private:
+    std::priority_queue<nodeEntry, std::vector<nodeEntry>,
+                        std::greater<nodeEntry>> entries_;
+};
+
+// Open set: a 4-ary heap with lazy deletion. Half as deep as a binary heap,
+// and the four children of an entry are next to each other in memory.
+class QuaternaryHeap
+{
+public:
+    inline bool empty() const { return entries_.empty(); }
+    inline const nodeEntry &top() const { return entries_.front(); }
+
+    inline void push(double key, int node)
+    {
+        auto hole = entries_.size();
+        entries_.emplace_back();
+        while (hole > 0 and key < entries_[(hole - 1) / 4].first)
+        {
+            entries_[hole] = entries_[(hole - 1) / 4];
+            hole = (hole - 1) / 4;
+        }
+        entries_[hole] = { key, node };
+    }
+
+    inline void pop()
+    {
+        auto last = entries_.back();
+        entries_.pop_back();
+        auto n    = entries_.size();
+        auto hole = size_t(0);
+        while (n > 0)
+        {
+            auto child = 4 * hole + 1;
+            if (child >= n)
+            {
+                break;
+            }
+            auto smallest = child;
+            for (auto c = child + 1; c < child + 4 and c < n; ++c)
+            {
+                if (entries_[c].first < entries_[smallest].first)
+                {
+                    smallest = c;
+                }
+            }
+            if (!(entries_[smallest].first < last.first))
+            {
+                break;
+            }
+            entries_[hole] = entries_[smallest];
+            hole = smallest;
+        }
+        if (n > 0)
+        {
+            entries_[hole] = last;
+        }
+    }
+
+    inline void clear() { entries_.clear(); }
+
+private:
+    std::vector<nodeEntry> entries_;
+};
+
+// Visited set: labels in arrays over all the nodes. Only the labels touched
+// are cleared, so starting over after a small search is cheap.
+class DenseLabels
+{
+public:
+    inline void resize(int nNodes)
+    {
+        distance_.assign(nNodes, std::numeric_limits<double>::max());
+        parentArc_.assign(nNodes, -1);
+        settled_.assign(nNodes, false);
+        wanted_.assign(nNodes, false);
+    }
+
+    inline double distance(int node) const { return distance_[node]; }
+    inline int parentArc(int node) const { return parentArc_[node]; }
+    inline bool isSettled(int node) const { return settled_[node]; }
+    inline bool isWanted(int node) const { return wanted_[node]; }
+
+    inline void label(int node, double distance, int arcId)
+    {
+        if (distance_[node] == std::numeric_limits<double>::max())
+        {
+            touched_.emplace_back(node);
+        }
+        distance_[node]  = distance;
+        parentArc_[node] = arcId;
+        settled_[node]   = false;
+    }
+
+    inline void settle(int node) { settled_[node] = true; }
+    inline void want(int node, bool wanted) { wanted_[node] = wanted; }
+
+    inline void clear()
+    {
+        for (auto node : touched_)
+        {
+            distance_[node]  = std::numeric_limits<double>::max();
+            parentArc_[node] = -1;
+            settled_[node]   = false;
+        }
+        touched_.clear();
+    }
+
+private:
+    std::vector<double> distance_;
+    std::vector<int>    parentArc_;
+    std::vector<bool>   settled_;
+    std::vector<bool>   wanted_;
+    std::vector<int>    touched_;
+};
+
+// Visited set: labels of the nodes reached only, in a hash table. Holds
+// little for a short search on a large map, at the price of a lookup per
+// label read.
+class SparseLabels
+{
+public:
+    inline void resize(int) {}
+
+    inline double distance(int node) const
+    {
+        auto found = labels_.find(node);
+        return found == labels_.end() ? std::numeric_limits<double>::max()
+                                      : found->second.distance;
+    }
+
+    inline int parentArc(int node) const
+    {
+        auto found = labels_.find(node);
+        return found == labels_.end() ? -1 : found->second.parentArc;
+    }
+
+    inline bool isSettled(int node) const
+    {
+        auto found = labels_.find(node);
+        return found != labels_.end() and found->second.settled;
+    }
+
+    inline bool isWanted(int node) const
+    {
+        auto found = labels_.find(node);
+        return found != labels_.end() and found->second.wanted;
+    }
+
+    inline void label(int node, double distance, int arcId)
+    {
+        auto &entry     = labels_[node];
+        entry.distance  = distance;
+        entry.parentArc = arcId;
+        entry.settled   = false;
+    }
+
+    inline void settle(int node) { labels_[node].settled = true; }
+    inline void want(int node, bool wanted) { labels_[node].wanted = wanted; }
+
+    inline void clear() { labels_.clear(); }
+
+private:
+    struct Label
+    {
+        double distance  = std::numeric_limits<double>::max();
+        int    parentArc = -1;
+        bool   settled   = false;
+        bool   wanted    = false;
+    };
+
+    std::unordered_map<int, Label> labels_;
+};
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#include "Provided.h"
+
+static void writeJsonString(const std::string &text, std::ostream &out)
+{
+    out << '"';
+    for (auto c : text)
+    {
+        if (c == '"' or c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+        {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+static void writeJsonPoint(const TracePoint &point, std::ostream &out)
+{
+    char text[64];
+    std::snprintf(text, sizeof(text), "[%.7f,%.7f]", point.longitude, point.latitude);
+    out << text;
+}
+
+static void writeGeoJson(const SearchTrace &trace, std::ostream &out)
+{
+    out << "{\"type\":\"FeatureCollection\",\"features\":[";
+    char numbers[96];
+    for (size_t i = 0; i < size(trace.steps); ++i)
+    {
+        const auto &step = trace.steps[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"LineString\",\"coordinates\":[";
+        writeJsonPoint(step.from, out);
+        out << ',';
+        writeJsonPoint(step.to, out);
+        std::snprintf(numbers, sizeof(numbers), "{\"order\":%zu,\"g\":%.6f,\"f\":%.6f}",
+                      i, step.g, step.f);
+        out << "]},\"properties\":" << numbers << '}';
+    }
+
+    out << (trace.steps.empty() ? "\n" : ",\n");
+    out << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"LineString\",\"coordinates\":[";
+    for (size_t i = 0; i < size(trace.path); ++i)
+    {
+        if (i > 0)
+        {
+            out << ',';
+        }
+        writeJsonPoint(trace.path[i], out);
+    }
+    out << "]},\"properties\":{\"path\":true,\"start\":";
+    writeJsonString(trace.start, out);
+    out << ",\"end\":";
+    writeJsonString(trace.end, out);
+    out << ",\"result\":" << static_cast<int>(trace.result) << "}}\n]}\n";
+}
+
+// Little-endian whatever the host is.
+static void writeUnsigned(std::uint32_t value, int bytes, std::ostream &out)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        out.put(static_cast<char>(value >> (8 * i) & 0xff));
+    }
+}
+
+static void writeFloat(double value, std::ostream &out)
+{
+    auto narrowed = static_cast<float>(value);
+    auto bits     = std::uint32_t();
+    std::memcpy(&bits, &narrowed, sizeof(bits));
+    writeUnsigned(bits, 4, out);
+}
+
+static void writeBinary(const SearchTrace &trace, std::ostream &out)
+{
+    out.write("BNTRACE1", 8);
+    for (const auto *name : { &trace.start, &trace.end })
+    {
+        auto length = std::min<size_t>(size(*name), 0xffff);
+        writeUnsigned(static_cast<std::uint32_t>(length), 2, out);
+        out.write(name->data(), static_cast<std::streamsize>(length));
+    }
+    writeUnsigned(static_cast<std::uint32_t>(trace.result), 1, out);
+    writeUnsigned(static_cast<std::uint32_t>(size(trace.steps)), 4, out);
+    writeUnsigned(static_cast<std::uint32_t>(size(trace.path)), 4, out);
+    for (const auto &step : trace.steps)
+    {
+        writeFloat(step.from.latitude, out);
+        writeFloat(step.from.longitude, out);
+        writeFloat(step.to.latitude, out);
+        writeFloat(step.to.longitude, out);
+        writeFloat(step.g, out);
+        writeFloat(step.f, out);
+    }
+    for (const auto &point : trace.path)
+    {
+        writeFloat(point.latitude, out);
+        writeFloat(point.longitude, out);
+    }
+}
+
+bool writeSearchTrace(const SearchTrace &trace, TraceFormat format, std::ostream &out)
+{
+    if (format == TRACE_GEOJSON)
+    {
+        writeGeoJson(trace, out);
+    }
+    else
+    {
+        writeBinary(trace, out);
+    }
+    out.flush();
+    return static_cast<bool>(out);
+}
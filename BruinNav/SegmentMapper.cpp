@@ -21,6 +21,7 @@ inline void SegmentMapperImpl::
 
 void SegmentMapperImpl::init(const MapLoader &ml)
 {
+    auto scope = MemoryScope(account_);
     auto nStreetSegments = ml.getNumSegments();
     auto toBeInserted = StreetSegment();
     for (int i = 0; i < nStreetSegments; ++i)
@@ -29,15 +30,6 @@ void SegmentMapperImpl::init(const MapLoader &ml)
         {
             insertOrAppend(toBeInserted.segment.start, toBeInserted);
             insertOrAppend(toBeInserted.segment.end, toBeInserted);
-            for (auto attraction : toBeInserted.attractionsOnThisSegment)
-            {
-                if (attraction.location == toBeInserted.segment.start)
-                {
-                    continue;
-                }
-                
-                insertOrAppend(attraction.location, toBeInserted);
-            }
         }
     }
 }
@@ -50,6 +42,24 @@ inline std::vector<StreetSegment> SegmentMapperImpl::
     return segmentsFound == nullptr ? std::vector<StreetSegment>{} : *segmentsFound;
 }
 
+size_t SegmentMapperImpl::getMemoryBytes() const
+{
+    return sizeof(SegmentMapperImpl) + account_.bytes();
+}
+
+size_t SegmentMapperImpl::getStringBytes() const
+{
+    auto bytes = size_t(0);
+    geoCoordMap_.forEach([&](const GeoCoord &gc, const std::vector<StreetSegment> &segments) {
+        bytes += stringBytes(gc);
+        for (const auto &segment : segments)
+        {
+            bytes += stringBytes(segment);
+        }
+    });
+    return bytes;
+}
+
 // SegmentMapper
 SegmentMapper::SegmentMapper()
     : pImpl_(new SegmentMapperImpl) 
@@ -69,4 +79,14 @@ void SegmentMapper::init(const MapLoader &ml)
 std::vector<StreetSegment> SegmentMapper::getSegments(const GeoCoord &gc) const
 {
     return pImpl_->getSegments(gc);
-}
\ No newline at end of file
+}
+
+size_t SegmentMapper::getMemoryBytes() const
+{
+    return pImpl_->getMemoryBytes();
+}
+
+size_t SegmentMapper::getStringBytes() const
+{
+    return pImpl_->getStringBytes();
+}
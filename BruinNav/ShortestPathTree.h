@@ -0,0 +1,335 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "Provided.h"
+#include "SearchPolicies.h"
+#include "StreetGraph.h"
+
+/**
+ *  Node-based shortest path tree over a StreetGraph, the kernel behind the
+ *  auxiliary searches: network distances, trip and tile distance tables,
+ *  nearest attractions, re-route trees, alternatives, tiled and partitioned
+ *  routing. navigate itself does not run on it; see NavigatorImpl::searchArcs.
+ *  The policies (see SearchPolicies.h) are fixed at compile time:
+ *
+ *  Bound     the heuristic: NoBound grows a plain Dijkstra tree, settled by
+ *            distance alone; FocusBound grows it in A* order towards a focus
+ *            point, so growing up to a limit settles exactly the nodes that
+ *            can lie on a path to the focus no longer than the limit, with
+ *            their exact distances from the seeds.
+ *  Direction Forward from the sources or Backward from the destinations
+ *            (BackwardChains when stepping chains).
+ *  Cost      what a step along an arc costs.
+ *  OpenSet   the priority queue of nodes to settle.
+ *  Labels    where distances, parent arcs and settled flags are kept.
+ *  Adjacency where the arcs are read from: FlatArcs from the graph,
+ *            CompressedArcs from a CompressedGraph of it, or CoreChains,
+ *            whole chains between core nodes.
+ *
+ *  Turn penalties are not considered.
+ */
+template <class Bound, class Direction = Forward, class Cost = ArcLength,
+          class OpenSet = QuaternaryHeap, class Labels = DenseLabels,
+          class Adjacency = FlatArcs>
+class SearchTree
+{
+public:
+    SearchTree(const SearchTree &other)          = delete;
+    SearchTree &operator=(const SearchTree &rhs) = delete;
+
+public:
+    explicit SearchTree(const StreetGraph &graph);
+
+    // A tree whose arcs come from arcs, a compressed copy of graph's.
+    SearchTree(const StreetGraph &graph, const CompressedGraph &arcs);
+
+    // Forgets every label; the next seeds start a new tree aimed at focus.
+    void reset(const GeoCoord &focus);
+
+    // Forgets every label; the next seeds start a new tree.
+    void reset();
+
+    // Starts the tree at node, already `distance` miles from its root.
+    void addSeed(int node, double distance);
+
+    /**
+     *  Grows the tree until no node within `limit` of the focus is left.
+     *  @param limit bound on distance plus straight-line distance to the focus.
+     */
+    void grow(double limit);
+
+    /**
+     *  @param within only nodes settled in that tree, by routes through them
+     *                no longer than limit, are reached. A backward tree grown
+     *                within the forward tree to the same limit settles just
+     *                the nodes with distF + distB <= limit.
+     */
+    template <class Tree>
+    void grow(double limit, const Tree &within);
+
+    /**
+     *  Grows the tree until the best way to reach the focus through one of
+     *  the anchors is known.
+     *  @param anchors how the focus attaches to the graph.
+     *  @param best    receives the index of the best anchor, -1 if unreachable.
+     *  @return the distance from the seeds to the focus through anchors[best].
+     */
+    double growToAnchors(const std::vector<Anchor> &anchors, int &best);
+
+    /**
+     *  Grows the tree until every one of nodes is settled, or no node is left.
+     *  Used without a focus, the distances of the nodes settled are exact.
+     *  @param nodes the nodes to reach, duplicates allowed.
+     */
+    void growToCover(const std::vector<int> &nodes);
+
+    /**
+     *  Grows the tree one node at a time for as long as visit, called with
+     *  each node settled, returns true.
+     */
+    template <class Visit>
+    void growWhile(const Visit &visit);
+
+    inline double distance(int node) const { return labels_.distance(node); }
+    inline int parentArc(int node) const { return labels_.parentArc(node); }
+    inline bool isSettled(int node) const { return labels_.isSettled(node); }
+
+    // Settled nodes, in the order they were first settled.
+    inline const std::vector<int> &settledNodes() const { return settledNodes_; }
+
+private:
+    // Settles the next node, reaching only the nodes admit accepts at the
+    // distance reached; false once the tree cannot grow any further.
+    template <class Admit>
+    bool settleNext(double limit, const Admit &admit);
+
+    void relax(int node, double distance, int arcId);
+
+private:
+    const StreetGraph  &graph_;
+    Adjacency           adjacency_;
+    Bound               bound_;
+    Labels              labels_;
+    OpenSet             open_;
+    std::vector<int>    settledNodes_;
+};
+
+// The trees the navigator runs. Plain trees need no focus, A* trees one.
+using DijkstraTree             = SearchTree<NoBound>;
+using ShortestPathTree         = SearchTree<FocusBound>;
+using BackwardShortestPathTree = SearchTree<FocusBound, Backward>;
+using BackwardDijkstraTree     = SearchTree<NoBound, Backward>;
+
+// Trees stepping chains, A* forward and plain backward; they must be seeded
+// at core nodes.
+using ChainTree         = SearchTree<FocusBound, Forward, ArcLength, QuaternaryHeap,
+                                     DenseLabels, CoreChains>;
+using BackwardChainTree = SearchTree<NoBound, BackwardChains, ArcLength, QuaternaryHeap,
+                                     DenseLabels, CoreChains>;
+
+// Admits every node.
+struct AnyNode
+{
+    inline bool operator()(int, double) const { return true; }
+};
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::SearchTree(
+    const StreetGraph &graph)
+    : graph_(graph), adjacency_(graph)
+{
+    labels_.resize(graph.nodeCount());
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::SearchTree(
+    const StreetGraph &graph, const CompressedGraph &arcs)
+    : graph_(graph), adjacency_(arcs)
+{
+    labels_.resize(graph.nodeCount());
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::reset(const GeoCoord &focus)
+{
+    static_assert(Bound::needsFocus, "this tree has no focus; use reset()");
+    labels_.clear();
+    settledNodes_.clear();
+    open_.clear();
+    bound_.aim(focus);
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::reset()
+{
+    static_assert(!Bound::needsFocus, "this tree needs a focus; use reset(focus)");
+    labels_.clear();
+    settledNodes_.clear();
+    open_.clear();
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::addSeed(int node,
+                                                                             double distance)
+{
+    relax(node, distance, -1);
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::grow(double limit)
+{
+    while (settleNext(limit, AnyNode()))
+    {
+    }
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+template <class Tree>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::grow(double limit,
+                                                                          const Tree &within)
+{
+    auto admit = [&within, limit](int node, double distance) {
+        return within.isSettled(node) and within.distance(node) + distance <= limit;
+    };
+    while (settleNext(limit, admit))
+    {
+    }
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+double SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::growToAnchors(
+    const std::vector<Anchor> &anchors, int &best)
+{
+    auto bestDistance = std::numeric_limits<double>::max();
+    best = -1;
+    for (size_t i = 0; i < size(anchors); ++i)
+    {
+        const auto &anchor = anchors[i];
+        if (labels_.isSettled(anchor.node) and
+            labels_.distance(anchor.node) + anchor.distance < bestDistance)
+        {
+            bestDistance = labels_.distance(anchor.node) + anchor.distance;
+            best = static_cast<int>(i);
+        }
+    }
+
+    while (settleNext(bestDistance, AnyNode()))
+    {
+        auto node = settledNodes_.back();
+        for (size_t i = 0; i < size(anchors); ++i)
+        {
+            const auto &anchor = anchors[i];
+            if (anchor.node == node and labels_.distance(node) + anchor.distance < bestDistance)
+            {
+                bestDistance = labels_.distance(node) + anchor.distance;
+                best = static_cast<int>(i);
+            }
+        }
+    }
+    return bestDistance;
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::growToCover(
+    const std::vector<int> &nodes)
+{
+    auto remaining = 0;
+    for (auto node : nodes)
+    {
+        if (!labels_.isWanted(node) and !labels_.isSettled(node))
+        {
+            labels_.want(node, true);
+            ++remaining;
+        }
+    }
+
+    while (remaining > 0 and settleNext(std::numeric_limits<double>::max(), AnyNode()))
+    {
+        auto node = settledNodes_.back();
+        if (labels_.isWanted(node))
+        {
+            labels_.want(node, false);
+            --remaining;
+        }
+    }
+
+    for (auto node : nodes)
+    {
+        labels_.want(node, false);
+    }
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+template <class Visit>
+void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::growWhile(const Visit &visit)
+{
+    while (settleNext(std::numeric_limits<double>::max(), AnyNode()) and
+           visit(settledNodes_.back()))
+    {
+    }
+}
+
+// A node improved after it was settled (the bound is a hair below the
+// haversine distance) is reopened, and listed again when settled again.
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+template <class Admit>
+bool SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::settleNext(
+    double limit, const Admit &admit)
+{
+    while (!open_.empty())
+    {
+        auto current = open_.top();
+        if (current.first > limit)
+        {
+            return false;
+        }
+        open_.pop();
+
+        auto node = current.second;
+        if (labels_.isSettled(node))
+        {
+            continue;
+        }
+        labels_.settle(node);
+        settledNodes_.emplace_back(node);
+
+        auto distance = labels_.distance(node);
+        // Streets are two-way, so an arc and its twin are as long.
+        adjacency_.forEachArc(node, [&](int a, int head, double length) {
+            auto travelled = Direction::travelled(graph_, a);
+            auto reached   = distance + Cost::of(graph_, travelled, length);
+            if (admit(head, reached))
+            {
+                relax(head, reached, travelled);
+            }
+        });
+        return true;
+    }
+    return false;
+}
+
+template <class Bound, class Direction, class Cost, class OpenSet, class Labels,
+          class Adjacency>
+inline void SearchTree<Bound, Direction, Cost, OpenSet, Labels, Adjacency>::relax(
+    int node, double distance, int arcId)
+{
+    if (distance >= labels_.distance(node))
+    {
+        return;
+    }
+    labels_.label(node, distance, arcId);
+    open_.push(distance + bound_(graph_, node), node);
+}
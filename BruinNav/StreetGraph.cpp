@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MyMap.h"
+#include "Provided.h"
+#include "StreetGraph.h"
+#include "Support.h"
+
+// Anything within this many degrees of going straight on is not a turn,
+// anything within this many degrees of going back is a U-turn.
+const double straightTolerance = 30.0;
+const double uTurnTolerance    = 20.0;
+
+TurnClass classifyTurn(double inHeading, double outHeading)
+{
+    auto angle = angleBetweenHeadings(inHeading, outHeading);
+
+    if (angle <= straightTolerance or angle >= 360.0 - straightTolerance)
+    {
+        return TURN_STRAIGHT;
+    }
+    if (std::fabs(angle - 180.0) <= uTurnTolerance)
+    {
+        return TURN_UTURN;
+    }
+    return angle < 180.0 ? TURN_LEFT : TURN_RIGHT;
+}
+
+// Side of the grid nodes are snapped to before taking their Hilbert index.
+const unsigned hilbertGridSize = 1u << 16;
+
+unsigned long long hilbertIndex(unsigned x, unsigned y)
+{
+    auto index = 0ull;
+    for (auto s = hilbertGridSize / 2; s > 0; s /= 2)
+    {
+        auto rx = (x & s) > 0 ? 1u : 0u;
+        auto ry = (y & s) > 0 ? 1u : 0u;
+        index += static_cast<unsigned long long>(s) * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve inside it starts where it enters.
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = hilbertGridSize - 1 - x;
+                y = hilbertGridSize - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+StreetGraph::StreetGraph(const MapLoader &ml, NodeOrder order)
+{
+    auto scope     = MemoryScope(account_);
+    auto nameIndex = MyMap<std::string, int>{};
+    auto nSegments = ml.getNumSegments();
+    auto street    = StreetSegment();
+    auto attractionLocations = std::vector<GeoCoord>{};
+
+    segments_.reserve(nSegments);
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        if (!ml.getSegment(i, street))
+        {
+            continue;
+        }
+
+        auto nameId = nameIndex.find(street.streetName);
+        if (nameId == nullptr)
+        {
+            nameIndex.associate(street.streetName, size(streetNames_));
+            streetNames_.emplace_back(street.streetName);
+            nameId = nameIndex.find(street.streetName);
+        }
+
+        auto segId = static_cast<int>(size(segments_));
+        auto toBeInserted       = GraphSegment();
+        toBeInserted.start      = nodeFor(street.segment.start);
+        toBeInserted.end        = nodeFor(street.segment.end);
+        toBeInserted.streetName = *nameId;
+        toBeInserted.length     = distanceEarthMiles(street);
+        segments_.emplace_back(toBeInserted);
+
+        for (const auto &address : street.attractionsOnThisSegment)
+        {
+            attractionLocations.emplace_back(address.location);
+            auto segIds = attractionIndex_.find(address.location);
+            if (segIds == nullptr)
+            {
+                attractionIndex_.associate(address.location, std::vector<int>{segId});
+            }
+            else
+            {
+                segIds->emplace_back(segId);
+            }
+        }
+    }
+
+    originalNode_.resize(nodeCount());
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        originalNode_[v] = v;
+    }
+    if (order == HILBERT_ORDER)
+    {
+        renumberNodes();
+    }
+
+    buildArcs();
+    buildPositions();
+    buildTurns();
+    buildChains(attractionLocations);
+    buildComponents();
+}
+
+int StreetGraph::findNode(const GeoCoord &gc) const
+{
+    auto node = nodeIndex_.find(gc);
+    return node == nullptr ? -1 : *node;
+}
+
+const std::vector<int> *StreetGraph::attractionSegments(const GeoCoord &gc) const
+{
+    return attractionIndex_.find(gc);
+}
+
+void StreetGraph::anchorsOf(const GeoCoord &gc, std::vector<Anchor> &anchors) const
+{
+    anchors.clear();
+    auto node = findNode(gc);
+    if (node != -1)
+    {
+        anchors.push_back({ node, 0.0, -1 });
+        return;
+    }
+
+    auto segIds = attractionSegments(gc);
+    if (segIds == nullptr)
+    {
+        return;
+    }
+    for (auto segId : *segIds)
+    {
+        const auto &seg = segments_[segId];
+        anchors.push_back({ seg.start, distanceEarthMiles(gc, coords_[seg.start]), segId });
+        anchors.push_back({ seg.end,   distanceEarthMiles(gc, coords_[seg.end]),   segId });
+    }
+}
+
+int StreetGraph::componentOf(const GeoCoord &gc) const
+{
+    auto node = findNode(gc);
+    if (node != -1)
+    {
+        return component_[node];
+    }
+
+    // The segments listing an attraction need not meet there, as where a
+    // street crosses a bridge, so this is the component of the first one.
+    auto segIds = attractionSegments(gc);
+    return segIds == nullptr ? -1 : component_[segments_[segIds->front()].start];
+}
+
+bool StreetGraph::mayConnect(const GeoCoord &gc1, const GeoCoord &gc2) const
+{
+    auto node1   = findNode(gc1);
+    auto node2   = findNode(gc2);
+    auto segIds1 = node1 == -1 ? attractionSegments(gc1) : nullptr;
+    auto segIds2 = node2 == -1 ? attractionSegments(gc2) : nullptr;
+    auto count   = [](int node, const std::vector<int> *segIds) {
+        return node != -1 ? size_t(1) : segIds != nullptr ? size(*segIds) : size_t(0);
+    };
+    auto componentAt = [&](int node, const std::vector<int> *segIds, size_t i) {
+        return node != -1 ? component_[node] : component_[segments_[(*segIds)[i]].start];
+    };
+    for (size_t i = 0; i < count(node1, segIds1); ++i)
+    {
+        for (size_t j = 0; j < count(node2, segIds2); ++j)
+        {
+            if (componentAt(node1, segIds1, i) == componentAt(node2, segIds2, j))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t StreetGraph::stringMemoryBytes() const
+{
+    auto bytes = size_t(0);
+    for (const auto &name : streetNames_)
+    {
+        bytes += stringBytes(name);
+    }
+    for (const auto &gc : coords_)
+    {
+        bytes += stringBytes(gc);
+    }
+    nodeIndex_.forEach([&](const GeoCoord &gc, int) { bytes += stringBytes(gc); });
+    attractionIndex_.forEach([&](const GeoCoord &gc, const std::vector<int> &) {
+        bytes += stringBytes(gc);
+    });
+    return bytes;
+}
+
+size_t StreetGraph::countedBytes() const
+{
+    auto bytes = stringMemoryBytes() +
+        vectorBytes(coords_) + vectorBytes(segments_) + vectorBytes(streetNames_) +
+        vectorBytes(originalNode_) + vectorBytes(firstArc_) + vectorBytes(arcs_) +
+        vectorBytes(segmentArcs_) + vectorBytes(latitude_) + vectorBytes(longitude_) +
+        vectorBytes(cosLatitude_) + vectorBytes(headLatitude_) + vectorBytes(headLongitude_) +
+        vectorBytes(headCosLatitude_) + vectorBytes(firstTurn_) + vectorBytes(turns_) +
+        vectorBytes(core_) + vectorBytes(chainHead_) + vectorBytes(chainLast_) +
+        vectorBytes(chainLength_) + vectorBytes(chainTurns_) + vectorBytes(chainHeadLatitude_) +
+        vectorBytes(chainHeadLongitude_) + vectorBytes(chainHeadCosLatitude_) +
+        vectorBytes(component_) + vectorBytes(componentSize_) +
+        nodeIndex_.nodeBytes() + attractionIndex_.nodeBytes();
+    attractionIndex_.forEach([&](const GeoCoord &, const std::vector<int> &segIds) {
+        bytes += vectorBytes(segIds);
+    });
+    return bytes;
+}
+
+int StreetGraph::nodeFor(const GeoCoord &gc)
+{
+    auto node = nodeIndex_.find(gc);
+    if (node != nullptr)
+    {
+        return *node;
+    }
+
+    auto newNode = static_cast<int>(size(coords_));
+    nodeIndex_.associate(gc, newNode);
+    coords_.emplace_back(gc);
+    return newNode;
+}
+
+// Sorts the nodes by the Hilbert index of their cell in the bounding box
+// of the map, and renames them in every structure built so far.
+void StreetGraph::renumberNodes()
+{
+    if (coords_.empty())
+    {
+        return;
+    }
+
+    auto minLatitude  = coords_[0].latitude;
+    auto maxLatitude  = coords_[0].latitude;
+    auto minLongitude = coords_[0].longitude;
+    auto maxLongitude = coords_[0].longitude;
+    for (const auto &gc : coords_)
+    {
+        minLatitude  = std::min(minLatitude, gc.latitude);
+        maxLatitude  = std::max(maxLatitude, gc.latitude);
+        minLongitude = std::min(minLongitude, gc.longitude);
+        maxLongitude = std::max(maxLongitude, gc.longitude);
+    }
+    auto toCell = [](double value, double low, double high) {
+        auto span = high > low ? high - low : 1.0;
+        auto cell = (value - low) / span * (hilbertGridSize - 1);
+        return static_cast<unsigned>(cell);
+    };
+
+    auto keys = std::vector<std::pair<unsigned long long, int>>(nodeCount());
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        keys[v] = { hilbertIndex(toCell(coords_[v].longitude, minLongitude, maxLongitude),
+                                 toCell(coords_[v].latitude, minLatitude, maxLatitude)), v };
+    }
+    std::sort(begin(keys), end(keys));
+
+    auto newNode   = std::vector<int>(nodeCount());
+    auto oldCoords = std::move(coords_);
+    coords_.resize(size(oldCoords));
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        auto old = keys[v].second;
+        newNode[old]     = v;
+        originalNode_[v] = old;
+        coords_[v]       = oldCoords[old];
+        nodeIndex_.associate(coords_[v], v);
+    }
+    for (auto &seg : segments_)
+    {
+        seg.start = newNode[seg.start];
+        seg.end   = newNode[seg.end];
+    }
+}
+
+// Counting sort of both directions of every segment by tail node.
+void StreetGraph::buildArcs()
+{
+    auto nNodes = nodeCount();
+    firstArc_.assign(nNodes + 1, 0);
+    for (const auto &seg : segments_)
+    {
+        ++firstArc_[seg.start + 1];
+        ++firstArc_[seg.end + 1];
+    }
+    for (int v = 0; v < nNodes; ++v)
+    {
+        firstArc_[v + 1] += firstArc_[v];
+    }
+
+    auto nextSlot = std::vector<int>(begin(firstArc_), end(firstArc_) - 1);
+    arcs_.resize(2 * size(segments_));
+    segmentArcs_.resize(2 * size(segments_));
+    for (int segId = 0; segId < segmentCount(); ++segId)
+    {
+        const auto &seg = segments_[segId];
+
+        auto forward  = nextSlot[seg.start]++;
+        arcs_[forward]  = Arc{ seg.start, seg.end, segId, seg.length,
+                               headingOf(coords_[seg.start], coords_[seg.end]) };
+        segmentArcs_[2 * segId] = forward;
+
+        auto backward = nextSlot[seg.end]++;
+        arcs_[backward] = Arc{ seg.end, seg.start, segId, seg.length,
+                               headingOf(coords_[seg.end], coords_[seg.start]) };
+        segmentArcs_[2 * segId + 1] = backward;
+    }
+}
+
+void StreetGraph::buildPositions()
+{
+    latitude_.resize(nodeCount());
+    longitude_.resize(nodeCount());
+    cosLatitude_.resize(nodeCount());
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        latitude_[v]    = deg2rad(coords_[v].latitude);
+        longitude_[v]   = deg2rad(coords_[v].longitude);
+        cosLatitude_[v] = std::cos(latitude_[v]);
+    }
+
+    headLatitude_.resize(arcCount());
+    headLongitude_.resize(arcCount());
+    headCosLatitude_.resize(arcCount());
+    for (int a = 0; a < arcCount(); ++a)
+    {
+        headLatitude_[a]    = latitude_[arcs_[a].head];
+        headLongitude_[a]   = longitude_[arcs_[a].head];
+        headCosLatitude_[a] = cosLatitude_[arcs_[a].head];
+    }
+}
+
+void StreetGraph::buildTurns()
+{
+    firstTurn_.resize(arcCount() + 1);
+    firstTurn_[0] = 0;
+    for (int a = 0; a < arcCount(); ++a)
+    {
+        auto head = arcs_[a].head;
+        firstTurn_[a + 1] = firstTurn_[a] + firstArc_[head + 1] - firstArc_[head];
+    }
+
+    turns_.resize(firstTurn_[arcCount()]);
+    for (int in = 0; in < arcCount(); ++in)
+    {
+        const auto &inArc = arcs_[in];
+        auto inName = segments_[inArc.segment].streetName;
+
+        for (int out = firstArc_[inArc.head]; out < firstArc_[inArc.head + 1]; ++out)
+        {
+            const auto &outArc = arcs_[out];
+            auto entry = static_cast<unsigned char>(TURN_UTURN);
+            if (outArc.segment != inArc.segment or outArc.head != inArc.tail)
+            {
+                entry = classifyTurn(inArc.heading, outArc.heading);
+            }
+            if (segments_[outArc.segment].streetName != inName)
+            {
+                entry |= TURN_NAME_CHANGE;
+            }
+            turns_[firstTurn_[in] + out - firstArc_[inArc.head]] = entry;
+        }
+    }
+}
+
+// A node is core unless exactly two arcs leave it, or if an attraction
+// attaches there, so that any query can start and end on core nodes.
+// Loops of non-core nodes get one of their nodes made core.
+void StreetGraph::buildChains(const std::vector<GeoCoord> &attractionLocations)
+{
+    core_.assign(nodeCount(), false);
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        core_[v] = firstArc_[v + 1] - firstArc_[v] != 2;
+    }
+    for (const auto &seg : segments_)
+    {
+        if (seg.start == seg.end)
+        {
+            core_[seg.start] = true;
+        }
+    }
+    for (const auto &gc : attractionLocations)
+    {
+        auto node = findNode(gc);
+        if (node != -1)
+        {
+            core_[node] = true;
+        }
+        for (auto segId : *attractionSegments(gc))
+        {
+            core_[segments_[segId].start] = true;
+            core_[segments_[segId].end]   = true;
+        }
+    }
+
+    chainHead_.assign(arcCount(), -1);
+    chainLast_.assign(arcCount(), -1);
+    chainLength_.assign(arcCount(), 0.0);
+    chainTurns_.assign(arcCount(), {});
+    chainHeadLatitude_.assign(arcCount(), 0.0);
+    chainHeadLongitude_.assign(arcCount(), 0.0);
+    chainHeadCosLatitude_.assign(arcCount(), 0.0);
+
+    auto onChain = std::vector<bool>(nodeCount(), false);
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        for (int a = firstArc_[v]; core_[v] and a < firstArc_[v + 1]; ++a)
+        {
+            walkChain(a, onChain);
+        }
+    }
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        if (!core_[v] and !onChain[v])
+        {
+            core_[v] = true;
+            walkChain(firstArc_[v], onChain);
+            walkChain(firstArc_[v] + 1, onChain);
+        }
+    }
+
+    nCoreNodes_ = 0;
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        nCoreNodes_ += core_[v] ? 1 : 0;
+    }
+}
+
+void StreetGraph::walkChain(int chainId, std::vector<bool> &onChain)
+{
+    auto &turns  = chainTurns_[chainId];
+    auto last    = chainId;
+    auto length  = arcs_[chainId].length;
+    while (!core_[arcs_[last].head])
+    {
+        onChain[arcs_[last].head] = true;
+        auto next = nextChainArc(last);
+        ++turns[turn(last, next)];
+        length += arcs_[next].length;
+        last = next;
+    }
+
+    auto head = arcs_[last].head;
+    chainHead_[chainId]            = head;
+    chainLast_[chainId]            = last;
+    chainLength_[chainId]          = length;
+    chainHeadLatitude_[chainId]    = latitude_[head];
+    chainHeadLongitude_[chainId]   = longitude_[head];
+    chainHeadCosLatitude_[chainId] = cosLatitude_[head];
+}
+
+// Union-find over the segments, then components are renamed by size.
+void StreetGraph::buildComponents()
+{
+    auto parent = std::vector<int>(nodeCount());
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        parent[v] = v;
+    }
+    auto findRoot = [&](int v) {
+        while (parent[v] != v)
+        {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+    for (const auto &seg : segments_)
+    {
+        auto root1 = findRoot(seg.start);
+        auto root2 = findRoot(seg.end);
+        if (root1 != root2)
+        {
+            parent[std::max(root1, root2)] = std::min(root1, root2);
+        }
+    }
+
+    auto rootSize = std::vector<int>(nodeCount(), 0);
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        ++rootSize[findRoot(v)];
+    }
+    auto roots = std::vector<std::pair<int, int>>{};     // (-size, root)
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        if (rootSize[v] > 0)
+        {
+            roots.emplace_back(-rootSize[v], v);
+        }
+    }
+    std::sort(begin(roots), end(roots));
+
+    auto rootComponent = std::vector<int>(nodeCount(), -1);
+    componentSize_.resize(size(roots));
+    for (int c = 0; c < componentCount(); ++c)
+    {
+        rootComponent[roots[c].second] = c;
+        componentSize_[c] = -roots[c].first;
+    }
+    component_.resize(nodeCount());
+    for (int v = 0; v < nodeCount(); ++v)
+    {
+        component_[v] = rootComponent[findRoot(v)];
+    }
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "MyMap.h"
+#include "Provided.h"
+
+// Manoeuvre performed when leaving one arc for the next one.
+// Classified once at load time from angleBetween2Lines.
+enum TurnClass : unsigned char
+{
+    TURN_STRAIGHT = 0,
+    TURN_LEFT     = 1,
+    TURN_RIGHT    = 2,
+    TURN_UTURN    = 3
+};
+
+// Or'ed into a turn entry when the two arcs belong to differently named streets.
+const unsigned char TURN_NAME_CHANGE = 0x4;
+
+// Number of distinct turn entries (TurnClass x TURN_NAME_CHANGE).
+const int N_TURN_ENTRIES = 8;
+
+// One direction of travel along a StreetSegment.
+struct Arc
+{
+    int    tail;
+    int    head;
+    int    segment;     // index of the segment this arc travels along.
+    double length;      // miles.
+    double heading;     // radians, see headingOf.
+};
+
+// Where a location attaches to the graph.
+struct Anchor
+{
+    int    node;
+    double distance;    // miles from the location to node.
+    int    segment;     // segment the location lies on, -1 if it is node itself.
+};
+
+// How StreetGraph numbers its nodes.
+enum NodeOrder
+{
+    FILE_ORDER,         // in order of first appearance in the map data.
+    HILBERT_ORDER       // along a Hilbert curve over the map's bounding box.
+};
+
+struct GraphSegment
+{
+    int    start;
+    int    end;
+    int    streetName;  // index into the street name table.
+    double length;      // miles.
+};
+
+/**
+ *  Indexed, read-only view of the street network, built once per map load.
+ *  Nodes are the unique segment endpoints and every StreetSegment contributes
+ *  one arc in each direction. The arcs leaving node v are stored contiguously
+ *  in [firstArc(v), firstArc(v + 1)).
+ *
+ *  Lengths and headings of arcs, and the turn entries from every arc towards
+ *  each arc leaving its head, are computed here once, so searches never
+ *  evaluate trigonometry. Node positions are also kept in radians with their
+ *  cos(latitude), and copied per arc in head order for the boundDistances
+ *  kernel.
+ *
+ *  By default nodes are numbered along a Hilbert curve, so nodes close on the
+ *  map are close in every per-node and per-arc array and a search front
+ *  touches few cache lines. originalNode maps back to the file order.
+ *
+ *  Streets are split into many short segments, so most nodes only join two
+ *  of them. Core nodes are the others, plus every location an attraction
+ *  attaches at; a chain is the run of arcs from a core node through
+ *  non-core nodes to the next core node. Each arc leaving a core node starts
+ *  exactly one chain, which is identified by that arc, so the chains leaving
+ *  core node v are [firstArc(v), firstArc(v + 1)) as well. Searches may step
+ *  from chain to chain and unpack the arcs with nextChainArc afterwards.
+ *
+ *  Nodes are also labelled with their connected component, numbered from the
+ *  largest, so a query between components can be answered without a search.
+ */
+class StreetGraph
+{
+public:
+    StreetGraph(const StreetGraph &other)          = delete;
+    StreetGraph &operator=(const StreetGraph &rhs) = delete;
+
+public:
+    explicit StreetGraph(const MapLoader &ml, NodeOrder order = HILBERT_ORDER);
+
+    inline int nodeCount() const { return static_cast<int>(size(coords_)); }
+    inline int arcCount() const { return static_cast<int>(size(arcs_)); }
+    inline int segmentCount() const { return static_cast<int>(size(segments_)); }
+
+    inline const GeoCoord &coord(int node) const { return coords_[node]; }
+    inline const Arc &arc(int arcId) const { return arcs_[arcId]; }
+    inline const GraphSegment &segment(int segId) const { return segments_[segId]; }
+    inline const std::string &streetName(int nameId) const { return streetNames_[nameId]; }
+
+    inline int firstArc(int node) const { return firstArc_[node]; }
+
+    inline bool isCore(int node) const { return core_[node]; }
+    inline int coreNodeCount() const { return nCoreNodes_; }
+
+    // Chain starting with arc chainId, whose tail must be a core node.
+    inline int chainHead(int chainId) const { return chainHead_[chainId]; }
+    inline int chainLast(int chainId) const { return chainLast_[chainId]; }
+    inline double chainLength(int chainId) const { return chainLength_[chainId]; }
+
+    // Number of turns of each entry made inside the chain, by turn entry.
+    inline const std::array<unsigned short, N_TURN_ENTRIES> &chainTurns(int chainId) const
+    {
+        return chainTurns_[chainId];
+    }
+
+    // Positions of the heads of chains [chainId, ...), laid out for boundDistances.
+    inline const double *chainHeadLatitudes(int chainId) const
+    {
+        return chainHeadLatitude_.data() + chainId;
+    }
+    inline const double *chainHeadLongitudes(int chainId) const
+    {
+        return chainHeadLongitude_.data() + chainId;
+    }
+    inline const double *chainHeadCosLatitudes(int chainId) const
+    {
+        return chainHeadCosLatitude_.data() + chainId;
+    }
+
+    // The arc following arcId on its chain; the head of arcId must not be core.
+    inline int nextChainArc(int arcId) const
+    {
+        auto out = firstArc_[arcs_[arcId].head];
+        return out == twinArc(arcId) ? out + 1 : out;
+    }
+
+    // Connected components, numbered by decreasing number of nodes.
+    inline int component(int node) const { return component_[node]; }
+    inline int componentCount() const { return static_cast<int>(size(componentSize_)); }
+    inline int componentSize(int componentId) const { return componentSize_[componentId]; }
+
+    // The number node would have had in FILE_ORDER.
+    inline int originalNode(int node) const { return originalNode_[node]; }
+
+    // Node position in radians, and cos of its latitude.
+    inline double latitude(int node) const { return latitude_[node]; }
+    inline double longitude(int node) const { return longitude_[node]; }
+    inline double cosLatitude(int node) const { return cosLatitude_[node]; }
+
+    // Positions of the heads of arcs [arcId, ...), laid out for boundDistances.
+    inline const double *headLatitudes(int arcId) const { return headLatitude_.data() + arcId; }
+    inline const double *headLongitudes(int arcId) const { return headLongitude_.data() + arcId; }
+    inline const double *headCosLatitudes(int arcId) const { return headCosLatitude_.data() + arcId; }
+
+    // Arc travelling segment segId from its start to its end (forward)
+    // or from its end to its start.
+    inline int segmentArc(int segId, bool forward) const
+    {
+        return segmentArcs_[2 * segId + (forward ? 0 : 1)];
+    }
+
+    // The arc travelling the same segment the other way.
+    inline int twinArc(int arcId) const
+    {
+        auto segId = arcs_[arcId].segment;
+        return segmentArcs_[2 * segId] == arcId ? segmentArcs_[2 * segId + 1]
+                                                : segmentArcs_[2 * segId];
+    }
+
+    // Turn entry (TurnClass, possibly with TURN_NAME_CHANGE) for leaving
+    // arc `in` through arc `out`. `out` must leave the head of `in`.
+    inline unsigned char turn(int in, int out) const
+    {
+        return turns_[firstTurn_[in] + out - firstArc_[arcs_[in].head]];
+    }
+
+    /**
+     *  @param gc a location.
+     *  @return the node at gc, or -1 if gc is not a segment endpoint.
+     */
+    int findNode(const GeoCoord &gc) const;
+
+    /**
+     *  @param gc the location of an attraction.
+     *  @return the segments listing an attraction at gc, or nullptr if none.
+     */
+    const std::vector<int> *attractionSegments(const GeoCoord &gc) const;
+
+    /**
+     *  @param gc      a location.
+     *  @param anchors receives the node at gc or, for an attraction in the
+     *                 middle of segments, both ends of each of them.
+     *                 Empty if gc is not on the map.
+     */
+    void anchorsOf(const GeoCoord &gc, std::vector<Anchor> &anchors) const;
+
+    /**
+     *  @param gc a location.
+     *  @return the component of the node at gc or of the first segment of
+     *          the attraction at gc, or -1 if gc is not on the map.
+     */
+    int componentOf(const GeoCoord &gc) const;
+
+    /**
+     *  @return true if the node or some segment of the attraction at gc1 is
+     *          in the component of the node or some segment at gc2, so that
+     *          a route may join them; false if either is not on the map.
+     */
+    bool mayConnect(const GeoCoord &gc1, const GeoCoord &gc2) const;
+
+    // Heap bytes held by the graph, counted as they were allocated.
+    inline size_t memoryBytes() const { return account_.bytes(); }
+
+    // The part of memoryBytes in string buffers.
+    size_t stringMemoryBytes() const;
+
+    // Heap bytes held by the graph, added up from the sizes of its
+    // containers, so known without the allocation hooks; a little below
+    // memoryBytes, which also sees the slack of the allocator.
+    size_t countedBytes() const;
+
+private:
+    int  nodeFor(const GeoCoord &gc);
+
+    void renumberNodes();
+
+    void buildArcs();
+
+    void buildPositions();
+
+    void buildTurns();
+
+    void buildChains(const std::vector<GeoCoord> &attractionLocations);
+
+    void walkChain(int chainId, std::vector<bool> &onChain);
+
+    void buildComponents();
+
+private:
+    MemoryAccount                       account_;   // first, so it is opened first.
+    std::vector<GeoCoord>               coords_;
+    std::vector<GraphSegment>           segments_;
+    std::vector<std::string>            streetNames_;
+    std::vector<int>                    originalNode_;
+    std::vector<int>                    firstArc_;
+    std::vector<Arc>                    arcs_;
+    std::vector<int>                    segmentArcs_;
+    std::vector<double>                 latitude_;
+    std::vector<double>                 longitude_;
+    std::vector<double>                 cosLatitude_;
+    std::vector<double>                 headLatitude_;
+    std::vector<double>                 headLongitude_;
+    std::vector<double>                 headCosLatitude_;
+    std::vector<int>                    firstTurn_;
+    std::vector<unsigned char>          turns_;
+    std::vector<bool>                   core_;
+    int                                 nCoreNodes_ = 0;
+    std::vector<int>                    chainHead_;
+    std::vector<int>                    chainLast_;
+    std::vector<double>                 chainLength_;
+    std::vector<std::array<unsigned short, N_TURN_ENTRIES>> chainTurns_;
+    std::vector<double>                 chainHeadLatitude_;
+    std::vector<double>                 chainHeadLongitude_;
+    std::vector<double>                 chainHeadCosLatitude_;
+    std::vector<int>                    component_;
+    std::vector<int>                    componentSize_;
+    MyMap<GeoCoord, int>                nodeIndex_;
+    MyMap<GeoCoord, std::vector<int>>   attractionIndex_;
+};
+
+/**
+ *  @param inHeading  heading of the line travelled before the turn.
+ *  @param outHeading heading of the line travelled after the turn.
+ *  @return the TurnClass of going from one to the other, by angleBetweenHeadings.
+ */
+TurnClass classifyTurn(double inHeading, double outHeading);
+
+/**
+ *  @param x, y a cell of a 2^16 by 2^16 grid.
+ *  @return the position of the cell along the Hilbert curve through the grid.
+ */
+unsigned long long hilbertIndex(unsigned x, unsigned y);
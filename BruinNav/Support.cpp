@@ -50,26 +50,73 @@ void extractAttraction(const std::string &attractionInfo, Address &attraction)
 }
 
 
-std::string getTravelDirection(const GeoSegment &gs)
+double headingOf(const GeoCoord &from, const GeoCoord &to)
+{
+    return atan2(to.latitude - from.latitude, to.longitude - from.longitude);
+}
+
+double angleOfHeading(double heading)
+{
+    double result = heading * 180 / 3.14;
+    if (result < 0)
+    {
+        result += 360;
+    }
+    return result;
+}
+
+double angleBetweenHeadings(double heading1, double heading2)
+{
+    double result = (heading2 - heading1) * 180 / 3.14;
+    if (result < 0)
+    {
+        result += 360;
+    }
+    return result;
+}
+
+CompactNavSegment::TRAVEL_DIRECTION getTravelDirectionId(double heading)
 {
-    auto travelAngle = angleOfLine(gs);
+    auto travelAngle = angleOfHeading(heading);
 
     auto direction =
-        travelAngle <= 22.5  ? "east"      :
-        travelAngle <= 67.5  ? "northeast" :
-        travelAngle <= 112.5 ? "north"     :
-        travelAngle <= 157.5 ? "northwest" :
-        travelAngle <= 202.5 ? "west"      :
-        travelAngle <= 247.5 ? "southwest" :
-        travelAngle <= 292.5 ? "south"     :
-        travelAngle <= 337.5 ? "southeast" : "east";
+        travelAngle <= 22.5  ? CompactNavSegment::east      :
+        travelAngle <= 67.5  ? CompactNavSegment::northeast :
+        travelAngle <= 112.5 ? CompactNavSegment::north     :
+        travelAngle <= 157.5 ? CompactNavSegment::northwest :
+        travelAngle <= 202.5 ? CompactNavSegment::west      :
+        travelAngle <= 247.5 ? CompactNavSegment::southwest :
+        travelAngle <= 292.5 ? CompactNavSegment::south     :
+        travelAngle <= 337.5 ? CompactNavSegment::southeast : CompactNavSegment::east;
 
     return direction;
 }
 
+CompactNavSegment::TRAVEL_DIRECTION getTravelDirectionId(const GeoSegment &gs)
+{
+    return getTravelDirectionId(headingOf(gs.start, gs.end));
+}
+
+CompactNavSegment::TURN_DIRECTION getTurnDirectionId(double heading1, double heading2)
+{
+    return angleBetweenHeadings(heading1, heading2) < 180.0 ? CompactNavSegment::left
+                                                            : CompactNavSegment::right;
+}
+
+CompactNavSegment::TURN_DIRECTION getTurnDirectionId(const GeoSegment &gs1,
+        const GeoSegment &gs2)
+{
+    return getTurnDirectionId(headingOf(gs1.start, gs1.end), headingOf(gs2.start, gs2.end));
+}
+
+std::string getTravelDirection(const GeoSegment &gs)
+{
+    return CompactNavSegment::travelDirectionName(getTravelDirectionId(gs));
+}
+
 std::string getTurnDirection(const GeoSegment &gs1, const GeoSegment &gs2)
 {
-    return angleBetween2Lines(gs1, gs2) < 180.0 ? "left" : "right";
+    return CompactNavSegment::turnDirectionName(getTurnDirectionId(gs1, gs2));
 }
 
 double distanceEarthMiles(const StreetSegment &street)
@@ -77,6 +124,27 @@ double distanceEarthMiles(const StreetSegment &street)
     return distanceEarthMiles(street.segment.start, street.segment.end);
 }
 
+// The graph has one segment per street of the map file, with the same ends
+// and name.
+bool getStreetOfSegment(const MapSnapshot &map, int segId, StreetSegment &street)
+{
+    const auto &graph = map.graph;
+    const auto &seg   = graph.segment(segId);
+    const auto &start = graph.coord(seg.start);
+    const auto &end   = graph.coord(seg.end);
+    for (auto &candidate : map.segmentMapper.getSegments(start))
+    {
+        auto same = (candidate.segment.start == start and candidate.segment.end == end) or
+                    (candidate.segment.start == end and candidate.segment.end == start);
+        if (same and candidate.streetName == graph.streetName(seg.streetName))
+        {
+            street = std::move(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+
 bool operator==(const GeoCoord &gc1, const GeoCoord &gc2) 
 {
     return gc1.sLatitude  == gc2.sLatitude and
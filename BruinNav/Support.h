@@ -1,29 +1,111 @@
 #pragma once
 
-#include <stack>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "HubLabels.h"
+#include "MapMatching.h"
+#include "MemoryAccounting.h"
 #include "MyMap.h"
 #include "Provided.h"
+#include "QueryExecutor.h"
+#include "QueryLog.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "TiledMap.h"
 
-using locationInfo = std::pair<GeoCoord, std::string>;
+/**
+ *  Everything built from one map file. A snapshot is never changed once it
+ *  is published, so queries can read it without locks while a reload builds
+ *  the next one; each query holds a reference to the snapshot it started on.
+ *  Implementation defined in Navigator.cpp.
+ */
+struct MapSnapshot
+{
+    MapSnapshot(const MapSnapshot &other)          = delete;
+    MapSnapshot &operator=(const MapSnapshot &rhs) = delete;
+
+    explicit MapSnapshot(const MapLoader &ml);
+
+    size_t              segmentStorageBytes;    // of the MapLoader it was built from.
+    AttractionMapper    attractionMapper;
+    SegmentMapper       segmentMapper;
+    StreetGraph         graph;
+};
 
-struct score
+using MapPtr = std::shared_ptr<const MapSnapshot>;
+
+// Hub labels of one snapshot. They are optional and built after the
+// snapshot, so they are kept beside it; queries use them only if they
+// were built for the snapshot the query runs on.
+struct HubLabelIndex
+{
+    explicit HubLabelIndex(const MapPtr &map) : map(map), labels(map->graph) {}
+
+    MapPtr      map;
+    HubLabels   labels;
+};
+
+// Segment grid of one snapshot for map matching, built the first time a
+// trace is matched on the snapshot and kept beside it like the labels.
+struct MatchIndex
 {
-    score() {}
+    explicit MatchIndex(const MapPtr &map) : map(map), grid(map->graph) {}
 
-    score(double gScore, double hScore)
-        : g(gScore), h(hScore)
+    MapPtr      map;
+    SegmentGrid grid;
+};
+
+// Attractions of one snapshot by the nodes they attach to, built the first
+// time nearestAttractions runs on the snapshot. An attraction in the middle
+// of a segment is listed at both ends, as far as it is from each.
+struct NearbyIndex
+{
+    struct Entry
     {
-        f = g + h;
-    }
+        int    attraction;  // into names and locations.
+        int    segment;
+        double distance;    // miles from the node.
+    };
+
+    explicit NearbyIndex(const MapPtr &map);
+
+    MapPtr                      map;
+    std::vector<std::string>    names;
+    std::vector<GeoCoord>       locations;
+    std::vector<int>            firstEntry;     // by node; one past the end last.
+    std::vector<Entry>          entries;
+};
 
-    double f = std::numeric_limits<double>::max();
-    double g = std::numeric_limits<double>::max();
-    double h;
+// Which queries Navigator::setSearchTracing traces, and where to.
+struct TraceSampling
+{
+    int         period;
+    std::string directory;
+    TraceFormat format;
 };
 
+// Turn penalties as last set. They are published like a map snapshot, so a
+// query reads one consistent set of them however they change meanwhile.
+struct TurnSettings
+{
+    TurnPenalties penalties;
+    bool          turnAware = false;    // some penalty is above 0.
+};
+
+// Reusable buffers of the distance queries; defined in NavigatorDistance.cpp.
+struct DistanceScratch;
+
+// Backward tree from the destination of re-routes; defined in NavigatorReroute.cpp.
+struct RerouteTree;
+
 // Implementation defined in MapLoader.cpp
 class MapLoaderImpl
 {
@@ -33,8 +115,11 @@ public:
     bool load(std::string mapFile);
     size_t getNumSegments() const;
     bool getSegment(size_t segNum, StreetSegment &seg) const;
+    size_t getMemoryBytes() const;
+    size_t getStringBytes() const;
 
 private:
+    MemoryAccount                   account_;
     int                             nStreets_ = 0;
     std::vector<StreetSegment>      allStreets_ = {};
 };
@@ -53,7 +138,12 @@ public:
 
     inline std::vector<StreetSegment> getSegments(const GeoCoord &gc) const;
 
+    size_t getMemoryBytes() const;
+
+    size_t getStringBytes() const;
+
 private:
+    MemoryAccount                               account_;
     MyMap<GeoCoord, std::vector<StreetSegment>> geoCoordMap_;
 };
 
@@ -65,42 +155,311 @@ public:
     ~AttractionMapperImpl() = default;
     void init(const MapLoader& ml);
     bool getGeoCoord(std::string attraction, GeoCoord& gc) const;
+    bool getGeoCoord(const std::string &attraction, GeoCoord &gc,
+                     std::string &lowered) const;
+    size_t getMemoryBytes() const;
+    size_t getStringBytes() const;
+
+private:
+    bool findLowered(const std::string &attraction, GeoCoord &gc) const;
+
+private:
+    MemoryAccount                   account_;
+    MyMap<std::string, GeoCoord>    attractionMap_;
+};
+
+/**
+ *  Writes a CompactRoute back to front, from the destination to the source,
+ *  putting a turn in front of every leg that changes street. Searches unwind
+ *  their parent pointers from the destination, so this is the natural order.
+ *  Implementation defined in Navigator.cpp.
+ */
+class RouteWriter
+{
+public:
+    RouteWriter(CompactRoute &route, const MapPtr &map,
+                const GeoCoord &src, const GeoCoord &dst);
+
+    void prependLeg(int streetName, int startNode, int endNode,
+                    double distance, double heading);
+
+    void prependArc(const StreetGraph &graph, int arcId);
+
+    // Puts the route in travel order.
+    void finish();
+
+private:
+    CompactRoute   &route_;
+    double          nextHeading_ = 0.0;
+};
+
+/**
+ *  Deadline and cancellation token of one query. The search asks it before
+ *  every expansion, but the clock and the token are only looked at every
+ *  checkInterval expansions.
+ */
+class SearchBudget
+{
+public:
+    static const int checkInterval = 256;
+
+    SearchBudget(std::chrono::steady_clock::time_point deadline,
+                 const CancellationToken &token)
+        : deadline_(deadline), token_(token)
+    {
+    }
+
+    // NAV_SUCCESS while the search may go on, NAV_TIMEOUT or NAV_CANCELLED.
+    inline Navigator::NavResult check()
+    {
+        return ++nExpansions_ % checkInterval != 0 ? Navigator::NAV_SUCCESS : checkNow();
+    }
+
+    inline Navigator::NavResult checkNow() const
+    {
+        if (token_.isCancelled())
+        {
+            return Navigator::NAV_CANCELLED;
+        }
+        if (std::chrono::steady_clock::now() >= deadline_)
+        {
+            return Navigator::NAV_TIMEOUT;
+        }
+        return Navigator::NAV_SUCCESS;
+    }
 
 private:
-    MyMap<std::string, GeoCoord> attractionMap_;
+    std::chrono::steady_clock::time_point   deadline_;
+    CancellationToken                       token_;
+    int                                     nExpansions_ = 0;
 };
 
 // Implementation defined in Navigator.cpp
 class NavigatorImpl
 {
 public:
-    NavigatorImpl()  = default;
+    NavigatorImpl();
     ~NavigatorImpl() = default;
     bool loadMapData(std::string mapFile);
     Navigator::NavResult navigate(std::string start, std::string end,
                                   std::vector<NavSegment>& directions) const;
+    Navigator::NavResult navigate(const std::string &start, const std::string &end,
+                                  CompactRoute &route,
+                                  SearchBudget *budget = nullptr,
+                                  SearchTrace *trace = nullptr) const;
+    void getNavSegments(const CompactRoute &route,
+                        std::vector<NavSegment> &directions) const;
+    std::string getStreetName(int streetName) const;
+    bool getGeoCoord(std::string attraction, GeoCoord &gc) const;
+    void setTurnPenalties(const TurnPenalties &penalties);
+    int getComponent(std::string attraction) const;
+    void getComponentSizes(std::vector<int> &sizes) const;
+    void getMemoryUsage(MemoryUsage &usage) const;
+
+    bool startQueryLog(std::string logFile);
+    void stopQueryLog();
+    Navigator::NavResult navigateTraced(std::string start, std::string end,
+                                        CompactRoute &route, SearchTrace &trace) const;
+    void setSearchTracing(int samplePeriod, std::string directory, TraceFormat format);
+
+    // Runs query, which returns a NavResult, and records it into the query
+    // log if one is open. Costs one relaxed load when none is.
+    template <class Query>
+    Navigator::NavResult logged(const std::string &start, const std::string &end,
+                                Query query) const;
+
+    // Implementation defined in NavigatorDistance.cpp
+    void buildHubLabels();
+    Navigator::NavResult networkDistance(std::string start, std::string end,
+                                         double &miles) const;
+    void networkDistances(const std::vector<std::pair<std::string, std::string>> &pairs,
+                          std::vector<double> &miles,
+                          std::vector<Navigator::NavResult> &results) const;
+
+    // Implementation defined in NavigatorAsync.cpp
+    std::future<AsyncRoute> navigateAsync(std::string start, std::string end,
+                                          std::chrono::steady_clock::time_point deadline,
+                                          CancellationToken token) const;
+
+    // Implementation defined in NavigatorAlternatives.cpp
+    Navigator::NavResult navigateAlternatives(std::string start, std::string end,
+                                              const AlternativeLimits &limits,
+                                              std::vector<CompactRoute> &routes) const;
+
+    // Implementation defined in NavigatorReroute.cpp
+    Navigator::NavResult reroute(const CompactRoute &previous, const GeoCoord &position,
+                                 CompactRoute &route) const;
+
+    // Implementation defined in NavigatorNearest.cpp
+    Navigator::NavResult nearestAttractions(std::string start, int k,
+                                            std::vector<NearbyAttraction> &found,
+                                            const std::function<bool(const std::string &)> &accept,
+                                            bool withRoutes) const;
+
+    // Implementation defined in NavigatorTrip.cpp
+    Navigator::NavResult planTrip(std::string depot, const std::vector<std::string> &stops,
+                                  const TripOptions &options, std::vector<int> &order,
+                                  std::vector<NavSegment> &directions) const;
+
+    // Implementation defined in NavigatorMatching.cpp
+    Navigator::NavResult matchTrace(const std::vector<GpsPing> &trace,
+                                    std::vector<StreetSegment> &segments,
+                                    const MatchOptions &options) const;
+    void matchTraces(const std::vector<std::vector<GpsPing>> &traces,
+                     std::vector<std::vector<StreetSegment>> &segments,
+                     std::vector<Navigator::NavResult> &results,
+                     const MatchOptions &options) const;
+    // The segment grid of the map loaded now, built if not yet.
+    std::shared_ptr<const MatchIndex> matchIndex() const;
 
 private:
-    inline bool contains(const MyMap<GeoCoord, bool> &container,
-                         const GeoCoord &gc) const;
+    // The map queries starting now run on.
+    inline MapPtr snapshot() const { return std::atomic_load(&map_); }
+
+    // The turn settings queries starting now use.
+    inline std::shared_ptr<const TurnSettings> turnSettings() const
+    {
+        return std::atomic_load(&turnSettings_);
+    }
 
-    inline bool streetContainsLocation(const StreetSegment &seg, 
-                                       const GeoCoord &locaton) const;
-    
-    inline void reconstructPath(const MyMap<locationInfo, locationInfo> &cameFrom,
-                                std::stack<StreetSegment> &fullPath,
-                                const GeoCoord &src) const;
+    // The attraction index of the map loaded now, built if not yet.
+    std::shared_ptr<const NearbyIndex> nearbyIndex() const;
+
+    // The re-route tree towards destination on map, made if not cached.
+    std::shared_ptr<RerouteTree> rerouteTree(const MapPtr &map,
+                                             const GeoCoord &destination) const;
+
+    // False if no route can join the two locations.
+    bool mayConnect(const MapSnapshot &map, const GeoCoord &gcSrc,
+                    const GeoCoord &gcDst) const;
+
+    // srcSegIds, if given, are the segments gcSrc lies in the middle of, for
+    // a source that is neither a node nor an attraction.
+    Navigator::NavResult navigateByArcs(const MapPtr &map, const TurnSettings &turns,
+                                        const GeoCoord &gcSrc, const GeoCoord &gcDst,
+                                        CompactRoute &route,
+                                        SearchBudget *budget = nullptr,
+                                        SearchTrace *trace = nullptr,
+                                        const std::vector<int> *srcSegIds = nullptr) const;
+
+    // The search of navigateByArcs; tracer is told of every chain settled.
+    template <class Tracer>
+    Navigator::NavResult searchArcs(const MapPtr &map, const TurnSettings &turns,
+                                    const GeoCoord &gcSrc, const GeoCoord &gcDst,
+                                    CompactRoute &route, SearchBudget *budget,
+                                    Tracer &tracer, const std::vector<int> *srcSegIds) const;
+
+    // Traces a query picked by setSearchTracing into a file.
+    Navigator::NavResult navigateSampled(const TraceSampling &sampling, long long sample,
+                                         const std::string &start, const std::string &end,
+                                         CompactRoute &route, SearchBudget *budget) const;
+
+    // Fills the path of trace with the locations route passes, in order.
+    void traceRoute(const CompactRoute &route, SearchTrace &trace) const;
+
+    inline const GeoCoord &startOf(const MapSnapshot &map, const CompactRoute &route,
+                                   const CompactNavSegment &navSeg) const;
+
+    inline const GeoCoord &endOf(const MapSnapshot &map, const CompactRoute &route,
+                                 const CompactNavSegment &navSeg) const;
+
+    void writeViaRoute(const MapPtr &map, const std::vector<int> &arcs,
+                       const std::vector<Anchor> &srcAnchors,
+                       const std::vector<Anchor> &dstAnchors,
+                       int firstNode, int lastNode,
+                       const GeoCoord &gcSrc, const GeoCoord &gcDst,
+                       CompactRoute &route) const;
+
+    Navigator::NavResult networkDistance(const MapSnapshot &map,
+                                         const HubLabelIndex *hubLabels,
+                                         std::string start, std::string end,
+                                         double &miles, DistanceScratch &scratch) const;
+
+    bool computeTripDistances(const MapSnapshot &map,
+                              const std::vector<GeoCoord> &locations, int nThreads,
+                              std::vector<double> &distances) const;
 
-    void getNavSegments(std::stack<StreetSegment> &fullPath,
-                        std::vector<NavSegment> &result, 
-                        const MyMap<GeoCoord, score> &scoreMap,
-                        const std::string &prevStreetName) const;
+private:
+    MapPtr                              map_;   // only through atomic_load/store.
+    std::shared_ptr<const HubLabelIndex> hubLabels_;    // likewise.
+    std::atomic<bool>                   hubLabelsWanted_{ false };
+    std::shared_ptr<QueryLogWriter>     queryLog_;      // only through atomic_load/store.
+    std::atomic<bool>                   loggingQueries_{ false };
+    std::shared_ptr<const TraceSampling> traceSampling_;   // likewise.
+    std::atomic<bool>                   samplingTraces_{ false };
+    mutable std::atomic<long long>      nTraceCandidates_{ 0 };
+    std::shared_ptr<const TurnSettings> turnSettings_;  // only through atomic_load/store.
+    mutable std::atomic<size_t>         navigatePeak_{ 0 };
+    mutable std::mutex                  rerouteMutex_;
+    mutable std::list<std::shared_ptr<RerouteTree>> rerouteTrees_;    // most recent first.
+    mutable std::shared_ptr<const MatchIndex> matchIndex_;    // only through atomic_load/store.
+    mutable std::mutex                  matchIndexMutex_;   // held while one is built.
+    mutable std::shared_ptr<const NearbyIndex> nearbyIndex_;  // only through atomic_load/store.
+    mutable std::mutex                  nearbyIndexMutex_;  // held while one is built.
+    mutable QueryExecutor               executor_;  // last, so it stops first.
+};
+
+template <class Query>
+Navigator::NavResult NavigatorImpl::logged(const std::string &start, const std::string &end,
+                                           Query query) const
+{
+    if (!loggingQueries_.load(std::memory_order_relaxed))
+    {
+        return query();
+    }
+    auto log    = std::atomic_load(&queryLog_);
+    auto began  = std::chrono::steady_clock::now();
+    auto result = query();
+    if (log != nullptr)
+    {
+        log->record(start, end, result, began, std::chrono::steady_clock::now());
+    }
+    return result;
+}
+
+// Implementation defined in NavigatorMatching.cpp
+class TraceMatcherImpl
+{
+public:
+    TraceMatcherImpl(const NavigatorImpl &navigator, const MatchOptions &options);
+    void addPing(const GpsPing &ping, std::vector<StreetSegment> &segments);
+    void finish(std::vector<StreetSegment> &segments);
 
 private:
-    AttractionMapper    attractionMapper_;
-    SegmentMapper       segmentMapper_;
+    std::shared_ptr<const MatchIndex>   index_;     // keeps the map of the matcher alive.
+    HmmMatcher                          matcher_;
+    std::vector<int>                    path_;
 };
 
+// Implementation defined in TiledNavigator.cpp
+class TiledNavigatorImpl
+{
+public:
+    TiledNavigatorImpl()  = default;
+    ~TiledNavigatorImpl() = default;
+    bool open(std::string directory, size_t memoryBudgetBytes);
+    Navigator::NavResult navigate(std::string start, std::string end,
+                                  std::vector<NavSegment> &directions) const;
+    void getTileStats(TileCacheStats &stats) const;
+
+private:
+    // Appends the streets of the shortest way from one boundary node of a
+    // tile to another; false if the tile cannot be read.
+    bool unpackShortcut(int tileId, int from, int to,
+                        std::vector<StreetSegment> &path) const;
+
+private:
+    std::unique_ptr<TileIndex>  index_;
+    std::unique_ptr<TileCache>  cache_;     // refers to *index_.
+};
+
+/**
+ *  @param path   the streets of a route, in travel order.
+ *  @param result overwritten in place with a proceed per street and a turn
+ *                before every change of street name.
+ */
+void buildDirections(const std::vector<StreetSegment> &path, std::vector<NavSegment> &result);
+
 /**
  *  @param toBeConverted the string to be converted to lowercase
  *  @post  all characters of toBeConverted shall be in lowercase alphabet
@@ -126,8 +485,33 @@ std::string getTravelDirection(const GeoSegment &gs);
 
 std::string getTurnDirection(const GeoSegment &gs1, const GeoSegment &gs2);
 
+/**
+ * @return the heading of the line from `from` to `to`: the atan2 angle in
+ *         radians that angleOfLine and angleBetween2Lines are derived from.
+ */
+double headingOf(const GeoCoord &from, const GeoCoord &to);
+
+// angleOfLine and angleBetween2Lines of lines given by their headings.
+double angleOfHeading(double heading);
+
+double angleBetweenHeadings(double heading1, double heading2);
+
+// Enum forms of getTravelDirection and getTurnDirection.
+CompactNavSegment::TRAVEL_DIRECTION getTravelDirectionId(double heading);
+
+CompactNavSegment::TRAVEL_DIRECTION getTravelDirectionId(const GeoSegment &gs);
+
+CompactNavSegment::TURN_DIRECTION getTurnDirectionId(double heading1, double heading2);
+
+CompactNavSegment::TURN_DIRECTION getTurnDirectionId(const GeoSegment &gs1,
+        const GeoSegment &gs2);
+
 double distanceEarthMiles(const StreetSegment &street);
 
+// The street of the map file that segment segId of map's graph was built
+// from; false if there is none.
+bool getStreetOfSegment(const MapSnapshot &map, int segId, StreetSegment &street);
+
 // basic comparison operators to check for uniqueness.
 bool operator==(const GeoCoord &gc1, const GeoCoord &gc2);
 
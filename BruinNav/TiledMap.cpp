@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "MyMap.h"
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+#include "TiledMap.h"
+
+static const char *const indexHeader = "BruinNav tiles 1";
+
+std::string tileFile(const std::string &directory, int tileId)
+{
+    return directory + "/tile_" + std::to_string(tileId) + ".txt";
+}
+
+static std::string indexFile(const std::string &directory)
+{
+    return directory + "/index.txt";
+}
+
+// The "lat, lon" form the map file parser reads back to the same strings.
+static std::string coordText(const GeoCoord &gc)
+{
+    return gc.sLatitude + ", " + gc.sLongitude;
+}
+
+static void addUnique(std::vector<int> &ids, int id)
+{
+    if (std::find(begin(ids), end(ids), id) == end(ids))
+    {
+        ids.emplace_back(id);
+    }
+}
+
+// Writes the clique of shortest distances inside the tile between its
+// boundary nodes, -1 where the tile does not join them.
+static void writeClique(const Tile &tile, std::ostream &out)
+{
+    auto k    = static_cast<int>(size(tile.localNode));
+    auto tree = DijkstraTree(tile.graph);
+    for (int p = 0; p < k; ++p)
+    {
+        tree.reset();
+        tree.addSeed(tile.localNode[p], 0.0);
+        tree.growToCover(tile.localNode);
+        for (int q = 0; q < k; ++q)
+        {
+            auto node = tile.localNode[q];
+            out << (q == 0 ? "" : " ");
+            if (tree.isSettled(node))
+            {
+                out << tree.distance(node);
+            }
+            else
+            {
+                out << -1;
+            }
+        }
+        out << "\n";
+    }
+}
+
+bool writeTiledMap(const MapLoader &ml, const std::string &directory, double tileDegrees)
+{
+    auto error = std::error_code();
+    std::filesystem::create_directories(directory, error);
+
+    auto nSegments = ml.getNumSegments();
+    auto streets   = std::vector<StreetSegment>(nSegments);
+    auto minLat    = std::numeric_limits<double>::max();
+    auto minLon    = std::numeric_limits<double>::max();
+    auto maxLon    = std::numeric_limits<double>::lowest();
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        ml.getSegment(i, streets[i]);
+        for (const auto *gc : { &streets[i].segment.start, &streets[i].segment.end })
+        {
+            minLat = std::min(minLat, gc->latitude);
+            minLon = std::min(minLon, gc->longitude);
+            maxLon = std::max(maxLon, gc->longitude);
+        }
+    }
+
+    // Tiles are numbered in order of first appearance of their cell.
+    auto nColumns    = static_cast<long long>((maxLon - minLon) / tileDegrees) + 1;
+    auto tileOfCell  = MyMap<long long, int>();
+    auto tileOf      = std::vector<int>(nSegments);
+    auto tileStreets = std::vector<std::vector<int>>{};
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        const auto &gs  = streets[i].segment;
+        auto row        = static_cast<long long>(
+            ((gs.start.latitude + gs.end.latitude) / 2 - minLat) / tileDegrees);
+        auto column     = static_cast<long long>(
+            ((gs.start.longitude + gs.end.longitude) / 2 - minLon) / tileDegrees);
+        auto cell       = row * nColumns + column;
+        const auto *tileId = tileOfCell.find(cell);
+        if (tileId == nullptr)
+        {
+            tileOfCell.associate(cell, static_cast<int>(size(tileStreets)));
+            tileId = tileOfCell.find(cell);
+            tileStreets.emplace_back();
+        }
+        tileOf[i] = *tileId;
+        tileStreets[*tileId].emplace_back(static_cast<int>(i));
+    }
+    auto nTiles = static_cast<int>(size(tileStreets));
+
+    // Boundary nodes are numbered in order of first appearance too.
+    auto tilesAt = MyMap<GeoCoord, std::vector<int>>();
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        for (const auto *gc : { &streets[i].segment.start, &streets[i].segment.end })
+        {
+            auto *tiles = tilesAt.find(*gc);
+            if (tiles == nullptr)
+            {
+                tilesAt.associate(*gc, { tileOf[i] });
+            }
+            else
+            {
+                addUnique(*tiles, tileOf[i]);
+            }
+        }
+    }
+    auto index      = TileIndex();
+    auto boundaryOf = MyMap<GeoCoord, int>();
+    index.tiles.resize(nTiles);
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        for (const auto *gc : { &streets[i].segment.start, &streets[i].segment.end })
+        {
+            const auto &tiles = *tilesAt.find(*gc);
+            if (size(tiles) < 2 or boundaryOf.find(*gc) != nullptr)
+            {
+                continue;
+            }
+            auto b = static_cast<int>(size(index.boundaryCoords));
+            boundaryOf.associate(*gc, b);
+            index.boundaryCoords.emplace_back(*gc);
+            for (auto tileId : tiles)
+            {
+                index.tiles[tileId].boundary.emplace_back(b);
+            }
+        }
+    }
+
+    // An attraction is where its last listing puts it, as in AttractionMapper,
+    // and lies in every tile with a segment listing it there.
+    auto attractionNames = std::vector<std::string>{};
+    auto attractions     = std::vector<TiledAttraction>{};
+    auto attractionSlot  = MyMap<std::string, int>();
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        for (const auto &address : streets[i].attractionsOnThisSegment)
+        {
+            const auto *slot = attractionSlot.find(address.attraction);
+            if (slot == nullptr)
+            {
+                attractionSlot.associate(address.attraction, static_cast<int>(size(attractions)));
+                slot = attractionSlot.find(address.attraction);
+                attractionNames.emplace_back(address.attraction);
+                attractions.emplace_back();
+            }
+            auto &attraction = attractions[*slot];
+            if (attraction.tiles.empty() or attraction.location != address.location)
+            {
+                attraction.location = address.location;
+                attraction.tiles.clear();
+            }
+            addUnique(attraction.tiles, tileOf[i]);
+        }
+    }
+
+    auto out = std::ofstream(indexFile(directory));
+    if (!out)
+    {
+        return false;
+    }
+    out << std::setprecision(17);
+    out << indexHeader << "\n" << size(index.boundaryCoords) << "\n";
+    for (const auto &gc : index.boundaryCoords)
+    {
+        out << coordText(gc) << "\n";
+    }
+
+    out << nTiles << "\n";
+    for (int t = 0; t < nTiles; ++t)
+    {
+        auto tileOut = std::ofstream(tileFile(directory, t));
+        for (auto segId : tileStreets[t])
+        {
+            const auto &street = streets[segId];
+            tileOut << street.streetName << "\n"
+                    << coordText(street.segment.start) << " "
+                    << coordText(street.segment.end) << "\n"
+                    << size(street.attractionsOnThisSegment) << "\n";
+            for (const auto &address : street.attractionsOnThisSegment)
+            {
+                tileOut << address.attraction << "|" << coordText(address.location) << "\n";
+            }
+        }
+        tileOut.close();
+        if (!tileOut)
+        {
+            return false;
+        }
+
+        // The cliques are computed on the tiles as they will be read back.
+        auto tileLoader = MapLoader();
+        if (!tileLoader.load(tileFile(directory, t)))
+        {
+            return false;
+        }
+        const auto &info = index.tiles[t];
+        out << size(tileStreets[t]) << " " << size(info.boundary);
+        for (auto b : info.boundary)
+        {
+            out << " " << b;
+        }
+        out << "\n";
+        writeClique(Tile(tileLoader, index, t), out);
+    }
+
+    out << size(attractions) << "\n";
+    for (size_t a = 0; a < size(attractions); ++a)
+    {
+        out << attractionNames[a] << "|" << coordText(attractions[a].location) << "\n"
+            << size(attractions[a].tiles);
+        for (auto tileId : attractions[a].tiles)
+        {
+            out << " " << tileId;
+        }
+        out << "\n";
+    }
+    out.close();
+    return static_cast<bool>(out);
+}
+
+bool readTileIndex(const std::string &directory, TileIndex &index)
+{
+    auto in = std::ifstream(indexFile(directory));
+    auto line = std::string();
+    if (!std::getline(in, line) or line != indexHeader)
+    {
+        return false;
+    }
+    index.directory = directory;
+
+    auto nBoundary = 0;
+    in >> nBoundary;
+    std::getline(in, line);
+    index.boundaryCoords.clear();
+    for (int b = 0; b < nBoundary and std::getline(in, line); ++b)
+    {
+        extractGeoCoords(line, 0, index.boundaryCoords);
+    }
+    if (static_cast<int>(size(index.boundaryCoords)) != nBoundary)
+    {
+        return false;
+    }
+
+    auto nTiles = 0;
+    in >> nTiles;
+    index.tiles.assign(nTiles, TileInfo());
+    index.boundarySlots.assign(nBoundary, {});
+    for (int t = 0; t < nTiles and in; ++t)
+    {
+        auto &info = index.tiles[t];
+        auto k = 0;
+        in >> info.nSegments >> k;
+        info.boundary.resize(k);
+        for (int p = 0; p < k; ++p)
+        {
+            in >> info.boundary[p];
+            if (info.boundary[p] < 0 or info.boundary[p] >= nBoundary)
+            {
+                return false;
+            }
+            index.boundarySlots[info.boundary[p]].push_back({ t, p });
+        }
+        info.clique.resize(k * k);
+        for (auto &distance : info.clique)
+        {
+            in >> distance;
+            if (distance < 0.0)
+            {
+                distance = std::numeric_limits<double>::infinity();
+            }
+        }
+    }
+
+    auto nAttractions = 0;
+    in >> nAttractions;
+    std::getline(in, line);
+    for (int a = 0; a < nAttractions and std::getline(in, line); ++a)
+    {
+        auto address = Address();
+        extractAttraction(line, address);
+        auto attraction = TiledAttraction();
+        attraction.location = address.location;
+        auto nAttractionTiles = 0;
+        in >> nAttractionTiles;
+        attraction.tiles.resize(nAttractionTiles);
+        for (auto &tileId : attraction.tiles)
+        {
+            in >> tileId;
+        }
+        std::getline(in, line);
+        index.attractions.associate(address.attraction, attraction);
+    }
+    return static_cast<bool>(in);
+}
+
+Tile::Tile(const MapLoader &ml, const TileIndex &index, int tileId)
+    : graph(ml)
+{
+    const auto &info = index.tiles[tileId];
+    position.assign(graph.nodeCount(), -1);
+    localNode.resize(size(info.boundary));
+    for (size_t p = 0; p < size(info.boundary); ++p)
+    {
+        localNode[p] = graph.findNode(index.boundaryCoords[info.boundary[p]]);
+        position[localNode[p]] = static_cast<int>(p);
+    }
+}
+
+size_t Tile::countedBytes() const
+{
+    return sizeof(Tile) + graph.countedBytes() + vectorBytes(localNode) + vectorBytes(position);
+}
+
+TileCache::TileCache(const TileIndex &index, size_t memoryBudget)
+    : index_(index), memoryBudget_(memoryBudget)
+{
+    entryOf_.assign(size(index.tiles), lru_.end());
+}
+
+std::shared_ptr<const Tile> TileCache::get(int tileId)
+{
+    auto lock  = std::lock_guard<std::mutex>(mutex_);
+    auto entry = entryOf_[tileId];
+    if (entry != lru_.end())
+    {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, entry);
+        return entry->tile;
+    }
+
+    // Sized from its containers rather than a MemoryAccount, so the budget
+    // holds in programs built without the allocation hooks too.
+    ++stats_.misses;
+    auto ml = MapLoader();
+    if (!ml.load(tileFile(index_.directory, tileId)))
+    {
+        return nullptr;
+    }
+    auto tile  = std::make_shared<const Tile>(ml, index_, tileId);
+    auto bytes = tile->countedBytes();
+    lru_.push_front({ tileId, tile, bytes });
+    entryOf_[tileId] = lru_.begin();
+    ++stats_.residentTiles;
+    stats_.residentBytes += bytes;
+
+    while (stats_.residentBytes > memoryBudget_ and size(lru_) > 1)
+    {
+        const auto &victim = lru_.back();
+        ++stats_.evictions;
+        --stats_.residentTiles;
+        stats_.residentBytes -= victim.bytes;
+        entryOf_[victim.tileId] = lru_.end();
+        lru_.pop_back();
+    }
+    return tile;
+}
+
+void TileCache::getStats(TileCacheStats &stats) const
+{
+    auto lock = std::lock_guard<std::mutex>(mutex_);
+    stats = stats_;
+}
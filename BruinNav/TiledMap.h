@@ -0,0 +1,130 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MyMap.h"
+#include "Provided.h"
+#include "StreetGraph.h"
+
+/**
+ *  A map cut along a geographic grid, for maps too large to keep resident.
+ *
+ *  Every segment goes to the grid cell of its midpoint, and every non-empty
+ *  cell becomes a tile, stored as a map file of its own in the mapdata.txt
+ *  format. Boundary nodes are the locations shared by segments of different
+ *  tiles. The index file keeps, for each tile, its boundary nodes and the
+ *  shortest distances between them inside the tile (a clique of shortcuts),
+ *  plus the location and tiles of every attraction.
+ *
+ *  The shortcuts of all tiles form the overlay graph. A route leaves the
+ *  tiles of its source through one of their boundary nodes, crosses other
+ *  tiles along shortcuts and enters the tiles of its destination the same
+ *  way, so only those two sets of tiles are searched in full; the tiles the
+ *  shortcuts of the route cross are paged in afterwards to unpack them.
+ */
+
+// A tile as described by the index.
+struct TileInfo
+{
+    int                 nSegments = 0;
+    std::vector<int>    boundary;   // boundary node ids, in clique order.
+    std::vector<double> clique;     // k x k distances inside the tile, row-major.
+};
+
+// Where a boundary node appears in a tile's clique.
+struct TileSlot
+{
+    int tile;
+    int position;
+};
+
+// What the index knows about an attraction.
+struct TiledAttraction
+{
+    GeoCoord            location;
+    std::vector<int>    tiles;      // tiles with a segment listing it.
+};
+
+struct TileIndex
+{
+    TileIndex() = default;
+    TileIndex(const TileIndex &other)          = delete;
+    TileIndex &operator=(const TileIndex &rhs) = delete;
+
+    std::string                             directory;
+    std::vector<GeoCoord>                   boundaryCoords;
+    std::vector<std::vector<TileSlot>>      boundarySlots;  // per boundary node.
+    std::vector<TileInfo>                   tiles;
+    MyMap<std::string, TiledAttraction>     attractions;
+};
+
+// A tile paged in from disk, with its boundary nodes found in its graph.
+struct Tile
+{
+    Tile(const MapLoader &ml, const TileIndex &index, int tileId);
+
+    // Heap bytes held, from the sizes of the containers (see countedBytes).
+    size_t countedBytes() const;
+
+    StreetGraph         graph;
+    std::vector<int>    localNode;      // clique position -> node of graph.
+    std::vector<int>    position;       // node of graph -> clique position, or -1.
+};
+
+/**
+ *  Least recently used tiles kept within a memory budget. A tile is never
+ *  evicted while it is the only one resident, and tiles in use by a query
+ *  stay alive through their shared_ptr after eviction. Thread-safe; tiles
+ *  are read from disk under the lock.
+ */
+class TileCache
+{
+public:
+    TileCache(const TileCache &other)          = delete;
+    TileCache &operator=(const TileCache &rhs) = delete;
+
+public:
+    TileCache(const TileIndex &index, size_t memoryBudget);
+
+    // nullptr if the tile file cannot be read.
+    std::shared_ptr<const Tile> get(int tileId);
+
+    void getStats(TileCacheStats &stats) const;
+
+private:
+    struct Entry
+    {
+        int                         tileId;
+        std::shared_ptr<const Tile> tile;
+        size_t                      bytes;  // Tile::countedBytes when read.
+    };
+
+    const TileIndex                         &index_;
+    size_t                                  memoryBudget_;
+    mutable std::mutex                      mutex_;
+    std::list<Entry>                        lru_;       // most recently used first.
+    std::vector<std::list<Entry>::iterator> entryOf_;   // per tile, lru_.end() if absent.
+    TileCacheStats                          stats_;
+};
+
+/**
+ *  @param ml          the whole map.
+ *  @param directory   receives the index and the tiles; created if needed.
+ *  @param tileDegrees side of the grid cells, in degrees of latitude and longitude.
+ *  @return false if a file cannot be written.
+ */
+bool writeTiledMap(const MapLoader &ml, const std::string &directory, double tileDegrees);
+
+/**
+ *  @param directory where writeTiledMap put the map.
+ *  @param index     receives the index; the tiles are left on disk.
+ *  @return false if the index cannot be read.
+ */
+bool readTileIndex(const std::string &directory, TileIndex &index);
+
+// Path of a tile's map file.
+std::string tileFile(const std::string &directory, int tileId);
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "Provided.h"
+#include "ShortestPathTree.h"
+#include "StreetGraph.h"
+#include "Support.h"
+#include "TiledMap.h"
+
+bool TiledNavigatorImpl::open(std::string directory, size_t memoryBudgetBytes)
+{
+    auto index = std::make_unique<TileIndex>();
+    if (!readTileIndex(directory, *index))
+    {
+        return false;
+    }
+    cache_.reset();
+    index_ = std::move(index);
+    cache_ = std::make_unique<TileCache>(*index_, memoryBudgetBytes);
+    return true;
+}
+
+void TiledNavigatorImpl::getTileStats(TileCacheStats &stats) const
+{
+    stats = TileCacheStats();
+    if (cache_ != nullptr)
+    {
+        cache_->getStats(stats);
+    }
+}
+
+/**
+ *  Dijkstra over the overlay graph with the tiles of the source and of the
+ *  destination searched in full. Search nodes are the nodes of those tiles,
+ *  one block per tile, followed by every boundary node of the index. A
+ *  boundary node is joined at no cost to its copies in the full tiles, and
+ *  to the boundary nodes of the other tiles by their clique shortcuts. The
+ *  shortcuts on the route are unpacked afterwards, tile by tile.
+ */
+Navigator::NavResult TiledNavigatorImpl::navigate(std::string start, std::string end,
+                                                  std::vector<NavSegment> &directions) const
+{
+    makeLowerCase(start);
+    makeLowerCase(end);
+    const auto *src = index_ == nullptr ? nullptr : index_->attractions.find(start);
+    if (src == nullptr)
+    {
+        return Navigator::NAV_BAD_SOURCE;
+    }
+    const auto *dst = index_->attractions.find(end);
+    if (dst == nullptr)
+    {
+        return Navigator::NAV_BAD_DESTINATION;
+    }
+    if (src->location == dst->location)
+    {
+        directions.clear();
+        return Navigator::NAV_SUCCESS;
+    }
+
+    auto fullTileIds = src->tiles;
+    for (auto tileId : dst->tiles)
+    {
+        if (std::find(begin(fullTileIds), std::end(fullTileIds), tileId) == std::end(fullTileIds))
+        {
+            fullTileIds.emplace_back(tileId);
+        }
+    }
+    auto fullTiles = std::vector<std::shared_ptr<const Tile>>{};
+    auto offsets   = std::vector<int>{ 0 };
+    for (auto tileId : fullTileIds)
+    {
+        fullTiles.emplace_back(cache_->get(tileId));
+        if (fullTiles.back() == nullptr)
+        {
+            return Navigator::NAV_NO_ROUTE;
+        }
+        offsets.emplace_back(offsets.back() + fullTiles.back()->graph.nodeCount());
+    }
+    auto boundaryBase = offsets.back();
+    auto nNodes       = boundaryBase + static_cast<int>(size(index_->boundaryCoords));
+    auto fullIndexOf  = [&](int tileId) {
+        auto found = std::find(begin(fullTileIds), std::end(fullTileIds), tileId);
+        return found == std::end(fullTileIds) ? -1 : static_cast<int>(found - begin(fullTileIds));
+    };
+    auto blockOf = [&](int node) {
+        return static_cast<int>(std::upper_bound(begin(offsets), std::end(offsets), node) -
+                                begin(offsets)) - 1;
+    };
+
+    // via is the arc of a step inside a full tile, the tile of a shortcut,
+    // or -1 for a step between a boundary node and one of its copies. For
+    // seeds, it is the segment the source lies on, -1 if it is the node.
+    const auto infinity = std::numeric_limits<double>::max();
+    auto distance = std::vector<double>(nNodes, infinity);
+    auto parent   = std::vector<int>(nNodes, -1);
+    auto via      = std::vector<int>(nNodes, -1);
+    auto settled  = std::vector<bool>(nNodes, false);
+    using nodeEntry = std::pair<double, int>;
+    auto open = std::priority_queue<nodeEntry, std::vector<nodeEntry>,
+                                    std::greater<nodeEntry>>();
+    auto relax = [&](int node, double d, int from, int how) {
+        if (d < distance[node])
+        {
+            distance[node] = d;
+            parent[node]   = from;
+            via[node]      = how;
+            open.emplace(d, node);
+        }
+    };
+
+    struct Target
+    {
+        int    node;
+        double distance;
+        int    segment;
+    };
+    auto anchors = std::vector<Anchor>{};
+    auto targets = std::vector<Target>{};
+    auto bestDistance = infinity;
+    auto bestTarget   = -1;     // -1 with a finite bestDistance is the direct leg.
+    auto directStreet = std::string();
+    for (size_t i = 0; i < size(fullTileIds); ++i)
+    {
+        const auto &graph = fullTiles[i]->graph;
+        auto srcAnchors = std::vector<Anchor>{};
+        auto isSource   = std::find(begin(src->tiles), std::end(src->tiles), fullTileIds[i]) !=
+                          std::end(src->tiles);
+        auto isTarget   = std::find(begin(dst->tiles), std::end(dst->tiles), fullTileIds[i]) !=
+                          std::end(dst->tiles);
+        if (isSource)
+        {
+            graph.anchorsOf(src->location, srcAnchors);
+            for (const auto &anchor : srcAnchors)
+            {
+                relax(offsets[i] + anchor.node, anchor.distance, -1, anchor.segment);
+            }
+        }
+        if (isTarget)
+        {
+            graph.anchorsOf(dst->location, anchors);
+            for (const auto &anchor : anchors)
+            {
+                targets.push_back({ offsets[i] + anchor.node, anchor.distance, anchor.segment });
+                for (const auto &srcAnchor : srcAnchors)
+                {
+                    if (anchor.segment != -1 and anchor.segment == srcAnchor.segment)
+                    {
+                        bestDistance = distanceEarthMiles(src->location, dst->location);
+                        directStreet = graph.streetName(graph.segment(anchor.segment).streetName);
+                    }
+                }
+            }
+        }
+    }
+
+    while (!open.empty())
+    {
+        auto current = open.top();
+        open.pop();
+        auto node = current.second;
+        if (current.first >= bestDistance)
+        {
+            break;
+        }
+        if (settled[node])
+        {
+            continue;
+        }
+        settled[node] = true;
+
+        for (int t = 0; t < static_cast<int>(size(targets)); ++t)
+        {
+            if (targets[t].node == node and current.first + targets[t].distance < bestDistance)
+            {
+                bestDistance = current.first + targets[t].distance;
+                bestTarget   = t;
+            }
+        }
+
+        if (node < boundaryBase)
+        {
+            auto block = blockOf(node);
+            const auto &tile = *fullTiles[block];
+            auto local = node - offsets[block];
+            for (int a = tile.graph.firstArc(local); a < tile.graph.firstArc(local + 1); ++a)
+            {
+                const auto &arc = tile.graph.arc(a);
+                relax(offsets[block] + arc.head, current.first + arc.length, node, a);
+            }
+            if (tile.position[local] != -1)
+            {
+                auto b = index_->tiles[fullTileIds[block]].boundary[tile.position[local]];
+                relax(boundaryBase + b, current.first, node, -1);
+            }
+            continue;
+        }
+
+        for (const auto &slot : index_->boundarySlots[node - boundaryBase])
+        {
+            auto block = fullIndexOf(slot.tile);
+            if (block != -1)
+            {
+                relax(offsets[block] + fullTiles[block]->localNode[slot.position],
+                      current.first, node, -1);
+                continue;
+            }
+            const auto &info = index_->tiles[slot.tile];
+            auto k   = static_cast<int>(size(info.boundary));
+            auto row = info.clique.data() + slot.position * k;
+            for (int q = 0; q < k; ++q)
+            {
+                if (q != slot.position and row[q] != std::numeric_limits<double>::infinity())
+                {
+                    relax(boundaryBase + info.boundary[q], current.first + row[q], node,
+                          slot.tile);
+                }
+            }
+        }
+    }
+
+    if (bestDistance == infinity)
+    {
+        return Navigator::NAV_NO_ROUTE;
+    }
+    auto path = std::vector<StreetSegment>{};
+    auto leg  = [&](const GeoCoord &from, const GeoCoord &to, const std::string &street) {
+        path.emplace_back();
+        path.back().streetName = street;
+        path.back().segment    = GeoSegment(from, to);
+    };
+    if (bestTarget == -1)
+    {
+        leg(src->location, dst->location, directStreet);
+        buildDirections(path, directions);
+        return Navigator::NAV_SUCCESS;
+    }
+
+    auto steps = std::vector<int>{};
+    for (auto node = targets[bestTarget].node; node != -1; node = parent[node])
+    {
+        steps.emplace_back(node);
+    }
+    std::reverse(begin(steps), std::end(steps));
+
+    auto coordOf = [&](int node) -> const GeoCoord & {
+        if (node >= boundaryBase)
+        {
+            return index_->boundaryCoords[node - boundaryBase];
+        }
+        auto block = blockOf(node);
+        return fullTiles[block]->graph.coord(node - offsets[block]);
+    };
+    auto streetOf = [&](int node, int segId) -> const std::string & {
+        const auto &graph = fullTiles[blockOf(node)]->graph;
+        return graph.streetName(graph.segment(segId).streetName);
+    };
+
+    if (via[steps.front()] != -1)
+    {
+        leg(src->location, coordOf(steps.front()), streetOf(steps.front(), via[steps.front()]));
+    }
+    for (size_t i = 1; i < size(steps); ++i)
+    {
+        auto from = steps[i - 1];
+        auto to   = steps[i];
+        if (via[to] == -1)
+        {
+            continue;
+        }
+        if (to < boundaryBase)
+        {
+            const auto &graph = fullTiles[blockOf(to)]->graph;
+            const auto &arc   = graph.arc(via[to]);
+            leg(graph.coord(arc.tail), graph.coord(arc.head), streetOf(to, arc.segment));
+        }
+        else if (!unpackShortcut(via[to], from - boundaryBase, to - boundaryBase, path))
+        {
+            return Navigator::NAV_NO_ROUTE;
+        }
+    }
+    const auto &target = targets[bestTarget];
+    if (target.segment != -1)
+    {
+        leg(coordOf(target.node), dst->location, streetOf(target.node, target.segment));
+    }
+    buildDirections(path, directions);
+    return Navigator::NAV_SUCCESS;
+}
+
+bool TiledNavigatorImpl::unpackShortcut(int tileId, int from, int to,
+                                        std::vector<StreetSegment> &path) const
+{
+    auto tile = cache_->get(tileId);
+    if (tile == nullptr)
+    {
+        return false;
+    }
+    auto localOf = [&](int b) {
+        for (const auto &slot : index_->boundarySlots[b])
+        {
+            if (slot.tile == tileId)
+            {
+                return tile->localNode[slot.position];
+            }
+        }
+        return -1;
+    };
+    auto source = localOf(from);
+    auto target = localOf(to);
+
+    const auto &graph = tile->graph;
+    auto tree = ShortestPathTree(graph);
+    tree.reset(graph.coord(target));
+    tree.addSeed(source, 0.0);
+    auto best = 0;
+    tree.growToAnchors({ Anchor{ target, 0.0, -1 } }, best);
+    if (best == -1)
+    {
+        return false;
+    }
+
+    auto arcs = std::vector<int>{};
+    for (auto node = target; node != source; node = graph.arc(arcs.back()).tail)
+    {
+        arcs.emplace_back(tree.parentArc(node));
+    }
+    for (auto a = rbegin(arcs); a != rend(arcs); ++a)
+    {
+        const auto &arc = graph.arc(*a);
+        path.emplace_back();
+        path.back().streetName = graph.streetName(graph.segment(arc.segment).streetName);
+        path.back().segment    = GeoSegment(graph.coord(arc.tail), graph.coord(arc.head));
+    }
+    return true;
+}
+
+TiledNavigator::TiledNavigator()
+    : pImpl_(new TiledNavigatorImpl)
+{
+}
+
+TiledNavigator::~TiledNavigator()
+{
+    delete pImpl_;
+}
+
+bool TiledNavigator::buildTiles(std::string mapFile, std::string directory, double tileDegrees)
+{
+    auto ml = MapLoader();
+    return ml.load(mapFile) and writeTiledMap(ml, directory, tileDegrees);
+}
+
+bool TiledNavigator::open(std::string directory, size_t memoryBudgetBytes)
+{
+    return pImpl_->open(directory, memoryBudgetBytes);
+}
+
+Navigator::NavResult TiledNavigator::navigate(std::string start, std::string end,
+                                              std::vector<NavSegment> &directions) const
+{
+    return pImpl_->navigate(start, end, directions);
+}
+
+void TiledNavigator::getTileStats(TileCacheStats &stats) const
+{
+    pImpl_->getTileStats(stats);
+}
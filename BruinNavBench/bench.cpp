@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../BruinNav/CompressedGraph.h"
+#include "../BruinNav/HubLabels.h"
+#include "../BruinNav/MemoryAccounting.h"
+#include "../BruinNav/Provided.h"
+#include "../BruinNav/ShortestPathTree.h"
+#include "../BruinNav/StreetGraph.h"
+#include "counters.h"
+
+struct BenchResult
+{
+    double    microseconds = 0.0;   // per query.
+    long long cacheMisses  = -1;    // per query, -1 if not measured.
+    double    checksum     = 0.0;   // sum of the distances found.
+};
+
+// Nodes numbered in file order, so that both graphs answer the same queries.
+struct Query
+{
+    int source;
+    int target;
+};
+
+static std::vector<int> nodesByOriginal(const StreetGraph &graph)
+{
+    auto nodes = std::vector<int>(graph.nodeCount());
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        nodes[graph.originalNode(v)] = v;
+    }
+    return nodes;
+}
+
+// Point to point: the A* ordered tree navigate's searches are built on.
+// layout is what else the tree is made from, if anything.
+template <class Tree = ShortestPathTree, class... Layout>
+static BenchResult benchPointToPoint(const StreetGraph &graph, const std::vector<Query> &queries,
+                                     const Layout &... layout)
+{
+    auto nodes   = nodesByOriginal(graph);
+    auto tree    = Tree(graph, layout...);
+    auto counter = HardwareCounter(CACHE_MISSES);
+    auto result  = BenchResult();
+    auto anchors = std::vector<Anchor>(1);
+
+    auto begin = std::chrono::steady_clock::now();
+    counter.start();
+    for (const auto &query : queries)
+    {
+        auto target = nodes[query.target];
+        anchors[0]  = { target, 0.0, -1 };
+        tree.reset(graph.coord(target));
+        tree.addSeed(nodes[query.source], 0.0);
+        auto best = -1;
+        auto distance = tree.growToAnchors(anchors, best);
+        result.checksum += best == -1 ? 0.0 : distance;
+    }
+    result.cacheMisses = counter.stop();
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    result.microseconds = std::chrono::duration<double, std::micro>(elapsed).count() / size(queries);
+    if (result.cacheMisses != -1)
+    {
+        result.cacheMisses /= static_cast<long long>(size(queries));
+    }
+    return result;
+}
+
+// One to all: a plain Dijkstra tree over the whole graph.
+template <class Tree = DijkstraTree, class... Layout>
+static BenchResult benchOneToAll(const StreetGraph &graph, const std::vector<Query> &queries,
+                                 const Layout &... layout)
+{
+    auto nodes   = nodesByOriginal(graph);
+    auto tree    = Tree(graph, layout...);
+    auto counter = HardwareCounter(CACHE_MISSES);
+    auto result  = BenchResult();
+
+    auto begin = std::chrono::steady_clock::now();
+    counter.start();
+    for (const auto &query : queries)
+    {
+        tree.reset();
+        tree.addSeed(nodes[query.source], 0.0);
+        tree.grow(std::numeric_limits<double>::max());
+        if (tree.isSettled(nodes[query.target]))
+        {
+            result.checksum += tree.distance(nodes[query.target]);
+        }
+    }
+    result.cacheMisses = counter.stop();
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    result.microseconds = std::chrono::duration<double, std::micro>(elapsed).count() / size(queries);
+    if (result.cacheMisses != -1)
+    {
+        result.cacheMisses /= static_cast<long long>(size(queries));
+    }
+    return result;
+}
+
+// Label size grows with the map, so on synthetic state-scale maps building
+// them would dominate the run; they are skipped above this many core nodes.
+static const int maxHubLabelCoreNodes = 100000;
+
+// Distance between core nodes from the hub labels, against the A* search
+// over the same pairs. Reports how long the labels take to build and hold.
+static void benchHubLabels(const StreetGraph &graph, int nQueries)
+{
+    if (graph.coreNodeCount() > maxHubLabelCoreNodes)
+    {
+        std::printf("hub labels: skipped, %d core nodes\n", graph.coreNodeCount());
+        return;
+    }
+    auto buildBegin = std::chrono::steady_clock::now();
+    auto labels     = HubLabels(graph);
+    auto buildTime  = std::chrono::steady_clock::now() - buildBegin;
+    std::printf("hub labels: %d core nodes, %.1f entries per label, %.2f MB, built in %.1f ms\n",
+                labels.coreNodeCount(),
+                static_cast<double>(labels.entryCount()) / labels.coreNodeCount(),
+                labels.memoryBytes() / (1024.0 * 1024.0),
+                std::chrono::duration<double, std::milli>(buildTime).count());
+
+    auto coreNodes = std::vector<int>{};
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        if (graph.isCore(v))
+        {
+            coreNodes.emplace_back(v);
+        }
+    }
+    auto random  = std::mt19937(20180316);
+    auto anyCore = std::uniform_int_distribution<size_t>(0, size(coreNodes) - 1);
+    auto queries = std::vector<Query>(nQueries);
+    for (auto &query : queries)
+    {
+        query = { coreNodes[anyCore(random)], coreNodes[anyCore(random)] };
+    }
+
+    auto labelBegin  = std::chrono::steady_clock::now();
+    auto labelSum    = 0.0;
+    for (const auto &query : queries)
+    {
+        auto distance = labels.distance(query.source, query.target);
+        labelSum += distance == std::numeric_limits<double>::infinity() ? 0.0 : distance;
+    }
+    auto labelTime   = std::chrono::steady_clock::now() - labelBegin;
+
+    auto tree        = ShortestPathTree(graph);
+    auto anchors     = std::vector<Anchor>(1);
+    auto searchBegin = std::chrono::steady_clock::now();
+    auto searchSum   = 0.0;
+    for (const auto &query : queries)
+    {
+        anchors[0] = { query.target, 0.0, -1 };
+        tree.reset(graph.coord(query.target));
+        tree.addSeed(query.source, 0.0);
+        auto best = -1;
+        auto distance = tree.growToAnchors(anchors, best);
+        searchSum += best == -1 ? 0.0 : distance;
+    }
+    auto searchTime  = std::chrono::steady_clock::now() - searchBegin;
+
+    std::printf("%-16s %12.3f us by labels %12.1f us by search   %s\n", "core distance",
+                std::chrono::duration<double, std::micro>(labelTime).count() / nQueries,
+                std::chrono::duration<double, std::micro>(searchTime).count() / nQueries,
+                std::fabs(labelSum - searchSum) <= 1e-9 * searchSum ? "same" : "DIFFERENT");
+}
+
+// Arcs of the graph against its compressed layout: what they hold, and how
+// fast the same searches run on each. Compressed lengths are rounded, so
+// distances differ by a few millionths of a mile. The Navigator itself does
+// not use the compressed layout yet; see CompressedGraph.h.
+static void benchLayouts(const char *order, const StreetGraph &graph,
+                         const std::vector<Query> &pointQueries,
+                         const std::vector<Query> &allQueries)
+{
+    using CompressedAStar    = SearchTree<FocusBound, Forward, ArcLength, QuaternaryHeap,
+                                          DenseLabels, CompressedArcs>;
+    using CompressedDijkstra = SearchTree<NoBound, Forward, ArcLength, QuaternaryHeap,
+                                          DenseLabels, CompressedArcs>;
+    auto buildBegin = std::chrono::steady_clock::now();
+    auto compressed = CompressedGraph(graph);
+    auto buildTime  = std::chrono::steady_clock::now() - buildBegin;
+    auto flatBytes  = sizeof(int) * (graph.nodeCount() + 1.0) + sizeof(Arc) * graph.arcCount();
+    std::printf("%s order: arcs %.2f MB flat, %.2f MB compressed (%.2f bytes per arc "
+                "in blocks), built in %.1f ms\n", order, flatBytes / (1024.0 * 1024.0),
+                compressed.memoryBytes() / (1024.0 * 1024.0),
+                static_cast<double>(compressed.arcBytes()) / graph.arcCount(),
+                std::chrono::duration<double, std::milli>(buildTime).count());
+
+    auto line = [](const char *name, const BenchResult &flat, const BenchResult &packed) {
+        std::printf("%-16s %12.1f %12.1f %14lld %14lld   %.2g\n", name, flat.microseconds,
+                    packed.microseconds, flat.cacheMisses, packed.cacheMisses,
+                    std::fabs(flat.checksum - packed.checksum) / std::max(flat.checksum, 1e-9));
+    };
+    std::printf("%-16s %12s %12s %14s %14s   %s\n", "query", "flat us", "packed us",
+                "flat misses", "packed misses", "relative difference");
+    line("point to point", benchPointToPoint(graph, pointQueries),
+         benchPointToPoint<CompressedAStar>(graph, pointQueries, compressed));
+    line("one to all", benchOneToAll(graph, allQueries),
+         benchOneToAll<CompressedDijkstra>(graph, allQueries, compressed));
+}
+
+static void report(const char *name, const BenchResult &before, const BenchResult &after)
+{
+    std::printf("%-16s %12.1f %12.1f %14lld %14lld   %s\n", name,
+                before.microseconds, after.microseconds, before.cacheMisses,
+                after.cacheMisses,
+                std::fabs(before.checksum - after.checksum) <= 1e-9 * before.checksum
+                    ? "same" : "DIFFERENT");
+}
+
+// Usage: bench [mapdata.txt] [queries]
+// Compares node numbering in file order against Hilbert order on the same
+// queries, then the search kernel's open and visited sets, then the flat
+// arcs against the compressed layout, then hub labels against search for
+// distances alone. Cache misses read -1 where hardware counters are not
+// available. Maps of any size come from mapgen.
+int main(int argc, char *argv[])
+{
+    auto mapFile  = std::string(argc > 1 ? argv[1] : "mapdata.txt");
+    auto nQueries = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+    auto ml = MapLoader();
+    if (!ml.load(mapFile))
+    {
+        std::fprintf(stderr, "cannot load %s\n", mapFile.c_str());
+        return 1;
+    }
+    if (!memoryHooksInstalled())
+    {
+        std::fprintf(stderr, "sizes read 0 unless built with BRUINNAV_MEMORY_HOOKS defined\n");
+    }
+
+    auto loadBegin   = std::chrono::steady_clock::now();
+    auto fileOrder   = StreetGraph(ml, FILE_ORDER);
+    auto loadMiddle  = std::chrono::steady_clock::now();
+    auto hilbertOrder = StreetGraph(ml, HILBERT_ORDER);
+    auto loadEnd     = std::chrono::steady_clock::now();
+
+    auto random  = std::mt19937(20180315);
+    auto anyNode = std::uniform_int_distribution<int>(0, fileOrder.nodeCount() - 1);
+    auto pointQueries = std::vector<Query>(nQueries);
+    for (auto &query : pointQueries)
+    {
+        query = { anyNode(random), anyNode(random) };
+    }
+    auto allQueries = std::vector<Query>(pointQueries.begin(),
+        pointQueries.begin() + std::max(1, nQueries / 20));
+
+    std::printf("%d nodes, %d arcs; graph built in %.1f ms (file order), %.1f ms (Hilbert order)\n",
+                fileOrder.nodeCount(), fileOrder.arcCount(),
+                std::chrono::duration<double, std::milli>(loadMiddle - loadBegin).count(),
+                std::chrono::duration<double, std::milli>(loadEnd - loadMiddle).count());
+    std::printf("%-16s %12s %12s %14s %14s   %s\n", "query", "file us", "hilbert us",
+                "file misses", "hilbert misses", "distances");
+
+    // Warm up both graphs once before measuring.
+    benchPointToPoint(fileOrder, allQueries);
+    benchPointToPoint(hilbertOrder, allQueries);
+
+    report("point to point", benchPointToPoint(fileOrder, pointQueries),
+           benchPointToPoint(hilbertOrder, pointQueries));
+    report("one to all", benchOneToAll(fileOrder, allQueries),
+           benchOneToAll(hilbertOrder, allQueries));
+
+    // The same kernel with other open and visited sets, on the Hilbert order.
+    std::printf("%-16s %12s %12s %12s\n", "query", "4-ary us", "binary us", "sparse us");
+    auto variants = [&](const char *name, const BenchResult &quaternary,
+                        const BenchResult &binary, const BenchResult &sparse) {
+        auto same = quaternary.checksum == binary.checksum and
+                    quaternary.checksum == sparse.checksum;
+        std::printf("%-16s %12.1f %12.1f %12.1f   %s\n", name, quaternary.microseconds,
+                    binary.microseconds, sparse.microseconds, same ? "same" : "DIFFERENT");
+    };
+    variants("point to point", benchPointToPoint(hilbertOrder, pointQueries),
+             benchPointToPoint<SearchTree<FocusBound, Forward, ArcLength, BinaryHeap>>(
+                 hilbertOrder, pointQueries),
+             benchPointToPoint<SearchTree<FocusBound, Forward, ArcLength, QuaternaryHeap,
+                                          SparseLabels>>(hilbertOrder, pointQueries));
+    variants("one to all", benchOneToAll(hilbertOrder, allQueries),
+             benchOneToAll<SearchTree<NoBound, Forward, ArcLength, BinaryHeap>>(
+                 hilbertOrder, allQueries),
+             benchOneToAll<SearchTree<NoBound, Forward, ArcLength, QuaternaryHeap,
+                                      SparseLabels>>(hilbertOrder, allQueries));
+
+    // Compression relies on nodes close on the map having close numbers.
+    benchLayouts("file", fileOrder, pointQueries, allQueries);
+    benchLayouts("Hilbert", hilbertOrder, pointQueries, allQueries);
+
+    benchHubLabels(hilbertOrder, nQueries);
+    return 0;
+}
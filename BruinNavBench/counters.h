@@ -0,0 +1,96 @@
+#pragma once
+
+// Hardware event counters of the bench and replay tools.
+
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum HardwareEvent
+{
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    INSTRUCTIONS,
+    CYCLES
+};
+
+// Hardware event counter of the calling thread and, with allThreads, of
+// the threads it starts afterwards once they have exited. Reads -1 where
+// the platform or the kernel's perf_event_paranoid setting does not allow it.
+class HardwareCounter
+{
+public:
+    HardwareCounter(const HardwareCounter &other)          = delete;
+    HardwareCounter &operator=(const HardwareCounter &rhs) = delete;
+
+public:
+    explicit HardwareCounter(HardwareEvent event = CACHE_MISSES, bool allThreads = false)
+    {
+#ifdef __linux__
+        static const unsigned long long configs[] = {
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES
+        };
+        auto attr = perf_event_attr();
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.config         = configs[event];
+        attr.disabled       = 1;
+        attr.inherit        = allThreads ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)event;
+        (void)allThreads;
+#endif
+    }
+
+    ~HardwareCounter()
+    {
+#ifdef __linux__
+        if (fd_ != -1)
+        {
+            close(fd_);
+        }
+#endif
+    }
+
+    inline bool isAvailable() const { return fd_ != -1; }
+
+    void start()
+    {
+#ifdef __linux__
+        if (fd_ != -1)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop()
+    {
+        auto count = -1ll;
+#ifdef __linux__
+        if (fd_ != -1)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count))
+            {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
@@ -0,0 +1,39 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "../BruinNav/MapGenerator.h"
+
+// Usage: mapgen out.txt [segments] [grid|organic] [street names]
+//               [attractions per segment] [islands] [seed]
+// Writes a synthetic map in the mapdata.txt format, to run the bench, the
+// server or the tests on maps of any size: mapgen big.txt 1000000 organic.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: mapgen out.txt [segments] [grid|organic] [street names] "
+                             "[attractions per segment] [islands] [seed]\n");
+        return 2;
+    }
+    auto spec = SyntheticMapSpec();
+    if (argc > 2) spec.segments              = std::stoll(argv[2]);
+    if (argc > 3) spec.layout                = std::string(argv[3]) == "organic"
+                                               ? ORGANIC_LAYOUT : GRID_LAYOUT;
+    if (argc > 4) spec.streetNames           = std::stoi(argv[4]);
+    if (argc > 5) spec.attractionsPerSegment = std::stod(argv[5]);
+    if (argc > 6) spec.islands               = std::stoi(argv[6]);
+    if (argc > 7) spec.seed                  = static_cast<unsigned>(std::stoul(argv[7]));
+
+    auto out   = std::ofstream(argv[1]);
+    auto stats = writeSyntheticMap(spec, out);
+    out.close();
+    if (!out)
+    {
+        std::fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+    std::printf("%s: %lld segments, %lld nodes, %lld attractions\n",
+                argv[1], stats.segments, stats.nodes, stats.attractions);
+    return 0;
+}
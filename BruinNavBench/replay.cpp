@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../BruinNav/Provided.h"
+#include "../BruinNav/QueryLog.h"
+#include "counters.h"
+
+using replayClock = std::chrono::steady_clock;
+
+// Latencies in nanoseconds, as an HDR histogram keeps them: exact below
+// 256, then in buckets 1/128 of a power of two wide, so percentiles are
+// within 0.8% over the whole range at a fixed size.
+class HdrHistogram
+{
+public:
+    static const int subBits = 8;
+    static const int half    = 1 << (subBits - 1);
+
+    HdrHistogram() : counts_((64 - subBits + 2) * half, 0) {}
+
+    void record(long long nanoseconds)
+    {
+        auto value = static_cast<unsigned long long>(std::max(0ll, nanoseconds));
+        ++counts_[indexOf(value)];
+        ++total_;
+        max_ = std::max(max_, nanoseconds);
+    }
+
+    void add(const HdrHistogram &other)
+    {
+        for (size_t i = 0; i < size(counts_); ++i)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        max_    = std::max(max_, other.max_);
+    }
+
+    // Highest value of the bucket holding the given fraction of the samples.
+    long long percentile(double fraction) const
+    {
+        auto wanted = static_cast<long long>(fraction * total_ + 0.5);
+        auto seen   = 0ll;
+        for (int i = 0; i < static_cast<int>(size(counts_)); ++i)
+        {
+            seen += counts_[i];
+            if (seen >= std::max(1ll, wanted))
+            {
+                return std::min(highestOf(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    inline long long count() const { return total_; }
+    inline long long max() const { return max_; }
+
+private:
+    static int indexOf(unsigned long long value)
+    {
+        auto shift = 0;
+        while ((value >> shift) >= (1ull << subBits))
+        {
+            ++shift;
+        }
+        return shift * half + static_cast<int>(value >> shift);
+    }
+
+    static long long highestOf(int index)
+    {
+        if (index < 2 * half)
+        {
+            return index;
+        }
+        auto shift = index / half - 1;
+        auto sub   = static_cast<long long>(index - shift * half);
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::vector<long long> counts_;
+    long long              total_ = 0;
+    long long              max_   = 0;
+};
+
+static void printLatencies(const char *what, const HdrHistogram &latencies)
+{
+    std::printf("%-9s p50 %9.1f us   p99 %9.1f us   p999 %9.1f us   max %9.1f us\n", what,
+                latencies.percentile(0.50) / 1000.0, latencies.percentile(0.99) / 1000.0,
+                latencies.percentile(0.999) / 1000.0, latencies.max() / 1000.0);
+}
+
+// Usage: replay [mapdata.txt] [queries.log] [threads] [qps | log]
+// Plays back a log recorded by Navigator::startQueryLog: as fast as the
+// threads go by default, at a fixed rate of queries per second, or with
+// the pauses of the log. At a rate, latencies count from when each query
+// was due, so a query held up behind slow ones is charged the wait.
+int main(int argc, char *argv[])
+{
+    auto mapFile  = std::string(argc > 1 ? argv[1] : "mapdata.txt");
+    auto logFile  = std::string(argc > 2 ? argv[2] : "queries.log");
+    auto nThreads = argc > 3 ? std::stoi(argv[3]) : 1;
+    auto pacing   = std::string(argc > 4 ? argv[4] : "0");
+    auto asLogged = pacing == "log";
+    auto qps      = asLogged ? 0.0 : std::stod(pacing);
+
+    auto queries = std::vector<LoggedQuery>{};
+    if (!readQueryLog(logFile, queries) or queries.empty())
+    {
+        std::fprintf(stderr, "no queries in %s\n", logFile.c_str());
+        return 1;
+    }
+    if (asLogged)
+    {
+        std::stable_sort(begin(queries), end(queries),
+            [](const LoggedQuery &a, const LoggedQuery &b) {
+                return a.offsetMicros < b.offsetMicros;
+            });
+    }
+    auto navigator = Navigator();
+    auto loadBegin = replayClock::now();
+    if (!navigator.loadMapData(mapFile))
+    {
+        std::fprintf(stderr, "cannot load %s\n", mapFile.c_str());
+        return 1;
+    }
+    std::printf("loaded %s in %.0f ms; %zu queries in %s\n", mapFile.c_str(),
+        std::chrono::duration<double, std::milli>(replayClock::now() - loadBegin).count(),
+        size(queries), logFile.c_str());
+    auto recorded = HdrHistogram();
+    for (const auto &query : queries)
+    {
+        recorded.record(query.latencyNanos);
+    }
+    printLatencies("recorded", recorded);
+
+    // Opened before the threads start, so they count those too.
+    auto cacheMisses  = HardwareCounter(CACHE_MISSES, true);
+    auto branchMisses = HardwareCounter(BRANCH_MISSES, true);
+    auto instructions = HardwareCounter(INSTRUCTIONS, true);
+
+    auto latencies  = std::vector<HdrHistogram>(nThreads);
+    auto mismatches = std::atomic<long long>(0);
+    auto next       = std::atomic<size_t>(0);
+    auto firstDue   = queries.front().offsetMicros;
+    auto started    = replayClock::now();
+    auto replay     = [&](HdrHistogram &latency) {
+        auto route = CompactRoute();
+        for (auto i = next++; i < size(queries); i = next++)
+        {
+            const auto &query = queries[i];
+            auto sent = replayClock::now();
+            if (asLogged or qps > 0.0)
+            {
+                auto due = started + std::chrono::duration_cast<replayClock::duration>(
+                    asLogged ? std::chrono::duration<double, std::micro>(query.offsetMicros -
+                                                                         firstDue)
+                             : std::chrono::duration<double, std::micro>(1e6 * i / qps));
+                std::this_thread::sleep_until(due);
+                sent = due;
+            }
+            auto result = navigator.navigate(query.start, query.end, route);
+            latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                replayClock::now() - sent).count());
+            if (result != query.result)
+            {
+                ++mismatches;
+            }
+        }
+    };
+
+    cacheMisses.start();
+    branchMisses.start();
+    instructions.start();
+    auto threads = std::vector<std::thread>{};
+    for (int t = 0; t < nThreads; ++t)
+    {
+        threads.emplace_back(replay, std::ref(latencies[t]));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    auto seconds = std::chrono::duration<double>(replayClock::now() - started).count();
+    auto counts  = std::vector<long long>{ cacheMisses.stop(), branchMisses.stop(),
+                                           instructions.stop() };
+
+    auto total = HdrHistogram();
+    for (const auto &latency : latencies)
+    {
+        total.add(latency);
+    }
+    std::printf("replayed %lld queries on %d threads in %.2f s: %.0f qps", total.count(),
+                nThreads, seconds, total.count() / seconds);
+    if (asLogged)
+    {
+        std::printf(" (paced as logged)\n");
+    }
+    else if (qps > 0.0)
+    {
+        std::printf(" (target %.0f)\n", qps);
+    }
+    else
+    {
+        std::printf("\n");
+    }
+    printLatencies("replayed", total);
+    std::printf("results differing from the log: %lld\n", mismatches.load());
+
+    const char *names[] = { "cache misses", "branch misses", "instructions" };
+    for (size_t c = 0; c < size(counts); ++c)
+    {
+        if (counts[c] == -1)
+        {
+            std::printf("%s: not available\n", names[c]);
+        }
+        else
+        {
+            std::printf("%s: %.0f per query\n", names[c],
+                        static_cast<double>(counts[c]) / total.count());
+        }
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../BruinNav/Provided.h"
+#include "protocol.h"
+
+using loadClock = std::chrono::steady_clock;
+
+struct ClientResult
+{
+    std::vector<double> latencies;  // microseconds, one per reply.
+    long long           nErrors = 0;
+    bool                failed  = false;
+};
+
+// Reads one reply, skipping the NavSegment lines of a successful NAV.
+static bool readReply(LineChannel &channel, std::string &status, bool &ok)
+{
+    if (!channel.readLine(status))
+    {
+        return false;
+    }
+    ok = status.compare(0, 3, "OK\t") == 0 or status == "OK";
+    auto fields = std::vector<std::string>{};
+    splitFields(status, fields);
+    auto nLines = ok and size(fields) == 3 ? std::stoi(fields[1]) : 0;
+    auto line   = std::string();
+    for (int i = 0; i < nLines; ++i)
+    {
+        if (!channel.readLine(line))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Closed loop: each client keeps `depth` navigations in flight on its own
+// connection, between random pairs of attractions, until the time is up.
+static void runClient(const std::string &socketPath, const std::vector<std::string> &names,
+                      int depth, loadClock::time_point stopAt, unsigned seed,
+                      ClientResult &result)
+{
+    auto fd = connectTo(socketPath);
+    if (fd == -1)
+    {
+        result.failed = true;
+        return;
+    }
+    auto channel = LineChannel(fd);
+    auto random  = std::mt19937(seed);
+    auto anyName = std::uniform_int_distribution<size_t>(0, size(names) - 1);
+    auto status  = std::string();
+    auto sentAt  = std::vector<loadClock::time_point>{};
+    while (loadClock::now() < stopAt)
+    {
+        auto batch = std::string();
+        sentAt.clear();
+        for (int i = 0; i < depth; ++i)
+        {
+            batch += "NAV\t" + names[anyName(random)] + "\t" + names[anyName(random)] + "\n";
+        }
+        auto now = loadClock::now();
+        sentAt.assign(depth, now);
+        if (!channel.writeAll(batch))
+        {
+            result.failed = true;
+            return;
+        }
+        for (int i = 0; i < depth; ++i)
+        {
+            auto ok = false;
+            if (!readReply(channel, status, ok))
+            {
+                result.failed = true;
+                return;
+            }
+            result.nErrors += ok ? 0 : 1;
+            result.latencies.emplace_back(std::chrono::duration<double, std::micro>(
+                loadClock::now() - sentAt[i]).count());
+        }
+    }
+}
+
+// Usage: loadgen [mapdata.txt] [socket path] [clients] [seconds] [depth]
+// Drives a running server with random navigations, taking the attraction
+// names from the map file, and reports throughput, latency percentiles
+// and the server's own STATS line.
+int main(int argc, char *argv[])
+{
+    auto mapFile    = std::string(argc > 1 ? argv[1] : "mapdata.txt");
+    auto socketPath = std::string(argc > 2 ? argv[2] : defaultSocketPath);
+    auto nClients   = argc > 3 ? std::stoi(argv[3]) : 8;
+    auto seconds    = argc > 4 ? std::stod(argv[4]) : 5.0;
+    auto depth      = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    auto ml = MapLoader();
+    if (!ml.load(mapFile))
+    {
+        std::fprintf(stderr, "cannot load %s\n", mapFile.c_str());
+        return 1;
+    }
+    auto names  = std::vector<std::string>{};
+    auto street = StreetSegment();
+    for (size_t i = 0; i < ml.getNumSegments(); ++i)
+    {
+        ml.getSegment(i, street);
+        for (const auto &address : street.attractionsOnThisSegment)
+        {
+            names.emplace_back(address.attraction);
+        }
+    }
+    if (names.empty())
+    {
+        std::fprintf(stderr, "no attractions in %s\n", mapFile.c_str());
+        return 1;
+    }
+
+    auto results = std::vector<ClientResult>(nClients);
+    auto clients = std::vector<std::thread>{};
+    auto begin   = loadClock::now();
+    auto stopAt  = begin + std::chrono::duration_cast<loadClock::duration>(
+                               std::chrono::duration<double>(seconds));
+    for (int c = 0; c < nClients; ++c)
+    {
+        clients.emplace_back(runClient, std::cref(socketPath), std::cref(names), depth, stopAt,
+                             20180315u + c, std::ref(results[c]));
+    }
+    for (auto &client : clients)
+    {
+        client.join();
+    }
+    auto elapsed = std::chrono::duration<double>(loadClock::now() - begin).count();
+
+    auto latencies = std::vector<double>{};
+    auto nErrors   = 0ll;
+    auto nFailed   = 0;
+    for (const auto &result : results)
+    {
+        latencies.insert(end(latencies), result.latencies.begin(), result.latencies.end());
+        nErrors += result.nErrors;
+        nFailed += result.failed ? 1 : 0;
+    }
+    if (latencies.empty())
+    {
+        std::fprintf(stderr, "no replies from %s\n", socketPath.c_str());
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double fraction) {
+        auto rank = static_cast<size_t>(fraction * (size(latencies) - 1));
+        return latencies[rank];
+    };
+
+    std::printf("%d clients, depth %d, %.1f s: %zu replies (%lld not OK), %d clients failed\n",
+                nClients, depth, elapsed, size(latencies), nErrors, nFailed);
+    std::printf("%.0f queries/s; latency us p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+                size(latencies) / elapsed, percentile(0.50), percentile(0.90),
+                percentile(0.99), percentile(0.999), latencies.back());
+
+    auto fd = connectTo(socketPath);
+    if (fd != -1)
+    {
+        auto channel = LineChannel(fd);
+        auto status  = std::string();
+        if (channel.writeAll("STATS\n") and channel.readLine(status))
+        {
+            std::printf("server: %s\n", status.c_str());
+        }
+    }
+    return 0;
+}
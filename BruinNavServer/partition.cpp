@@ -0,0 +1,153 @@
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../BruinNav/PartitionedRouting.h"
+#include "../BruinNav/Provided.h"
+#include "../BruinNav/TiledMap.h"
+#include "partition.h"
+#include "protocol.h"
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+static int usage()
+{
+    std::fprintf(stderr,
+        "usage: partition split <mapdata.txt> <tiles directory> [tile degrees]\n"
+        "       partition worker <tiles directory> <partition> <partitions> "
+        "[socket prefix] [memory budget MB]\n"
+        "       partition route <tiles directory> <partitions> [socket prefix]\n");
+    return 2;
+}
+
+// Serves one partition until SIGINT or SIGTERM.
+static int runWorker(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        return usage();
+    }
+    auto index = TileIndex();
+    if (!readTileIndex(argv[2], index))
+    {
+        std::fprintf(stderr, "cannot read %s\n", argv[2]);
+        return 1;
+    }
+    auto partition   = std::stoi(argv[3]);
+    auto nPartitions = std::stoi(argv[4]);
+    auto prefix      = std::string(argc > 5 ? argv[5] : defaultPartitionPrefix);
+    auto budget      = static_cast<size_t>(argc > 6 ? std::stod(argv[6]) : 1024.0) << 20;
+    auto worker      = PartitionWorker(index, partition, nPartitions, budget);
+
+    auto socketPath = partitionSocketPath(prefix, partition);
+    auto listener   = listenOn(socketPath);
+    if (listener == -1)
+    {
+        std::fprintf(stderr, "cannot listen on %s: %s\n", socketPath.c_str(),
+                     std::strerror(errno));
+        return 1;
+    }
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::printf("partition %d of %d listening on %s\n", partition, nPartitions,
+                socketPath.c_str());
+    std::fflush(stdout);
+
+    servePartition(worker, listener, stopRequested);
+    close(listener);
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+// Routes each "start<TAB>end" line of stdin through the partitions, with
+// the latency of every round trip.
+static int runCoordinator(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        return usage();
+    }
+    auto index = TileIndex();
+    if (!readTileIndex(argv[2], index))
+    {
+        std::fprintf(stderr, "cannot read %s\n", argv[2]);
+        return 1;
+    }
+    auto nPartitions = std::stoi(argv[3]);
+    auto remote      = RemotePartitions(argc > 4 ? argv[4] : defaultPartitionPrefix, nPartitions);
+    auto coordinator = PartitionCoordinator(index, nPartitions, remote.link());
+    std::signal(SIGPIPE, SIG_IGN);
+
+    auto line       = std::string();
+    auto fields     = std::vector<std::string>{};
+    auto directions = std::vector<NavSegment>{};
+    auto hops       = std::vector<PartitionHop>{};
+    while (std::getline(std::cin, line))
+    {
+        splitFields(line, fields);
+        if (size(fields) != 2)
+        {
+            std::printf("expected: start<TAB>end\n");
+            continue;
+        }
+        auto begin  = std::chrono::steady_clock::now();
+        auto result = coordinator.navigate(fields[0], fields[1], directions, hops);
+        auto total  = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - begin).count();
+        auto miles  = 0.0;
+        for (const auto &navSeg : directions)
+        {
+            miles += navSeg.getDistance();
+        }
+        std::printf("%s -> %s: %s, %.6f miles, %zu directions, %zu hops in %.0f us\n",
+                    fields[0].c_str(), fields[1].c_str(),
+                    result == Navigator::NAV_SUCCESS ? "ok" : "failed",
+                    result == Navigator::NAV_SUCCESS ? miles : 0.0,
+                    result == Navigator::NAV_SUCCESS ? size(directions) : size_t(0),
+                    size(hops), total);
+        for (const auto &hop : hops)
+        {
+            std::printf("    %s tile %d on partition %d: %.0f us\n", hop.command.c_str(),
+                        hop.tile, hop.partition, hop.microseconds);
+        }
+        std::fflush(stdout);
+    }
+    return 0;
+}
+
+// Routing with the map spread over several processes (PartitionedRouting.h):
+//     partition split mapdata.txt tiles 0.005
+//     partition worker tiles 0 2 &
+//     partition worker tiles 1 2 &
+//     printf 'Drake Stadium\tDiddy Riese\n' | partition route tiles 2
+int main(int argc, char *argv[])
+{
+    auto mode = std::string(argc > 1 ? argv[1] : "");
+    if (mode == "split" and argc > 3)
+    {
+        if (!TiledNavigator::buildTiles(argv[2], argv[3], argc > 4 ? std::stod(argv[4]) : 0.01))
+        {
+            std::fprintf(stderr, "cannot split %s into %s\n", argv[2], argv[3]);
+            return 1;
+        }
+        return 0;
+    }
+    if (mode == "worker")
+    {
+        return runWorker(argc, argv);
+    }
+    if (mode == "route")
+    {
+        return runCoordinator(argc, argv);
+    }
+    return usage();
+}
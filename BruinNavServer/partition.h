@@ -0,0 +1,150 @@
+#pragma once
+
+// The partition protocol of PartitionedRouting.h over Unix domain sockets,
+// one socket per partition. POSIX only, like protocol.h.
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#include "../BruinNav/PartitionedRouting.h"
+#include "protocol.h"
+
+const char *const defaultPartitionPrefix = "/tmp/bruinnav-partition";
+
+inline std::string partitionSocketPath(const std::string &prefix, int partition)
+{
+    return prefix + "." + std::to_string(partition) + ".sock";
+}
+
+/**
+ *  Answers the requests of every connection accepted on listener, each on
+ *  a thread of its own, until stop is set.
+ */
+inline void servePartition(const PartitionWorker &worker, int listener,
+                           const volatile std::sig_atomic_t &stop)
+{
+    struct Client
+    {
+        std::thread         thread;
+        std::atomic<bool>   done{ false };
+    };
+    auto clientMutex = std::mutex();
+    auto clientFds   = std::vector<int>{};
+    auto clients     = std::list<Client>{};
+    auto reapClients = [&](bool all) {
+        for (auto client = begin(clients); client != end(clients); )
+        {
+            if (all or client->done)
+            {
+                client->thread.join();
+                client = clients.erase(client);
+            }
+            else
+            {
+                ++client;
+            }
+        }
+    };
+    while (!stop)
+    {
+        reapClients(false);
+        auto waiting = pollfd{ listener, POLLIN, 0 };
+        if (poll(&waiting, 1, 200) <= 0)
+        {
+            continue;
+        }
+        auto fd = accept(listener, nullptr, nullptr);
+        if (fd == -1)
+        {
+            continue;
+        }
+
+        auto lock = std::lock_guard<std::mutex>(clientMutex);
+        clientFds.emplace_back(fd);
+        clients.emplace_back();
+        auto &client = clients.back();
+        client.thread = std::thread([&, fd]() {
+            {
+                auto channel = LineChannel(fd);
+                auto request = std::string();
+                auto reply   = std::string();
+                while (channel.readLine(request))
+                {
+                    worker.answer(request, reply);
+                    if (!channel.writeAll(reply))
+                    {
+                        break;
+                    }
+                }
+                auto lock = std::lock_guard<std::mutex>(clientMutex);
+                clientFds.erase(std::find(begin(clientFds), end(clientFds), fd));
+            }
+            client.done = true;
+        });
+    }
+
+    {
+        auto lock = std::lock_guard<std::mutex>(clientMutex);
+        for (auto fd : clientFds)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    reapClients(true);
+}
+
+// The link of a coordinator to its partitions, each connected on first use
+// and again after a failure.
+class RemotePartitions
+{
+public:
+    RemotePartitions(const RemotePartitions &other)          = delete;
+    RemotePartitions &operator=(const RemotePartitions &rhs) = delete;
+
+public:
+    RemotePartitions(const std::string &prefix, int nPartitions)
+        : prefix_(prefix), channels_(nPartitions)
+    {
+    }
+
+    bool call(int partition, const std::string &request, std::string &reply)
+    {
+        auto &channel = channels_[partition];
+        if (channel == nullptr)
+        {
+            auto fd = connectTo(partitionSocketPath(prefix_, partition));
+            if (fd == -1)
+            {
+                return false;
+            }
+            channel = std::make_unique<LineChannel>(fd);
+        }
+        if (!channel->writeAll(request + "\n") or !channel->readLine(reply))
+        {
+            channel.reset();
+            return false;
+        }
+        return true;
+    }
+
+    // The link to give a PartitionCoordinator; this must outlive it.
+    PartitionLink link()
+    {
+        return [this](int partition, const std::string &request, std::string &reply) {
+            return call(partition, request, reply);
+        };
+    }
+
+private:
+    std::string                                 prefix_;
+    std::vector<std::unique_ptr<LineChannel>>   channels_;
+};
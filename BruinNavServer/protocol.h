@@ -0,0 +1,177 @@
+#pragma once
+
+// Line protocol of the BruinNav server, shared with its load generator.
+// POSIX only: requests travel over a Unix domain socket.
+//
+// Every request is one line of tab-separated fields:
+//     NAV <start> <end>       directions from one attraction to another
+//     GEO <attraction>        location of an attraction
+//     STATS                   counters of the server since it started
+// Replies start with a status line, "OK" or "ERR <reason>" followed by
+// their fields:
+//     NAV    OK <lines> <miles>, then one line per NavSegment:
+//                proceed <direction> <street> <miles>
+//                turn    <direction> <street>
+//     GEO    OK <latitude> <longitude>
+//     STATS  OK <name>=<value> ...
+// A client may send several requests before reading the replies; they are
+// answered in order.
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const char *const defaultSocketPath = "/tmp/bruinnav.sock";
+
+// Buffered reads of whole lines from a socket, and unbuffered writes.
+class LineChannel
+{
+public:
+    LineChannel(const LineChannel &other)          = delete;
+    LineChannel &operator=(const LineChannel &rhs) = delete;
+
+public:
+    explicit LineChannel(int fd) : fd_(fd) {}
+
+    ~LineChannel()
+    {
+        if (fd_ != -1)
+        {
+            close(fd_);
+        }
+    }
+
+    inline int fd() const { return fd_; }
+
+    // True if a whole line has already been received.
+    inline bool hasLine() const { return buffer_.find('\n', start_) != std::string::npos; }
+
+    // Blocks for the next line, without its '\n'. False once the peer is gone.
+    bool readLine(std::string &line)
+    {
+        for (;;)
+        {
+            auto end = buffer_.find('\n', start_);
+            if (end != std::string::npos)
+            {
+                line.assign(buffer_, start_, end - start_);
+                start_ = end + 1;
+                return true;
+            }
+
+            buffer_.erase(0, start_);
+            start_ = 0;
+            char chunk[65536];
+            auto nRead = recv(fd_, chunk, sizeof(chunk), 0);
+            if (nRead < 0 and errno == EINTR)
+            {
+                continue;
+            }
+            if (nRead <= 0)
+            {
+                return false;
+            }
+            buffer_.append(chunk, static_cast<size_t>(nRead));
+        }
+    }
+
+    bool writeAll(const std::string &data)
+    {
+        auto sent = size_t(0);
+        while (sent < size(data))
+        {
+            auto nSent = send(fd_, data.data() + sent, size(data) - sent, MSG_NOSIGNAL);
+            if (nSent < 0 and errno == EINTR)
+            {
+                continue;
+            }
+            if (nSent <= 0)
+            {
+                return false;
+            }
+            sent += static_cast<size_t>(nSent);
+        }
+        return true;
+    }
+
+private:
+    int         fd_;
+    std::string buffer_;
+    size_t      start_ = 0;
+};
+
+// Splits a line at its tabs.
+inline void splitFields(const std::string &line, std::vector<std::string> &fields)
+{
+    fields.clear();
+    auto start = size_t(0);
+    for (;;)
+    {
+        auto tab = line.find('\t', start);
+        fields.emplace_back(line, start, tab == std::string::npos ? std::string::npos
+                                                                  : tab - start);
+        if (tab == std::string::npos)
+        {
+            return;
+        }
+        start = tab + 1;
+    }
+}
+
+// Fills the address of a Unix domain socket. False if path is too long.
+inline bool socketAddress(const std::string &path, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (size(path) >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), size(path) + 1);
+    return true;
+}
+
+// A socket connected to path, or -1.
+inline int connectTo(const std::string &path)
+{
+    auto address = sockaddr_un();
+    if (!socketAddress(path, address))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1 and connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// A socket listening on path, replacing any file there, or -1.
+inline int listenOn(const std::string &path)
+{
+    auto address = sockaddr_un();
+    if (!socketAddress(path, address))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (fd != -1 and
+        (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 or
+         listen(fd, SOMAXCONN) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#include "../BruinNav/Provided.h"
+#include "protocol.h"
+
+using serverClock = std::chrono::steady_clock;
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+// Latencies kept in buckets a quarter of a power of two wide, so that
+// percentiles are within 19% and recording is one atomic increment.
+class LatencyHistogram
+{
+public:
+    static const int nBuckets = 4 * 40;
+
+    void record(double microseconds)
+    {
+        auto bucket = microseconds < 1.0 ? 0 : static_cast<int>(4.0 * std::log2(microseconds));
+        ++counts_[std::min(bucket, nBuckets - 1)];
+    }
+
+    // Upper bound of the bucket holding the given fraction of the samples.
+    double percentile(double fraction) const
+    {
+        auto total = 0ll;
+        for (const auto &count : counts_)
+        {
+            total += count;
+        }
+        auto wanted = static_cast<long long>(std::ceil(fraction * total));
+        auto seen   = 0ll;
+        for (int bucket = 0; bucket < nBuckets; ++bucket)
+        {
+            seen += counts_[bucket];
+            if (seen >= wanted and seen > 0)
+            {
+                return std::exp2((bucket + 1) / 4.0);
+            }
+        }
+        return 0.0;
+    }
+
+private:
+    std::atomic<long long> counts_[nBuckets] = {};
+};
+
+struct ServerStats
+{
+    serverClock::time_point started = serverClock::now();
+    std::atomic<long long>  connections{ 0 };
+    std::atomic<long long>  requests{ 0 };
+    std::atomic<long long>  batches{ 0 };
+    std::atomic<long long>  results[Navigator::NAV_CANCELLED + 1] = {};
+    LatencyHistogram        navLatency;
+};
+
+static const char *resultName(Navigator::NavResult result)
+{
+    switch (result)
+    {
+    case Navigator::NAV_SUCCESS:         return "success";
+    case Navigator::NAV_BAD_SOURCE:      return "bad_source";
+    case Navigator::NAV_BAD_DESTINATION: return "bad_destination";
+    case Navigator::NAV_NO_ROUTE:        return "no_route";
+    case Navigator::NAV_TIMEOUT:         return "timeout";
+    case Navigator::NAV_CANCELLED:       return "cancelled";
+    }
+    return "unknown";
+}
+
+struct ServerOptions
+{
+    std::string mapFile    = "mapdata.txt";
+    std::string socketPath = defaultSocketPath;
+    double      timeoutMs  = 1000.0;
+    std::string queryLog;               // recorded for the replay tool if set.
+};
+
+// One connection. Every request already received is read as one batch: its
+// navigations are all queued on the navigator's workers before the first
+// reply is written, then the replies go back in order.
+class Connection
+{
+public:
+    Connection(const Navigator &navigator, const ServerOptions &options,
+               ServerStats &stats, int fd)
+        : navigator_(navigator), options_(options), stats_(stats), channel_(fd)
+    {
+    }
+
+    void serve()
+    {
+        auto line = std::string();
+        while (channel_.readLine(line))
+        {
+            pending_.clear();
+            addRequest(line);
+            while (channel_.hasLine() and channel_.readLine(line))
+            {
+                addRequest(line);
+            }
+            ++stats_.batches;
+
+            auto reply = std::string();
+            for (auto &request : pending_)
+            {
+                writeReply(request, reply);
+            }
+            if (!channel_.writeAll(reply))
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    struct Request
+    {
+        bool                    isNavigation = false;
+        std::string             reply;          // for requests answered at once.
+        std::future<AsyncRoute> route;
+        serverClock::time_point received;
+    };
+
+    void addRequest(const std::string &line)
+    {
+        ++stats_.requests;
+        splitFields(line, fields_);
+        pending_.emplace_back();
+        auto &request = pending_.back();
+        request.received = serverClock::now();
+
+        if (fields_[0] == "NAV" and size(fields_) == 3)
+        {
+            auto timeout = std::chrono::duration<double, std::milli>(options_.timeoutMs);
+            request.isNavigation = true;
+            request.route = navigator_.navigateAsync(fields_[1], fields_[2],
+                request.received + std::chrono::duration_cast<serverClock::duration>(timeout));
+        }
+        else if (fields_[0] == "GEO" and size(fields_) == 2)
+        {
+            auto gc = GeoCoord();
+            request.reply = navigator_.getGeoCoord(fields_[1], gc)
+                ? "OK\t" + gc.sLatitude + "\t" + gc.sLongitude + "\n"
+                : std::string("ERR\tbad_attraction\n");
+        }
+        else if (fields_[0] == "STATS" and size(fields_) == 1)
+        {
+            request.reply = statsLine();
+        }
+        else
+        {
+            request.reply = "ERR\tbad_request\n";
+        }
+    }
+
+    void writeReply(Request &request, std::string &reply)
+    {
+        if (!request.isNavigation)
+        {
+            reply += request.reply;
+            return;
+        }
+
+        auto answer = request.route.get();
+        ++stats_.results[answer.result];
+        if (answer.result != Navigator::NAV_SUCCESS)
+        {
+            reply += "ERR\t";
+            reply += resultName(answer.result);
+            reply += "\n";
+        }
+        else
+        {
+            navigator_.getNavSegments(answer.route, directions_);
+            auto miles = 0.0;
+            for (const auto &navSeg : directions_)
+            {
+                miles += navSeg.getDistance();
+            }
+            appendf(reply, "OK\t%zu\t%.6f\n", size(directions_), miles);
+            for (const auto &navSeg : directions_)
+            {
+                if (navSeg.getCommandType() == NavSegment::turn)
+                {
+                    reply += "turn\t" + navSeg.getDirection() + "\t" + navSeg.getStreet() + "\n";
+                }
+                else
+                {
+                    reply += "proceed\t" + navSeg.getDirection() + "\t" + navSeg.getStreet();
+                    appendf(reply, "\t%.6f\n", navSeg.getDistance());
+                }
+            }
+        }
+        auto elapsed = serverClock::now() - request.received;
+        stats_.navLatency.record(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+
+    std::string statsLine() const
+    {
+        auto uptime = std::chrono::duration<double>(serverClock::now() - stats_.started).count();
+        auto line   = std::string("OK");
+        appendf(line, "\tuptime_s=%.1f\tconnections=%lld\trequests=%lld\tbatches=%lld",
+                uptime, stats_.connections.load(), stats_.requests.load(),
+                stats_.batches.load());
+        for (int result = 0; result <= Navigator::NAV_CANCELLED; ++result)
+        {
+            appendf(line, "\t%s=%lld", resultName(static_cast<Navigator::NavResult>(result)),
+                    stats_.results[result].load());
+        }
+        appendf(line, "\tnav_p50_us=%.0f\tnav_p99_us=%.0f\n",
+                stats_.navLatency.percentile(0.50), stats_.navLatency.percentile(0.99));
+        return line;
+    }
+
+    template <typename... Args>
+    static void appendf(std::string &out, const char *format, Args... args)
+    {
+        char text[256];
+        auto length = std::snprintf(text, sizeof(text), format, args...);
+        out.append(text, static_cast<size_t>(std::max(0, std::min<int>(length, sizeof(text) - 1))));
+    }
+
+private:
+    const Navigator            &navigator_;
+    const ServerOptions        &options_;
+    ServerStats                &stats_;
+    LineChannel                 channel_;
+    std::vector<std::string>    fields_;
+    std::vector<Request>        pending_;
+    std::vector<NavSegment>     directions_;
+};
+
+// Thread serving one connection; done once it may be joined without waiting.
+struct Client
+{
+    std::thread         thread;
+    std::atomic<bool>   done{ false };
+};
+
+// Usage: server [mapdata.txt] [socket path] [timeout ms] [query log]
+// Loads the map once and answers the requests of protocol.h until SIGINT or
+// SIGTERM. Navigations run on the navigator's own pool of workers.
+int main(int argc, char *argv[])
+{
+    auto options = ServerOptions();
+    if (argc > 1) options.mapFile    = argv[1];
+    if (argc > 2) options.socketPath = argv[2];
+    if (argc > 3) options.timeoutMs  = std::stod(argv[3]);
+    if (argc > 4) options.queryLog   = argv[4];
+
+    auto navigator = Navigator();
+    auto loadBegin = serverClock::now();
+    if (!navigator.loadMapData(options.mapFile))
+    {
+        std::fprintf(stderr, "cannot load %s\n", options.mapFile.c_str());
+        return 1;
+    }
+    std::printf("loaded %s in %.0f ms\n", options.mapFile.c_str(),
+        std::chrono::duration<double, std::milli>(serverClock::now() - loadBegin).count());
+    if (!options.queryLog.empty() and !navigator.startQueryLog(options.queryLog))
+    {
+        std::fprintf(stderr, "cannot write %s\n", options.queryLog.c_str());
+        return 1;
+    }
+
+    auto listener = listenOn(options.socketPath);
+    if (listener == -1)
+    {
+        std::fprintf(stderr, "cannot listen on %s: %s\n", options.socketPath.c_str(),
+                     std::strerror(errno));
+        return 1;
+    }
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::printf("listening on %s\n", options.socketPath.c_str());
+    std::fflush(stdout);
+
+    auto stats       = ServerStats();
+    auto clientMutex = std::mutex();
+    auto clientFds   = std::vector<int>{};
+    auto clients     = std::list<Client>{};
+    auto reapClients = [&](bool all) {
+        for (auto client = begin(clients); client != end(clients); )
+        {
+            if (all or client->done)
+            {
+                client->thread.join();
+                client = clients.erase(client);
+            }
+            else
+            {
+                ++client;
+            }
+        }
+    };
+    while (!stopRequested)
+    {
+        reapClients(false);
+        auto waiting = pollfd{ listener, POLLIN, 0 };
+        if (poll(&waiting, 1, 200) <= 0)
+        {
+            continue;
+        }
+        auto fd = accept(listener, nullptr, nullptr);
+        if (fd == -1)
+        {
+            continue;
+        }
+
+        ++stats.connections;
+        auto lock = std::lock_guard<std::mutex>(clientMutex);
+        clientFds.emplace_back(fd);
+        clients.emplace_back();
+        auto &client = clients.back();
+        client.thread = std::thread([&, fd]() {
+            {
+                auto connection = Connection(navigator, options, stats, fd);
+                connection.serve();
+                auto lock = std::lock_guard<std::mutex>(clientMutex);
+                clientFds.erase(std::find(begin(clientFds), end(clientFds), fd));
+            }
+            client.done = true;
+        });
+    }
+
+    // Wake the connections up so they finish, then let the navigator go.
+    {
+        auto lock = std::lock_guard<std::mutex>(clientMutex);
+        for (auto fd : clientFds)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    reapClients(true);
+    close(listener);
+    unlink(options.socketPath.c_str());
+    return 0;
+}
@@ -1,10 +1,32 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "../BruinNav/CompressedGraph.h"
+#include "../BruinNav/GeoKernels.h"
+#include "../BruinNav/MapGenerator.h"
+#include "../BruinNav/MemoryAccounting.h"
+#include "../BruinNav/QueryLog.h"
 #include "../BruinNav/Provided.h"
+#include "../BruinNav/ShortestPathTree.h"
+#include "../BruinNav/StreetGraph.h"
 #include "../BruinNav/Support.h"
 
+#ifndef _WIN32
+#include <csignal>
+#include <sys/wait.h>
+#include "../BruinNav/PartitionedRouting.h"
+#include "../BruinNavServer/partition.h"
+#endif
+
 // static objects which will be loaded with real data.
 static MapLoader        static_MapLoader;
 static SegmentMapper    static_SegmentMapper;
@@ -80,6 +102,51 @@ protected:
     AttractionMapper attractionMapper_;
 };
 
+class GeoKernelsTest : public ::testing::Test
+{
+protected:
+    GeoKernelsTest()
+    {
+    }
+
+    ~GeoKernelsTest() override
+    {
+    }
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override
+    {
+    }
+
+protected:
+    std::vector<double> latitudes_;
+    std::vector<double> longitudes_;
+    std::vector<double> cosLatitudes_;
+};
+
+class StreetGraphTest : public ::testing::Test
+{
+protected:
+    StreetGraphTest()
+    {
+    }
+
+    ~StreetGraphTest() override
+    {
+    }
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override
+    {
+    }
+};
+
 class NavigatorTest : public ::testing::Test
 {
 protected:
@@ -200,6 +267,221 @@ TEST_F(AttractionMapperTest, initAndGetGeoCoord)
     EXPECT_EQ(gc, GeoCoord("34.0711829", "-118.4492444"));
 }
 
+// The vectorized bound must never exceed distanceEarthKM (A* relies on it)
+// and must stay within a part per million of it on real street segments.
+TEST_F(GeoKernelsTest, boundDistancesAgainstDistanceEarthKM)
+{
+    auto street = StreetSegment();
+    auto target = GeoCoord("34.0613323", "-118.4461140");
+    auto nSegments = static_MapLoader.getNumSegments();
+    ASSERT_GT(nSegments, 0);
+    for (size_t i = 0; i < nSegments; ++i)
+    {
+        static_MapLoader.getSegment(i, street);
+        auto lat1 = deg2rad(street.segment.start.latitude);
+        auto lat2 = deg2rad(street.segment.end.latitude);
+        auto bound = boundDistance(lat1, deg2rad(street.segment.start.longitude), cos(lat1),
+                                   lat2, deg2rad(street.segment.end.longitude), cos(lat2),
+                                   earthDiameterKm);
+        auto exact = distanceEarthKM(street.segment.start, street.segment.end);
+        EXPECT_LE(bound, exact * (1 + 1e-12));
+        EXPECT_GE(bound, exact * (1 - 1e-6));
+
+        latitudes_.push_back(lat1);
+        longitudes_.push_back(deg2rad(street.segment.start.longitude));
+        cosLatitudes_.push_back(cos(lat1));
+    }
+
+    // Odd count so both the vector loop and the scalar tail are exercised.
+    auto n = static_cast<int>(size(latitudes_)) | 1;
+    latitudes_.resize(n, latitudes_[0]);
+    longitudes_.resize(n, longitudes_[0]);
+    cosLatitudes_.resize(n, cosLatitudes_[0]);
+    auto bounds = std::vector<double>(n);
+    auto targetLat = deg2rad(target.latitude);
+    boundDistances(latitudes_.data(), longitudes_.data(), cosLatitudes_.data(), n,
+                   targetLat, deg2rad(target.longitude), cos(targetLat),
+                   earthDiameterKm, bounds.data());
+    for (int i = 0; i < n; ++i)
+    {
+        static_MapLoader.getSegment(static_cast<size_t>(i) < nSegments ? i : 0, street);
+        auto exact = distanceEarthKM(street.segment.start, target);
+        EXPECT_LE(bounds[i], exact * (1 + 1e-12));
+        EXPECT_GE(bounds[i], exact * (1 - 1e-6));
+    }
+}
+
+// Renumbering along the Hilbert curve renames nodes, nothing else.
+TEST_F(StreetGraphTest, hilbertOrderKeepsNodes)
+{
+    auto fileOrder    = StreetGraph(static_MapLoader, FILE_ORDER);
+    auto hilbertOrder = StreetGraph(static_MapLoader, HILBERT_ORDER);
+    ASSERT_EQ(fileOrder.nodeCount(), hilbertOrder.nodeCount());
+    ASSERT_GT(hilbertOrder.nodeCount(), 0);
+
+    auto nFar = 0;
+    for (int v = 0; v < hilbertOrder.nodeCount(); ++v)
+    {
+        auto original = hilbertOrder.originalNode(v);
+        EXPECT_EQ(fileOrder.originalNode(original), original);
+        EXPECT_EQ(hilbertOrder.coord(v), fileOrder.coord(original));
+        EXPECT_EQ(hilbertOrder.findNode(hilbertOrder.coord(v)), v);
+        EXPECT_EQ(hilbertOrder.firstArc(v + 1) - hilbertOrder.firstArc(v),
+                  fileOrder.firstArc(original + 1) - fileOrder.firstArc(original));
+        if (v > 0 and distanceEarthMiles(hilbertOrder.coord(v - 1), hilbertOrder.coord(v)) > 1.0)
+        {
+            ++nFar;
+        }
+    }
+    // Consecutive nodes are neighbours on the map.
+    EXPECT_LT(nFar, hilbertOrder.nodeCount() / 100);
+}
+
+// Chains leaving core nodes cover every arc exactly once, and attractions
+// in the middle of a segment keep both its ends addressable.
+TEST_F(StreetGraphTest, chainsCoverEveryArc)
+{
+    auto graph = StreetGraph(static_MapLoader);
+    ASSERT_GT(graph.coreNodeCount(), 0);
+    EXPECT_LT(graph.coreNodeCount(), graph.nodeCount() / 2);
+
+    auto onChain     = std::vector<int>(graph.arcCount(), 0);
+    auto chainLength = 0.0;
+    auto arcLength   = 0.0;
+    for (int a = 0; a < graph.arcCount(); ++a)
+    {
+        arcLength += graph.arc(a).length;
+        if (!graph.isCore(graph.arc(a).tail))
+        {
+            continue;
+        }
+        auto last = a;
+        ++onChain[last];
+        while (last != graph.chainLast(a))
+        {
+            EXPECT_FALSE(graph.isCore(graph.arc(last).head));
+            last = graph.nextChainArc(last);
+            ++onChain[last];
+        }
+        EXPECT_EQ(graph.arc(last).head, graph.chainHead(a));
+        EXPECT_TRUE(graph.isCore(graph.chainHead(a)));
+        chainLength += graph.chainLength(a);
+    }
+    for (int a = 0; a < graph.arcCount(); ++a)
+    {
+        EXPECT_EQ(onChain[a], 1);
+    }
+    EXPECT_NEAR(chainLength, arcLength, 1e-9 * arcLength);
+
+    auto gc = GeoCoord();
+    ASSERT_TRUE(static_AttractionMapper.getGeoCoord("1061 Broxton Avenue", gc));
+    auto anchors = std::vector<Anchor>{};
+    graph.anchorsOf(gc, anchors);
+    ASSERT_FALSE(anchors.empty());
+    for (const auto &anchor : anchors)
+    {
+        EXPECT_TRUE(graph.isCore(anchor.node));
+    }
+}
+
+// Every combination of search policies settles the same distances, and a
+// backward tree's parent arcs lead to its root in the direction of travel.
+TEST_F(StreetGraphTest, searchTreeVariants)
+{
+    auto graph = StreetGraph(static_MapLoader);
+    auto dijkstra = DijkstraTree(graph);
+    auto binary   = SearchTree<NoBound, Forward, ArcLength, BinaryHeap>(graph);
+    auto sparse   = SearchTree<NoBound, Forward, ArcLength, QuaternaryHeap, SparseLabels>(graph);
+    auto backward = SearchTree<NoBound, Backward>(graph);
+    auto aStar    = ShortestPathTree(graph);
+    auto anchors  = std::vector<Anchor>(1);
+    for (auto root : { 0, graph.nodeCount() / 3, graph.nodeCount() - 1 })
+    {
+        dijkstra.reset();
+        binary.reset();
+        sparse.reset();
+        backward.reset();
+        dijkstra.addSeed(root, 0.0);
+        binary.addSeed(root, 0.0);
+        sparse.addSeed(root, 0.0);
+        backward.addSeed(root, 0.0);
+        dijkstra.grow(std::numeric_limits<double>::max());
+        binary.grow(std::numeric_limits<double>::max());
+        sparse.grow(std::numeric_limits<double>::max());
+        backward.grow(std::numeric_limits<double>::max());
+        ASSERT_GT(size(dijkstra.settledNodes()), 1u);
+
+        for (int v = 0; v < graph.nodeCount(); v += 97)
+        {
+            ASSERT_EQ(dijkstra.isSettled(v), sparse.isSettled(v));
+            if (!dijkstra.isSettled(v))
+            {
+                continue;
+            }
+            EXPECT_DOUBLE_EQ(binary.distance(v), dijkstra.distance(v));
+            EXPECT_DOUBLE_EQ(sparse.distance(v), dijkstra.distance(v));
+            EXPECT_DOUBLE_EQ(backward.distance(v), dijkstra.distance(v));
+
+            auto length = 0.0;
+            for (auto node = v; node != root; node = graph.arc(backward.parentArc(node)).head)
+            {
+                ASSERT_EQ(graph.arc(backward.parentArc(node)).tail, node);
+                length += graph.arc(backward.parentArc(node)).length;
+            }
+            EXPECT_NEAR(length, dijkstra.distance(v), 1e-9);
+
+            aStar.reset(graph.coord(v));
+            aStar.addSeed(root, 0.0);
+            anchors[0] = { v, 0.0, -1 };
+            auto best = -1;
+            EXPECT_NEAR(aStar.growToAnchors(anchors, best), dijkstra.distance(v), 1e-9);
+            EXPECT_EQ(best, 0);
+        }
+    }
+}
+
+// The compressed layout decodes the graph's arcs, lengths to the quantum,
+// and a search over it settles the same distances as near.
+TEST_F(StreetGraphTest, compressedGraph)
+{
+    auto graph      = StreetGraph(static_MapLoader);
+    auto compressed = CompressedGraph(graph);
+    ASSERT_EQ(compressed.nodeCount(), graph.nodeCount());
+    EXPECT_LT(compressed.arcBytes(), 5u * graph.arcCount());
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        auto next = graph.firstArc(v);
+        compressed.forEachArc(v, [&](int a, int head, double length) {
+            ASSERT_EQ(a, next++);
+            EXPECT_EQ(head, graph.arc(a).head);
+            EXPECT_NEAR(length, graph.arc(a).length, CompressedGraph::lengthQuantum / 2);
+        });
+        EXPECT_EQ(next, graph.firstArc(v + 1));
+    }
+    for (int a = 0; a < graph.arcCount(); ++a)
+    {
+        ASSERT_EQ(compressed.streetName(a), graph.segment(graph.arc(a).segment).streetName);
+    }
+
+    auto flat   = DijkstraTree(graph);
+    auto packed = SearchTree<NoBound, Forward, ArcLength, QuaternaryHeap, DenseLabels,
+                             CompressedArcs>(graph, compressed);
+    flat.reset();
+    packed.reset();
+    flat.addSeed(0, 0.0);
+    packed.addSeed(0, 0.0);
+    flat.grow(std::numeric_limits<double>::max());
+    packed.grow(std::numeric_limits<double>::max());
+    for (int v = 0; v < graph.nodeCount(); ++v)
+    {
+        ASSERT_EQ(packed.isSettled(v), flat.isSettled(v));
+        if (flat.isSettled(v))
+        {
+            EXPECT_NEAR(packed.distance(v), flat.distance(v), 1e-4);
+        }
+    }
+}
+
 TEST_F(NavigatorTest, loadMapData)
 {
     EXPECT_TRUE(static_Navigator.loadMapData("mapdata.txt"));
@@ -287,6 +569,1070 @@ TEST_F(NavigatorTest, testFromSpecs)
     }
 }
 
+// A heavy penalty on left turns should route around them,
+// at the price of a slightly longer drive.
+TEST_F(NavigatorTest, turnPenalties)
+{
+    auto countTurns = [](const std::vector<NavSegment> &directions,
+                         const std::string &turnDirection) {
+        auto nTurns = 0;
+        for (const auto &navSeg : directions)
+        {
+            if (navSeg.getCommandType() == NavSegment::NAV_COMMAND::turn and
+                navSeg.getDirection() == turnDirection)
+            {
+                ++nTurns;
+            }
+        }
+        return nTurns;
+    };
+
+    navigator_.loadMapData("mapdata.txt");
+    auto penalties = TurnPenalties();
+    penalties.streetChange = 1e-9;
+    navigator_.setTurnPenalties(penalties);
+    EXPECT_EQ(navigator_.navigate("Drake Stadium", "Robertson Playground", directions_),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_GT(countTurns(directions_, "left"), 0);
+
+    penalties.left = 0.5;
+    navigator_.setTurnPenalties(penalties);
+    EXPECT_EQ(navigator_.navigate("Drake Stadium", "Robertson Playground", directions_),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(countTurns(directions_, "left"), 0);
+}
+
+// The compact route carries ids and enums; its strings are built on demand
+// and the same buffers can be reused for the next query.
+TEST_F(NavigatorTest, compactRoute)
+{
+    auto route = CompactRoute();
+    EXPECT_EQ(static_Navigator.navigate("Drake Stadium", "Robertson Playground", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(static_Navigator.navigate("1061 Broxton Avenue", "Headlines", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(route.destination, GeoCoord("34.0602020", "-118.4462382"));
+
+    static_Navigator.getNavSegments(route, directions_);
+    ASSERT_EQ(size(directions_), size(route.segments));
+    auto prevEnd = GeoCoord();
+    for (size_t i = 0; i < size(directions_); ++i)
+    {
+        const auto &navSeg = route.segments[i];
+        EXPECT_EQ(directions_[i].getCommandType(), navSeg.command);
+        EXPECT_EQ(directions_[i].getDirection(), navSeg.getDirection());
+        EXPECT_EQ(directions_[i].getStreet(), static_Navigator.getStreetName(navSeg.streetName));
+        if (navSeg.command == NavSegment::NAV_COMMAND::proceed)
+        {
+            if (i > 0)
+            {
+                EXPECT_EQ(directions_[i].getSegment().start, prevEnd);
+            }
+            prevEnd = directions_[i].getSegment().end;
+        }
+    }
+    EXPECT_EQ(directions_.back().getSegment().end, route.destination);
+}
+
+// Alternatives come shortest first, within the stretch limit,
+// and never repeat a route already returned.
+TEST_F(NavigatorTest, alternativeRoutes)
+{
+    auto routeLength = [](const CompactRoute &route) {
+        auto length = 0.0;
+        for (const auto &navSeg : route.segments)
+        {
+            length += navSeg.distance;
+        }
+        return length;
+    };
+
+    auto shortest = CompactRoute();
+    auto routes   = std::vector<CompactRoute>{};
+    auto limits   = AlternativeLimits();
+    EXPECT_EQ(static_Navigator.navigate("Drake Stadium", "Robertson Playground", shortest),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(static_Navigator.navigateAlternatives("Drake Stadium", "Robertson Playground",
+                                                    limits, routes),
+              Navigator::NavResult::NAV_SUCCESS);
+    ASSERT_EQ(size(routes), 3);
+    EXPECT_NEAR(routeLength(routes[0]), routeLength(shortest), 1e-9);
+    for (size_t i = 1; i < size(routes); ++i)
+    {
+        EXPECT_LE(routeLength(routes[i]), (1 + limits.maxStretch) * routeLength(routes[0]));
+        EXPECT_NE(routeLength(routes[i]), routeLength(routes[i - 1]));
+    }
+    // Each route shares at most maxOverlap of its length with those before it.
+    auto taken = std::vector<std::pair<int, int>>{};
+    for (const auto &route : routes)
+    {
+        auto shared = 0.0;
+        for (const auto &navSeg : route.segments)
+        {
+            auto ends = std::make_pair(std::min(navSeg.startNode, navSeg.endNode),
+                                       std::max(navSeg.startNode, navSeg.endNode));
+            if (std::find(begin(taken), end(taken), ends) != end(taken))
+            {
+                shared += navSeg.distance;
+            }
+        }
+        EXPECT_LE(shared, limits.maxOverlap * routeLength(route));
+        for (const auto &navSeg : route.segments)
+        {
+            if (navSeg.command == NavSegment::proceed and navSeg.startNode != -1 and
+                navSeg.endNode != -1)
+            {
+                taken.emplace_back(std::min(navSeg.startNode, navSeg.endNode),
+                                   std::max(navSeg.startNode, navSeg.endNode));
+            }
+        }
+    }
+
+    limits.maxRoutes = 1;
+    EXPECT_EQ(static_Navigator.navigateAlternatives("1031 Broxton Avenue", "1037 Broxton Avenue",
+                                                    limits, routes),
+              Navigator::NavResult::NAV_SUCCESS);
+    ASSERT_EQ(size(routes), 1);
+    EXPECT_EQ(size(routes[0].segments), 1);
+}
+
+// The trip visits every stop once, comes back to the depot,
+// and is no longer than visiting the stops in the order given.
+TEST_F(NavigatorTest, planTrip)
+{
+    auto stops = std::vector<std::string>{ "Robertson Playground", "1031 Broxton Avenue",
+                                           "Headlines", "Novel Cafe Westwood",
+                                           "1061 Broxton Avenue", "2000 Avenue of the Stars" };
+    auto order      = std::vector<int>{};
+    auto directions = std::vector<NavSegment>{};
+    EXPECT_EQ(static_Navigator.planTrip("Drake Stadium", stops, TripOptions(), order,
+                                        directions),
+              Navigator::NavResult::NAV_SUCCESS);
+
+    auto visited = order;
+    std::sort(begin(visited), end(visited));
+    EXPECT_EQ(visited, (std::vector<int>{ 0, 1, 2, 3, 4, 5 }));
+
+    auto route = CompactRoute();
+    static_Navigator.navigate("Headlines", "Drake Stadium", route);
+    ASSERT_FALSE(directions.empty());
+    EXPECT_EQ(directions.back().getSegment().end, route.destination);
+
+    auto tripLength = 0.0;
+    for (const auto &navSeg : directions)
+    {
+        tripLength += navSeg.getDistance();
+    }
+    auto givenLength = 0.0;
+    auto sequence = stops;
+    sequence.insert(begin(sequence), "Drake Stadium");
+    sequence.emplace_back("Drake Stadium");
+    for (size_t i = 1; i < size(sequence); ++i)
+    {
+        EXPECT_EQ(static_Navigator.navigate(sequence[i - 1], sequence[i], route),
+                  Navigator::NavResult::NAV_SUCCESS);
+        for (const auto &navSeg : route.segments)
+        {
+            givenLength += navSeg.distance;
+        }
+    }
+    EXPECT_LE(tripLength, givenLength + 1e-9);
+
+    stops.emplace_back("Not An Attraction");
+    EXPECT_EQ(static_Navigator.planTrip("Drake Stadium", stops, TripOptions(), order,
+                                        directions),
+              Navigator::NavResult::NAV_BAD_DESTINATION);
+}
+
+// Attractions on different islands of the map are turned down at once,
+// and the component sizes account for every street endpoint.
+TEST_F(NavigatorTest, components)
+{
+    auto sizes = std::vector<int>{};
+    static_Navigator.getComponentSizes(sizes);
+    ASSERT_GT(size(sizes), 1);
+    for (size_t c = 1; c < size(sizes); ++c)
+    {
+        EXPECT_LE(sizes[c], sizes[c - 1]);
+    }
+    auto nNodes = 0;
+    for (auto componentSize : sizes)
+    {
+        nNodes += componentSize;
+    }
+    EXPECT_EQ(nNodes, StreetGraph(static_MapLoader).nodeCount());
+
+    EXPECT_EQ(static_Navigator.getComponent("Drake Stadium"), 0);
+    EXPECT_EQ(static_Navigator.getComponent("1031 Broxton Avenue"), 0);
+    EXPECT_GT(static_Navigator.getComponent("Powell Library"), 0);
+    EXPECT_EQ(static_Navigator.getComponent("Nowhere In Particular"), -1);
+
+    auto route  = CompactRoute();
+    auto routes = std::vector<CompactRoute>{};
+    EXPECT_EQ(static_Navigator.navigate("Drake Stadium", "Powell Library", directions_),
+              Navigator::NavResult::NAV_NO_ROUTE);
+    EXPECT_EQ(static_Navigator.navigate("Powell Library", "Drake Stadium", route),
+              Navigator::NavResult::NAV_NO_ROUTE);
+    EXPECT_EQ(static_Navigator.navigateAlternatives("Drake Stadium", "Powell Library",
+                                                    AlternativeLimits(), routes),
+              Navigator::NavResult::NAV_NO_ROUTE);
+    EXPECT_TRUE(routes.empty());
+
+    // An attraction where a street passes over another is listed by both,
+    // and can be reached from either, though they never meet.
+    std::ofstream("bridge.txt") << "Under Street\n"
+                                   "34.0000000, -118.0000000 34.0000000,-118.0020000\n"
+                                   "1\n"
+                                   "Bridge|34.0000000, -118.0010000\n"
+                                   "Over Street\n"
+                                   "33.9990000, -118.0010000 34.0010000,-118.0010000\n"
+                                   "2\n"
+                                   "Bridge|34.0000000, -118.0010000\n"
+                                   "North End|34.0010000, -118.0010000\n";
+    ASSERT_TRUE(navigator_.loadMapData("bridge.txt"));
+    navigator_.getComponentSizes(sizes);
+    EXPECT_EQ(size(sizes), 2u);
+    EXPECT_EQ(navigator_.navigate("Bridge", "North End", directions_),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(navigator_.navigate("North End", "Bridge", route),
+              Navigator::NavResult::NAV_SUCCESS);
+}
+
+// Asynchronous queries answer like navigate, and give up once past their
+// deadline or cancelled, even before a worker gets to them.
+TEST_F(NavigatorTest, navigateAsync)
+{
+    auto route = CompactRoute();
+    EXPECT_EQ(static_Navigator.navigate("Drake Stadium", "Robertson Playground", route),
+              Navigator::NavResult::NAV_SUCCESS);
+
+    auto later   = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    auto replies = std::vector<std::future<AsyncRoute>>{};
+    for (int i = 0; i < 8; ++i)
+    {
+        replies.emplace_back(static_Navigator.navigateAsync("Drake Stadium",
+                                                            "Robertson Playground", later));
+    }
+    for (auto &reply : replies)
+    {
+        auto answer = reply.get();
+        EXPECT_EQ(answer.result, Navigator::NavResult::NAV_SUCCESS);
+        EXPECT_EQ(size(answer.route.segments), size(route.segments));
+    }
+    EXPECT_EQ(static_Navigator.navigateAsync("Not An Attraction", "Drake Stadium",
+                                             later).get().result,
+              Navigator::NavResult::NAV_BAD_SOURCE);
+
+    auto earlier = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    EXPECT_EQ(static_Navigator.navigateAsync("Drake Stadium", "Robertson Playground",
+                                             earlier).get().result,
+              Navigator::NavResult::NAV_TIMEOUT);
+
+    auto token = CancellationToken();
+    token.cancel();
+    EXPECT_EQ(static_Navigator.navigateAsync("Drake Stadium", "Robertson Playground",
+                                             later, token).get().result,
+              Navigator::NavResult::NAV_CANCELLED);
+}
+
+// A reload swaps the whole map at once: queries running meanwhile finish on
+// the map they started with, and routes keep theirs for getNavSegments.
+TEST_F(NavigatorTest, reloadMapData)
+{
+    ASSERT_TRUE(navigator_.loadMapData("mapdata.txt"));
+    auto route = CompactRoute();
+    ASSERT_EQ(navigator_.navigate("Drake Stadium", "Robertson Playground", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    auto before = std::vector<NavSegment>{};
+    navigator_.getNavSegments(route, before);
+
+    auto later   = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    auto replies = std::vector<std::future<AsyncRoute>>{};
+    for (int reload = 0; reload < 3; ++reload)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            replies.emplace_back(navigator_.navigateAsync("Drake Stadium",
+                                                          "Robertson Playground", later));
+        }
+        EXPECT_TRUE(navigator_.loadMapData("mapdata.txt"));
+    }
+    for (auto &reply : replies)
+    {
+        EXPECT_EQ(reply.get().result, Navigator::NavResult::NAV_SUCCESS);
+    }
+
+    ASSERT_TRUE(navigator_.loadMapData("dummydata1.txt"));
+    EXPECT_EQ(navigator_.navigate("Drake Stadium", "Robertson Playground", directions_),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+    EXPECT_EQ(navigator_.navigate("Attraction A", "Attraction Edge1", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_FALSE(navigator_.loadMapData("not a map file"));
+    EXPECT_EQ(navigator_.navigate("Attraction A", "Attraction Edge1", route),
+              Navigator::NavResult::NAV_SUCCESS);
+
+    ASSERT_TRUE(navigator_.loadMapData("mapdata.txt"));
+    ASSERT_EQ(navigator_.navigate("Drake Stadium", "Robertson Playground", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    auto held = route;
+    ASSERT_TRUE(navigator_.loadMapData("dummydata1.txt"));
+    navigator_.getNavSegments(held, directions_);
+    ASSERT_EQ(size(directions_), size(before));
+    for (size_t i = 0; i < size(before); ++i)
+    {
+        EXPECT_EQ(directions_[i].getStreet(), before[i].getStreet());
+        EXPECT_EQ(directions_[i].getSegment().end, before[i].getSegment().end);
+    }
+}
+
+TEST_F(NavigatorTest, tiledNavigator)
+{
+    auto directory = ::testing::TempDir() + "bruinnav_tiles";
+    ASSERT_TRUE(TiledNavigator::buildTiles("mapdata.txt", directory, 0.005));
+    auto tiled = TiledNavigator();
+    ASSERT_TRUE(tiled.open(directory, 256 * 1024));
+
+    auto names = std::vector<std::string>{ "Drake Stadium", "Robertson Playground",
+        "1061 Broxton Avenue", "Headlines", "1031 Broxton Avenue", "1037 Broxton Avenue",
+        "1000 Gayley Avenue", "Novel Cafe Westwood", "Ackerman Union", "Diddy Riese" };
+    auto route = CompactRoute();
+    for (const auto &start : names)
+    {
+        for (const auto &end : names)
+        {
+            auto expected = static_Navigator.navigate(start, end, route);
+            ASSERT_EQ(tiled.navigate(start, end, directions_), expected) << start << " -> " << end;
+            if (expected != Navigator::NavResult::NAV_SUCCESS)
+            {
+                continue;
+            }
+            auto expectedMiles = 0.0;
+            for (const auto &navSeg : route.segments)
+            {
+                expectedMiles += navSeg.distance;
+            }
+            auto miles = 0.0;
+            for (const auto &navSeg : directions_)
+            {
+                miles += navSeg.getDistance();
+            }
+            EXPECT_NEAR(miles, expectedMiles, 1e-9) << start << " -> " << end;
+        }
+    }
+    EXPECT_EQ(tiled.navigate("Drake Stadium", "Powell Library", directions_),
+              Navigator::NavResult::NAV_NO_ROUTE);
+    EXPECT_EQ(tiled.navigate("Nowhere In Particular", "Drake Stadium", directions_),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+
+    auto stats = TileCacheStats();
+    tiled.getTileStats(stats);
+    EXPECT_GT(stats.misses, 0);
+    EXPECT_GT(stats.hits, 0);
+    EXPECT_GT(stats.evictions, 0);
+    EXPECT_GT(stats.residentBytes, 0u);     // with or without the allocation hooks.
+    EXPECT_TRUE(stats.residentBytes <= 256 * 1024 or stats.residentTiles == 1);
+}
+
+#ifndef _WIN32
+static volatile std::sig_atomic_t partitionStop = 0;
+
+static void stopPartition(int)
+{
+    partitionStop = 1;
+}
+
+// Partitions in processes of their own, reached over Unix sockets.
+TEST_F(NavigatorTest, partitionedRouting)
+{
+    auto directory = ::testing::TempDir() + "bruinnav_partitions";
+    ASSERT_TRUE(TiledNavigator::buildTiles("mapdata.txt", directory, 0.005));
+    auto index = TileIndex();
+    ASSERT_TRUE(readTileIndex(directory, index));
+
+    const auto nPartitions = 3;
+    auto prefix  = ::testing::TempDir() + "bruinnav_" + std::to_string(getpid());
+    auto workers = std::vector<pid_t>{};
+    for (int p = 0; p < nPartitions; ++p)
+    {
+        auto listener = listenOn(partitionSocketPath(prefix, p));
+        ASSERT_NE(listener, -1);
+        auto pid = fork();
+        if (pid == 0)
+        {
+            std::signal(SIGTERM, stopPartition);
+            auto worker = PartitionWorker(index, p, nPartitions, 64 * 1024);
+            servePartition(worker, listener, partitionStop);
+            _exit(0);
+        }
+        close(listener);
+        workers.emplace_back(pid);
+    }
+
+    auto remote      = RemotePartitions(prefix, nPartitions);
+    auto coordinator = PartitionCoordinator(index, nPartitions, remote.link());
+    auto names = std::vector<std::string>{ "Drake Stadium", "Robertson Playground",
+        "1061 Broxton Avenue", "Headlines", "1031 Broxton Avenue", "1037 Broxton Avenue",
+        "1000 Gayley Avenue", "Novel Cafe Westwood", "Ackerman Union", "Diddy Riese" };
+    auto route    = CompactRoute();
+    auto expected = std::vector<NavSegment>{};
+    auto hops     = std::vector<PartitionHop>{};
+    for (const auto &start : names)
+    {
+        for (const auto &end : names)
+        {
+            auto result = static_Navigator.navigate(start, end, route);
+            EXPECT_EQ(coordinator.navigate(start, end, directions_, hops), result)
+                << start << " -> " << end;
+            if (result != Navigator::NavResult::NAV_SUCCESS or start == end)
+            {
+                continue;
+            }
+            static_Navigator.getNavSegments(route, expected);
+            ASSERT_EQ(size(directions_), size(expected)) << start << " -> " << end;
+            for (size_t i = 0; i < size(expected); ++i)
+            {
+                const auto &got  = directions_[i];
+                const auto &want = expected[i];
+                EXPECT_EQ(got.getCommandType(), want.getCommandType()) << start << " -> " << end;
+                EXPECT_EQ(got.getStreet(), want.getStreet()) << start << " -> " << end;
+                if (want.getCommandType() != NavSegment::proceed)
+                {
+                    continue;
+                }
+                EXPECT_NEAR(got.getDistance(), want.getDistance(), 1e-9);
+                EXPECT_NEAR(got.getSegment().start.latitude, want.getSegment().start.latitude, 1e-9);
+                EXPECT_NEAR(got.getSegment().start.longitude, want.getSegment().start.longitude, 1e-9);
+                EXPECT_NEAR(got.getSegment().end.latitude, want.getSegment().end.latitude, 1e-9);
+                EXPECT_NEAR(got.getSegment().end.longitude, want.getSegment().end.longitude, 1e-9);
+            }
+            EXPECT_FALSE(hops.empty());
+            for (const auto &hop : hops)
+            {
+                EXPECT_EQ(hop.partition, partitionOf(hop.tile, nPartitions));
+                EXPECT_GE(hop.microseconds, 0.0);
+            }
+        }
+    }
+    EXPECT_EQ(coordinator.navigate("Drake Stadium", "Powell Library", directions_, hops),
+              Navigator::NavResult::NAV_NO_ROUTE);
+    EXPECT_EQ(coordinator.navigate("Nowhere In Particular", "Drake Stadium", directions_, hops),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+
+    for (int p = 0; p < nPartitions; ++p)
+    {
+        auto status = 0;
+        kill(workers[p], SIGTERM);
+        EXPECT_EQ(waitpid(workers[p], &status, 0), workers[p]);
+        EXPECT_TRUE(WIFEXITED(status));
+        unlink(partitionSocketPath(prefix, p).c_str());
+    }
+    EXPECT_EQ(coordinator.navigate("Drake Stadium", "Diddy Riese", directions_, hops),
+              Navigator::NavResult::NAV_NO_ROUTE);
+}
+#endif
+
+TEST_F(NavigatorTest, queryLog)
+{
+    auto path = ::testing::TempDir() + "bruinnav_queries.log";
+    EXPECT_FALSE(static_Navigator.startQueryLog(::testing::TempDir() + "no/such/dir/q.log"));
+    ASSERT_TRUE(static_Navigator.startQueryLog(path));
+    auto route = CompactRoute();
+    EXPECT_EQ(static_Navigator.navigate("Drake Stadium", "Diddy Riese", directions_),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(static_Navigator.navigate("Diddy Riese", "Drake Stadium", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(static_Navigator.navigate("Nowhere In Particular", "Drake Stadium", route),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+    auto async = static_Navigator.navigateAsync("Drake Stadium", "Powell Library",
+        std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    EXPECT_EQ(async.get().result, Navigator::NavResult::NAV_NO_ROUTE);
+    static_Navigator.stopQueryLog();
+    static_Navigator.navigate("Drake Stadium", "Headlines", route);
+
+    auto queries = std::vector<LoggedQuery>{};
+    ASSERT_TRUE(readQueryLog(path, queries));
+    ASSERT_EQ(size(queries), 4u);
+    EXPECT_EQ(queries[0].start, "Drake Stadium");
+    EXPECT_EQ(queries[0].end, "Diddy Riese");
+    EXPECT_EQ(queries[1].start, "Diddy Riese");
+    EXPECT_EQ(queries[2].result, Navigator::NavResult::NAV_BAD_SOURCE);
+    EXPECT_EQ(queries[3].end, "Powell Library");
+    EXPECT_EQ(queries[3].result, Navigator::NavResult::NAV_NO_ROUTE);
+    for (size_t i = 0; i < size(queries); ++i)
+    {
+        EXPECT_GT(queries[i].latencyNanos, 0);
+        EXPECT_TRUE(i == 0 or queries[i].offsetMicros >= queries[i - 1].offsetMicros);
+    }
+
+    // Names are written once: the log stays small, and a cut log keeps
+    // the queries before the cut.
+    auto file  = std::ifstream(path, std::ios::binary);
+    auto bytes = std::string(std::istreambuf_iterator<char>(file), {});
+    EXPECT_LE(size(bytes), 8u + (59u + 4 * 2) + 4 * 16u);   // magic, names, queries.
+    std::ofstream(path, std::ios::binary) << bytes.substr(0, size(bytes) - 1);
+    ASSERT_TRUE(readQueryLog(path, queries));
+    EXPECT_EQ(size(queries), 3u);
+    std::remove(path.c_str());
+}
+
+TEST_F(NavigatorTest, searchTrace)
+{
+    auto route = CompactRoute();
+    auto trace = SearchTrace();
+    ASSERT_EQ(static_Navigator.navigateTraced("Drake Stadium", "Diddy Riese", route, trace),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(trace.result, Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(trace.start, "Drake Stadium");
+    ASSERT_FALSE(trace.steps.empty());
+    for (size_t i = 1; i < size(trace.steps); ++i)
+    {
+        EXPECT_GE(trace.steps[i].f, trace.steps[i - 1].f - 1e-9);   // A* settles by f.
+        EXPECT_GE(trace.steps[i].f, trace.steps[i].g - 1e-9);
+    }
+    auto traced = 0.0;
+    for (const auto &navSeg : route.segments)
+    {
+        traced += navSeg.distance;
+    }
+    auto plain = CompactRoute();
+    ASSERT_EQ(static_Navigator.navigate("Drake Stadium", "Diddy Riese", plain),
+              Navigator::NavResult::NAV_SUCCESS);
+    auto miles = 0.0;
+    for (const auto &navSeg : plain.segments)
+    {
+        miles += navSeg.distance;
+    }
+    EXPECT_DOUBLE_EQ(traced, miles);
+    ASSERT_GE(size(trace.path), 2u);
+    EXPECT_DOUBLE_EQ(trace.path.front().latitude, route.source.latitude);
+    EXPECT_DOUBLE_EQ(trace.path.back().longitude, route.destination.longitude);
+
+    auto geoJson = std::ostringstream();
+    ASSERT_TRUE(writeSearchTrace(trace, TRACE_GEOJSON, geoJson));
+    EXPECT_EQ(geoJson.str().find("{\"type\":\"FeatureCollection\""), 0u);
+    EXPECT_NE(geoJson.str().find("\"start\":\"Drake Stadium\""), std::string::npos);
+    auto binary = std::ostringstream();
+    ASSERT_TRUE(writeSearchTrace(trace, TRACE_BINARY, binary));
+    EXPECT_EQ(size(binary.str()), 8 + 2 + 13 + 2 + 11 + 1 + 4 + 4 +
+                                  24 * size(trace.steps) + 8 * size(trace.path));
+
+    // Every second query writes a trace; the others are not traced at all.
+    auto directory = ::testing::TempDir();
+    static_Navigator.setSearchTracing(2, directory, TRACE_BINARY);
+    for (int i = 0; i < 4; ++i)
+    {
+        static_Navigator.navigate("Drake Stadium", "Diddy Riese", route);
+    }
+    static_Navigator.setSearchTracing(0, "");
+    static_Navigator.navigate("Drake Stadium", "Diddy Riese", route);
+    for (int i = 0; i < 3; ++i)
+    {
+        auto path = directory + "/trace_" + std::to_string(i) + ".bntrace";
+        EXPECT_EQ(static_cast<bool>(std::ifstream(path)), i < 2);
+        std::remove(path.c_str());
+    }
+}
+
+TEST_F(NavigatorTest, warmNavigateAllocatesNothing)
+{
+    auto names = std::vector<std::string>{ "Drake Stadium", "Robertson Playground",
+        "Brentwood Country Mart", "Diddy Riese", "The Annenberg Space for Photography",
+        "Thalians Mental Health Center", "Nowhere In Particular" };
+    auto route = CompactRoute();
+    auto miles = std::vector<double>{};
+    auto runAll = [&]() {
+        miles.clear();
+        for (const auto &start : names)
+        {
+            for (const auto &end : names)
+            {
+                auto result = static_Navigator.navigate(start, end, route);
+                auto total  = 0.0;
+                for (const auto &navSeg : route.segments)
+                {
+                    total += navSeg.distance;
+                }
+                miles.push_back(result == Navigator::NavResult::NAV_SUCCESS ? total : -1.0);
+            }
+        }
+    };
+    runAll();
+    auto firstRun = miles;
+
+    // The output buffers are as large as they will get, so the whole second
+    // run is answered from buffers the thread already has.
+    miles.reserve(size(miles));
+    if (!memoryHooksInstalled())
+    {
+        GTEST_SKIP() << "counts allocations, so needs BRUINNAV_MEMORY_HOOKS";
+    }
+    auto allocated = threadAllocations();
+    auto freed     = threadDeallocations();
+    runAll();
+    EXPECT_EQ(threadAllocations() - allocated, 0);
+    EXPECT_EQ(threadDeallocations() - freed, 0);
+    EXPECT_EQ(miles, firstRun);
+    EXPECT_GT(std::count_if(begin(miles), end(miles), [](double m) { return m > 0.0; }), 20);
+}
+
+TEST_F(NavigatorTest, reroute)
+{
+    auto milesOf = [](const CompactRoute &route) {
+        auto miles = 0.0;
+        for (const auto &navSeg : route.segments)
+        {
+            miles += navSeg.distance;
+        }
+        return miles;
+    };
+    auto planned = CompactRoute();
+    ASSERT_EQ(static_Navigator.navigate("Drake Stadium", "Diddy Riese", planned),
+              Navigator::NavResult::NAV_SUCCESS);
+    static_Navigator.getNavSegments(planned, directions_);
+    ASSERT_GE(size(directions_), 3u);
+
+    // From an intersection on the route, the rest of the route is shortest.
+    auto route = CompactRoute();
+    auto rest  = 0.0;
+    for (auto i = size(directions_); i-- > 1; )
+    {
+        rest += directions_[i].getDistance();
+        if (directions_[i - 1].getCommandType() != NavSegment::proceed)
+        {
+            continue;
+        }
+        ASSERT_EQ(static_Navigator.reroute(planned, directions_[i - 1].getSegment().end, route),
+                  Navigator::NavResult::NAV_SUCCESS);
+        EXPECT_NEAR(milesOf(route), rest, 1e-9);
+    }
+
+    // Off the route, as navigate would go; again from the tree kept, and
+    // with the new route written over the old one.
+    auto position = GeoCoord();
+    ASSERT_TRUE(static_Navigator.getGeoCoord("Robertson Playground", position));
+    auto fresh = CompactRoute();
+    ASSERT_EQ(static_Navigator.navigate("Robertson Playground", "Diddy Riese", fresh),
+              Navigator::NavResult::NAV_SUCCESS);
+    for (int i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(static_Navigator.reroute(planned, position, route),
+                  Navigator::NavResult::NAV_SUCCESS);
+        EXPECT_NEAR(milesOf(route), milesOf(fresh), 1e-9);
+    }
+    route = planned;
+    ASSERT_EQ(static_Navigator.reroute(route, position, route),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_NEAR(milesOf(route), milesOf(fresh), 1e-9);
+    EXPECT_DOUBLE_EQ(route.destination.latitude, planned.destination.latitude);
+
+    // From partway along a street of the route, a few feet off it: the rest
+    // of that street, then the rest of the route.
+    for (size_t i = 1; i + 1 < size(directions_); ++i)
+    {
+        if (directions_[i].getCommandType() != NavSegment::proceed)
+        {
+            continue;
+        }
+        const auto &gs = directions_[i].getSegment();
+        auto cosLat = cos(deg2rad(gs.start.latitude));
+        auto dy     = gs.end.latitude - gs.start.latitude;
+        auto dx     = (gs.end.longitude - gs.start.longitude) * cosLat;
+        auto off    = 0.00002 / std::hypot(dx, dy);     // across the street.
+        auto midway = GeoCoord();
+        midway.latitude  = gs.start.latitude + 0.4 * dy + off * dx;
+        midway.longitude = gs.start.longitude + (0.4 * dx - off * dy) / cosLat;
+        auto after = 0.0;
+        for (auto j = i + 1; j < size(directions_); ++j)
+        {
+            after += directions_[j].getDistance();
+        }
+        ASSERT_EQ(static_Navigator.reroute(planned, midway, route),
+                  Navigator::NavResult::NAV_SUCCESS);
+        EXPECT_NEAR(milesOf(route), 0.6 * directions_[i].getDistance() + after, 1e-5);
+        EXPECT_LT(distanceEarthMiles(route.source, midway), 0.005);
+    }
+
+    EXPECT_EQ(static_Navigator.reroute(planned, GeoCoord("1", "2"), route),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+    EXPECT_EQ(static_Navigator.reroute(CompactRoute(), position, route),
+              Navigator::NavResult::NAV_BAD_DESTINATION);
+}
+
+TEST_F(NavigatorTest, mapMatching)
+{
+    auto streetsOf = [](const std::vector<StreetSegment> &segments) {
+        auto streets = std::vector<std::string>{};
+        for (const auto &segment : segments)
+        {
+            if (streets.empty() or streets.back() != segment.streetName)
+            {
+                streets.emplace_back(segment.streetName);
+            }
+        }
+        return streets;
+    };
+    ASSERT_EQ(static_Navigator.navigate("Drake Stadium", "Diddy Riese", directions_),
+              Navigator::NavResult::NAV_SUCCESS);
+
+    // A ping every 20 yards or so along the route, each off by a few feet.
+    // The first and last legs, which lead from the attractions beside the
+    // streets rather than along them, are left out.
+    auto trace   = std::vector<GpsPing>{};
+    auto streets = std::vector<std::string>{};
+    for (size_t leg = 1; leg + 1 < size(directions_); ++leg)
+    {
+        const auto &navSeg = directions_[leg];
+        if (navSeg.getCommandType() != NavSegment::proceed)
+        {
+            continue;
+        }
+        if (streets.empty() or streets.back() != navSeg.getStreet())
+        {
+            streets.emplace_back(navSeg.getStreet());
+        }
+        const auto &gs = navSeg.getSegment();
+        auto nPings = std::max(1, static_cast<int>(navSeg.getDistance() / 0.01));
+        for (int i = 0; i < nPings; ++i)
+        {
+            auto ping  = GpsPing();
+            auto noise = (size(trace) % 2 == 0 ? 1.0 : -1.0) * 0.00002;
+            auto t     = (i + 0.5) / nPings;
+            ping.location.latitude  = gs.start.latitude + t * (gs.end.latitude - gs.start.latitude) + noise;
+            ping.location.longitude = gs.start.longitude + t * (gs.end.longitude - gs.start.longitude) - noise;
+            ping.seconds = 2.0 * size(trace);
+            trace.emplace_back(ping);
+        }
+    }
+
+    auto matched = std::vector<StreetSegment>{};
+    ASSERT_EQ(static_Navigator.matchTrace(trace, matched), Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(streetsOf(matched), streets);
+    for (size_t i = 1; i < size(matched); ++i)
+    {
+        const auto &before = matched[i - 1].segment;
+        const auto &after  = matched[i].segment;
+        EXPECT_TRUE(before.end == after.start or before.end == after.end or
+                    before.start == after.start or before.start == after.end);
+    }
+
+    // Streaming with a short lag decides the same streets.
+    auto options = MatchOptions();
+    options.maxLag = 3;
+    auto matcher   = TraceMatcher(static_Navigator, options);
+    auto streamed  = std::vector<StreetSegment>{};
+    for (const auto &ping : trace)
+    {
+        matcher.addPing(ping, streamed);
+    }
+    matcher.finish(streamed);
+    EXPECT_EQ(streetsOf(streamed), streets);
+
+    // With little detour allowed, most of the many candidates of a ping cannot
+    // be reached from the ping before; committing must pass over them.
+    auto tight = MatchOptions();
+    tight.maxCandidates = 20;
+    tight.maxDetour     = 0.02;
+    tight.maxLag        = 1;
+    auto tightMatcher   = TraceMatcher(static_Navigator, tight);
+    streamed.clear();
+    for (const auto &ping : trace)
+    {
+        tightMatcher.addPing(ping, streamed);
+    }
+    tightMatcher.finish(streamed);
+    EXPECT_EQ(streetsOf(streamed), streets);
+
+    // In parallel, each trace as alone; pings far from every street match nothing.
+    auto far = GpsPing();
+    far.location.latitude = 1.0;
+    auto traces   = std::vector<std::vector<GpsPing>>{ trace, { far }, trace };
+    auto segments = std::vector<std::vector<StreetSegment>>{};
+    auto results  = std::vector<Navigator::NavResult>{};
+    options.nThreads = 2;
+    static_Navigator.matchTraces(traces, segments, results, options);
+    ASSERT_EQ(size(results), 3u);
+    EXPECT_EQ(results[0], Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(results[1], Navigator::NavResult::NAV_NO_ROUTE);
+    EXPECT_TRUE(segments[1].empty());
+    EXPECT_EQ(streetsOf(segments[0]), streets);
+    EXPECT_EQ(size(segments[2]), size(matched));
+}
+
+TEST_F(NavigatorTest, nearestAttractions)
+{
+    auto milesOf = [](const CompactRoute &route) {
+        auto miles = 0.0;
+        for (const auto &navSeg : route.segments)
+        {
+            miles += navSeg.distance;
+        }
+        return miles;
+    };
+
+    // Closest first, each as far as networkDistance says, with its route.
+    auto found = std::vector<NearbyAttraction>{};
+    ASSERT_EQ(static_Navigator.nearestAttractions("Drake Stadium", 8, found, nullptr, true),
+              Navigator::NavResult::NAV_SUCCESS);
+    ASSERT_EQ(size(found), 8u);
+    for (size_t i = 0; i < size(found); ++i)
+    {
+        EXPECT_NE(found[i].name, "Drake Stadium");
+        EXPECT_TRUE(i == 0 or found[i - 1].miles <= found[i].miles);
+        auto miles = 0.0;
+        ASSERT_EQ(static_Navigator.networkDistance("Drake Stadium", found[i].name, miles),
+                  Navigator::NavResult::NAV_SUCCESS);
+        EXPECT_NEAR(found[i].miles, miles, 1e-9);
+        EXPECT_NEAR(milesOf(found[i].route), miles, 1e-9);
+    }
+
+    // The filter is asked once per attraction reached, and the attractions
+    // it lets through come in the same order as unfiltered.
+    auto asked  = std::vector<std::string>{};
+    auto accept = [&asked](const std::string &name) {
+        asked.emplace_back(name);
+        return name.find('a') == std::string::npos;
+    };
+    auto filtered = std::vector<NearbyAttraction>{};
+    ASSERT_EQ(static_Navigator.nearestAttractions("Drake Stadium", 3, filtered, accept),
+              Navigator::NavResult::NAV_SUCCESS);
+    ASSERT_EQ(size(filtered), 3u);
+    std::sort(begin(asked), end(asked));
+    EXPECT_EQ(std::unique(begin(asked), end(asked)), end(asked));
+    auto expected = std::vector<NearbyAttraction>{};
+    for (const auto &nearby : found)
+    {
+        if (nearby.name.find('a') == std::string::npos)
+        {
+            expected.emplace_back(nearby);
+        }
+    }
+    for (size_t i = 0; i < std::min(size(expected), size(filtered)); ++i)
+    {
+        EXPECT_EQ(filtered[i].name, expected[i].name);
+        EXPECT_TRUE(filtered[i].route.segments.empty());
+    }
+
+    EXPECT_EQ(static_Navigator.nearestAttractions("Nowhere", 3, found),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+    EXPECT_EQ(static_Navigator.nearestAttractions("Drake Stadium", 3, found,
+                  [](const std::string &) { return false; }),
+              Navigator::NavResult::NAV_NO_ROUTE);
+}
+
+TEST_F(NavigatorTest, memoryUsage)
+{
+    if (!memoryHooksInstalled())
+    {
+        GTEST_SKIP() << "counts allocations, so needs BRUINNAV_MEMORY_HOOKS";
+    }
+    auto account = MemoryAccount();
+    auto numbers = std::vector<int>{};
+    auto text    = std::string();
+    {
+        auto scope = MemoryScope(account);
+        numbers.reserve(250);
+        auto scratch = std::vector<double>(1000);
+        text.assign(100, 'x');
+    }
+    EXPECT_EQ(account.bytes(), 250 * sizeof(int) + stringBytes(text));
+    EXPECT_EQ(account.peakBytes(), account.bytes() + 1000 * sizeof(double));
+    EXPECT_EQ(account.allocations(), 3);
+    std::thread([&]() { numbers = std::vector<int>{}; }).join();
+    EXPECT_EQ(account.bytes(), stringBytes(text));
+
+    // Tiles are sized by counting, which must not fall far short of what
+    // the hooks see.
+    auto graph = StreetGraph(static_MapLoader);
+    EXPECT_LE(graph.countedBytes(), graph.memoryBytes());
+    EXPECT_GT(graph.countedBytes(), graph.memoryBytes() * 9 / 10);
+
+    ASSERT_TRUE(navigator_.loadMapData("mapdata.txt"));
+    auto usage = MemoryUsage();
+    navigator_.getMemoryUsage(usage);
+    EXPECT_TRUE(usage.measured);
+    EXPECT_GT(usage.segmentStorage, 0u);
+    EXPECT_GT(usage.segmentIndex, usage.attractionIndex);
+    EXPECT_GT(usage.attractionIndex, 0u);
+    EXPECT_GT(usage.streetGraph, 0u);
+    EXPECT_LT(usage.strings, usage.total);
+    EXPECT_EQ(usage.total, sizeof(MapSnapshot) + usage.segmentIndex + usage.attractionIndex +
+                           usage.streetGraph);
+    EXPECT_EQ(usage.navigatePeak, 0u);
+
+    auto route = CompactRoute();
+    ASSERT_EQ(navigator_.navigate("Drake Stadium", "Robertson Playground", route),
+              Navigator::NavResult::NAV_SUCCESS);
+    navigator_.getMemoryUsage(usage);
+    EXPECT_GT(usage.navigatePeak, 0u);
+    EXPECT_LT(usage.navigatePeak, usage.streetGraph);
+}
+
+TEST_F(NavigatorTest, networkDistance)
+{
+    ASSERT_TRUE(navigator_.loadMapData("mapdata.txt"));
+    auto names = std::vector<std::string>{ "Drake Stadium", "Robertson Playground",
+        "1061 Broxton Avenue", "Headlines", "1031 Broxton Avenue", "1037 Broxton Avenue",
+        "1000 Gayley Avenue", "Novel Cafe Westwood", "Ackerman Union", "Powell Library" };
+    auto pairs    = std::vector<std::pair<std::string, std::string>>{};
+    auto expected = std::vector<double>{};
+    auto route    = CompactRoute();
+    for (const auto &start : names)
+    {
+        for (const auto &end : names)
+        {
+            pairs.emplace_back(start, end);
+            expected.emplace_back(-1.0);
+            if (navigator_.navigate(start, end, route) == Navigator::NavResult::NAV_SUCCESS)
+            {
+                expected.back() = 0.0;
+                for (const auto &navSeg : route.segments)
+                {
+                    expected.back() += navSeg.distance;
+                }
+            }
+        }
+    }
+
+    // By search first, then by the labels, which must survive a reload.
+    auto usage = MemoryUsage();
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        if (pass == 1)
+        {
+            navigator_.buildHubLabels();
+            navigator_.getMemoryUsage(usage);
+            EXPECT_EQ(usage.measured, memoryHooksInstalled());
+            EXPECT_TRUE(usage.hubLabels > 0 or !usage.measured);
+        }
+        if (pass == 2)
+        {
+            ASSERT_TRUE(navigator_.loadMapData("mapdata.txt"));
+            navigator_.getMemoryUsage(usage);
+            EXPECT_EQ(usage.measured, memoryHooksInstalled());
+            EXPECT_TRUE(usage.hubLabels > 0 or !usage.measured);
+        }
+        auto miles   = std::vector<double>{};
+        auto results = std::vector<Navigator::NavResult>{};
+        navigator_.networkDistances(pairs, miles, results);
+        ASSERT_EQ(size(results), size(pairs));
+        for (size_t i = 0; i < size(pairs); ++i)
+        {
+            auto single = 0.0;
+            EXPECT_EQ(navigator_.networkDistance(pairs[i].first, pairs[i].second, single),
+                      results[i]);
+            if (expected[i] < 0.0)
+            {
+                EXPECT_EQ(results[i], Navigator::NavResult::NAV_NO_ROUTE);
+                continue;
+            }
+            ASSERT_EQ(results[i], Navigator::NavResult::NAV_SUCCESS)
+                << pairs[i].first << " -> " << pairs[i].second;
+            EXPECT_NEAR(miles[i], expected[i], 1e-9) << pairs[i].first << " -> " << pairs[i].second;
+            EXPECT_EQ(single, miles[i]);
+        }
+    }
+
+    auto miles = 0.0;
+    EXPECT_EQ(navigator_.networkDistance("Nowhere In Particular", "Drake Stadium", miles),
+              Navigator::NavResult::NAV_BAD_SOURCE);
+    EXPECT_EQ(navigator_.networkDistance("Drake Stadium", "Nowhere In Particular", miles),
+              Navigator::NavResult::NAV_BAD_DESTINATION);
+}
+
+// A location in the middle of a segment is as good a start as an end: the
+// route either way is as long as the one found over the street graph.
+TEST_F(NavigatorTest, midSegmentEndpoints)
+{
+    auto names = std::vector<std::string>{ "1031 Broxton Avenue", "1037 Broxton Avenue",
+        "1073 Broxton Avenue", "1061 Broxton Avenue", "Headlines", "1000 Gayley Avenue",
+        "Novel Cafe Westwood", "Drake Stadium", "Ackerman Union" };
+    auto totalOf = [](const std::vector<NavSegment> &directions) {
+        auto total = 0.0;
+        for (const auto &navSeg : directions)
+        {
+            if (navSeg.getCommandType() == NavSegment::NAV_COMMAND::proceed)
+            {
+                total += navSeg.getDistance();
+            }
+        }
+        return total;
+    };
+    auto route     = CompactRoute();
+    auto backwards = std::vector<NavSegment>{};
+    for (const auto &start : names)
+    {
+        for (const auto &end : names)
+        {
+            ASSERT_EQ(static_Navigator.navigate(start, end, directions_),
+                      Navigator::NavResult::NAV_SUCCESS) << start << " -> " << end;
+            ASSERT_EQ(static_Navigator.navigate(end, start, backwards),
+                      Navigator::NavResult::NAV_SUCCESS) << end << " -> " << start;
+            ASSERT_EQ(static_Navigator.navigate(start, end, route),
+                      Navigator::NavResult::NAV_SUCCESS);
+            auto byArcs = 0.0;
+            for (const auto &navSeg : route.segments)
+            {
+                byArcs += navSeg.distance;
+            }
+            EXPECT_NEAR(totalOf(directions_), byArcs, 1e-9) << start << " -> " << end;
+            EXPECT_NEAR(totalOf(directions_), totalOf(backwards), 1e-9) << start << " -> " << end;
+        }
+    }
+}
+
+// A synthetic map loads like the real one: every segment read back, names
+// reused as asked, one component per island besides the city.
+TEST_F(NavigatorTest, syntheticMap)
+{
+    auto spec = SyntheticMapSpec();
+    spec.segments              = 5000;
+    spec.streetNames           = 7;
+    spec.attractionsPerSegment = 0.1;
+    spec.islands               = 2;
+    spec.seed                  = 42;
+    auto out   = std::ofstream("synthetic.txt");
+    auto stats = writeSyntheticMap(spec, out);
+    out.close();
+    ASSERT_TRUE(out);
+    EXPECT_GT(stats.segments, 4000);
+    EXPECT_GT(stats.attractions, 0);
+    auto again = std::ostringstream();
+    writeSyntheticMap(spec, again);
+    auto written = std::ostringstream();
+    written << std::ifstream("synthetic.txt").rdbuf();
+    EXPECT_EQ(again.str(), written.str());
+
+    auto ml = MapLoader();
+    ASSERT_TRUE(ml.load("synthetic.txt"));
+    ASSERT_EQ(ml.getNumSegments(), static_cast<size_t>(stats.segments));
+    auto names       = std::vector<std::string>{};
+    auto attractions = std::vector<std::string>{};
+    auto street      = StreetSegment();
+    for (size_t i = 0; i < ml.getNumSegments(); ++i)
+    {
+        ASSERT_TRUE(ml.getSegment(i, street));
+        names.emplace_back(street.streetName);
+        for (const auto &address : street.attractionsOnThisSegment)
+        {
+            attractions.emplace_back(address.attraction);
+        }
+    }
+    std::sort(begin(names), end(names));
+    EXPECT_EQ(std::unique(begin(names), end(names)) - begin(names), spec.streetNames);
+    ASSERT_EQ(size(attractions), static_cast<size_t>(stats.attractions));
+
+    ASSERT_TRUE(navigator_.loadMapData("synthetic.txt"));
+    auto sizes = std::vector<int>{};
+    navigator_.getComponentSizes(sizes);
+    ASSERT_EQ(size(sizes), 3u);
+    EXPECT_EQ(sizes[0] + sizes[1] + sizes[2], stats.nodes);
+    EXPECT_EQ(navigator_.navigate(attractions.front(), attractions[size(attractions) / 2],
+                                  directions_),
+              Navigator::NavResult::NAV_SUCCESS);
+    EXPECT_EQ(navigator_.navigate(attractions.front(), attractions.back(), directions_),
+              Navigator::NavResult::NAV_NO_ROUTE);
+    std::remove("synthetic.txt");
+}
 
 int main(int argc, char* argv[])
 {